@@ -0,0 +1,144 @@
+#include "agent-client.h"
+
+#include "agent-protocol.h"
+
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QTimer>
+
+AgentClient::AgentClient(const QString &address, int timeoutMs, QObject *parent)
+    : QObject(parent), target(address), timeoutMs(timeoutMs) {
+    clock.start();
+    timer = new QTimer(this);
+    connect(timer, &QTimer::timeout, this, &AgentClient::expire);
+}
+
+void AgentClient::open() {
+    timer->start(qBound(10, timeoutMs / 10, 200));
+    QString path;
+    if (AgentProtocol::isLocal(target, &path)) {
+        auto *local = new QLocalSocket(this);
+        socket = local;
+        connect(local, &QLocalSocket::connected, this, &AgentClient::connected);
+        connect(local, &QLocalSocket::readyRead, this, &AgentClient::readFrames);
+        connect(local, &QLocalSocket::stateChanged, this, [this, local](QLocalSocket::LocalSocketState state) {
+            if (state == QLocalSocket::UnconnectedState)
+                fail(local->error() == QLocalSocket::UnknownSocketError ? QString("Connection closed")
+                                                                        : local->errorString());
+        });
+        local->connectToServer(path);
+        return;
+    }
+
+    QString host;
+    quint16 port = 0;
+    if (!AgentProtocol::parseTcp(target, "127.0.0.1", &host, &port)) {
+        fail("Bad address");
+        return;
+    }
+    auto *tcp = new QTcpSocket(this);
+    socket = tcp;
+    connect(tcp, &QTcpSocket::connected, this, [this, tcp]() {
+        tcp->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connected();
+    });
+    connect(tcp, &QTcpSocket::readyRead, this, &AgentClient::readFrames);
+    connect(tcp, &QTcpSocket::stateChanged, this, [this, tcp](QAbstractSocket::SocketState state) {
+        if (state == QAbstractSocket::UnconnectedState)
+            fail(tcp->error() == QAbstractSocket::UnknownSocketError ? QString("Connection closed")
+                                                                     : tcp->errorString());
+    });
+    tcp->connectToHost(host, port);
+}
+
+void AgentClient::connected() {
+    isUp = true;
+    socket->write(outbox);
+    outbox.clear();
+}
+
+int AgentClient::request(QJsonObject message, const Callback &done) {
+    int id = nextId++;
+    message["id"] = id;
+    if (!failure.isEmpty()) {
+        QString error = failure;
+        QTimer::singleShot(0, this, [done, id, error]() {
+            QJsonObject response;
+            response["id"] = id;
+            response["ok"] = false;
+            response["error"] = error;
+            done(response);
+        });
+        return id;
+    }
+    pending.insert(id, Pending{done, clock.elapsed() + timeoutMs});
+    if (isUp)
+        socket->write(AgentProtocol::encode(message));
+    else
+        outbox += AgentProtocol::encode(message);
+    return id;
+}
+
+void AgentClient::readFrames() {
+    inbox += socket->readAll();
+    forever {
+        QJsonObject message;
+        bool bad = false;
+        if (!AgentProtocol::takeFrame(&inbox, &message, &bad)) {
+            if (bad) {
+                fail("Not a gpu-control agent");
+                socket->close();
+            }
+            return;
+        }
+        if (message.contains("stream")) {
+            if (onStream)
+                onStream(message["stream"].toInt(), message["sample"].toObject());
+            continue;
+        }
+        Pending entry = pending.take(message["id"].toInt());
+        if (entry.done)
+            entry.done(message);
+    }
+}
+
+void AgentClient::expire() {
+    if (!isUp && failure.isEmpty() && clock.elapsed() > timeoutMs) {
+        fail(QString("No connection within %1 s").arg(timeoutMs / 1000.0));
+        if (socket)
+            socket->close();
+        return;
+    }
+    QList<int> late;
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        if (clock.elapsed() > it->deadlineMs)
+            late.append(it.key());
+    }
+    for (int id : late) {
+        Pending entry = pending.take(id);
+        QJsonObject response;
+        response["id"] = id;
+        response["ok"] = false;
+        response["error"] = QString("No answer within %1 s").arg(timeoutMs / 1000.0);
+        entry.done(response);
+    }
+}
+
+void AgentClient::fail(const QString &error) {
+    if (!failure.isEmpty())
+        return;
+    failure = error;
+    timer->stop();
+    // Callbacks may make new requests; those fail on their own
+    QHash<int, Pending> failed;
+    failed.swap(pending);
+    for (auto it = failed.constBegin(); it != failed.constEnd(); ++it) {
+        QJsonObject response;
+        response["id"] = it.key();
+        response["ok"] = false;
+        response["error"] = error;
+        it->done(response);
+    }
+    if (onClosed)
+        onClosed(error);
+}
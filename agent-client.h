@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QString>
+
+#include <functional>
+
+class QIODevice;
+class QTimer;
+
+// One connection to a gpu-control agent. Requests go out as soon as they are
+// made (queued until the connection is up) and are matched to responses by
+// id, so any number can be in flight. Nothing blocks: callbacks run on the
+// caller's event loop, which is what lets one client per host fan out
+// without a slow host holding up the rest.
+class AgentClient : public QObject {
+public:
+    typedef std::function<void(const QJsonObject &response)> Callback;
+
+    // Each request fails with "ok":false and an "error" if it is not
+    // answered within timeoutMs of being made
+    AgentClient(const QString &address, int timeoutMs, QObject *parent = nullptr);
+
+    QString address() const { return target; }
+    void open();
+
+    // Fills in the id and returns it
+    int request(QJsonObject message, const Callback &done);
+    // Called with the stream id and sample object of every pushed frame
+    void setStreamHandler(const std::function<void(int, const QJsonObject &)> &handler) { onStream = handler; }
+    // Called once with the reason when the connection fails or closes
+    void setClosedHandler(const std::function<void(const QString &)> &handler) { onClosed = handler; }
+
+private:
+    struct Pending {
+        Callback done;
+        qint64 deadlineMs = 0;
+    };
+
+    void connected();
+    void readFrames();
+    void expire();
+    void fail(const QString &error);
+
+    QString target;
+    int timeoutMs;
+    QIODevice *socket = nullptr;
+    bool isUp = false;
+    QString failure;            // Sticky once the connection is gone
+    QByteArray inbox;
+    QByteArray outbox;
+    int nextId = 1;
+    QHash<int, Pending> pending;
+    QElapsedTimer clock;
+    QTimer *timer;
+    std::function<void(int, const QJsonObject &)> onStream;
+    std::function<void(const QString &)> onClosed;
+};
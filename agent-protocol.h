@@ -0,0 +1,173 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QByteArray>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QtEndian>
+
+// Wire format between `gpu-control --agent` and `gpu-control --remote`: each
+// frame is a 4-byte big-endian length followed by that many bytes of compact
+// JSON. Requests carry an "id" the response echoes, so a client can have any
+// number in flight and the agent answers them in whatever order they finish.
+// Responses carry "ok" and, on failure, "error".
+//
+//   {"id":1,"op":"hello","token":"..."}      -> "host", "backend", "gpus"
+//   {"id":2,"op":"snapshot"}                 -> "gpus":[{"gpu":0,"pci":..,"power":300,
+//                                               "memory":1000,"core":100,"graphics_clock":..,
+//                                               "memory_clock":..}]   (offsets only when readable)
+//   {"id":3,"op":"apply","profile":"NAME"}   (the agent's own profile; "" for its saved settings)
+//   {"id":3,"op":"apply","gpus":[{"gpu":0,"power":300,"memory":1000,"core":100,
+//    "lock_graphics":[1500,1800],"lock_memory":[0,0]}]}   (keys left out are left alone)
+//                                            -> "results":[{"gpu":0,"ok":true,"failed":0,"errors":[]}]
+//   {"id":4,"op":"stream"}                   -> ack, then {"stream":4,"sample":{..}} per sample
+//   {"id":5,"op":"stop","stream":4}
+//
+// When the agent has a token (GPU_CONTROL_AGENT_TOKEN), nothing but hello is
+// answered until a hello with the same token.
+namespace AgentProtocol {
+
+const quint16 DefaultPort = 9836;
+// Far above any snapshot or apply; a longer length means a confused peer
+const int MaxFrameBytes = 1 << 20;
+
+inline QString defaultAddress() {
+    return QString("127.0.0.1:%1").arg(DefaultPort);
+}
+
+inline QByteArray token() {
+    return qgetenv("GPU_CONTROL_AGENT_TOKEN");
+}
+
+// "unix:/path" or an absolute path name a Unix socket
+inline bool isLocal(const QString &address, QString *path) {
+    if (!address.startsWith("unix:") && !address.startsWith('/'))
+        return false;
+    *path = address.startsWith("unix:") ? address.mid(5) : address;
+    return true;
+}
+
+// "host:port", "[v6]:port", "host", ":port" or "port"; whatever is left out
+// is defaultHost or DefaultPort
+inline bool parseTcp(const QString &address, const QString &defaultHost, QString *host, quint16 *port) {
+    QString rest = address;
+    QString portText;
+    if (rest.startsWith('[')) {
+        int end = rest.indexOf(']');
+        if (end < 0)
+            return false;
+        *host = rest.mid(1, end - 1);
+        portText = rest.mid(end + 1).startsWith(':') ? rest.mid(end + 2) : QString();
+    } else if (rest.count(':') == 1) {
+        *host = rest.section(':', 0, 0);
+        portText = rest.section(':', 1);
+    } else if (!rest.contains(':') && !rest.isEmpty() && rest.toUInt() > 0) {
+        host->clear();
+        portText = rest;
+    } else {
+        *host = rest;
+    }
+    if (host->isEmpty())
+        *host = defaultHost;
+    bool ok = true;
+    uint number = portText.isEmpty() ? DefaultPort : portText.toUInt(&ok);
+    if (!ok || number == 0 || number > 65535 || host->isEmpty())
+        return false;
+    *port = quint16(number);
+    return true;
+}
+
+inline QByteArray encode(const QJsonObject &message) {
+    QByteArray body = QJsonDocument(message).toJson(QJsonDocument::Compact);
+    QByteArray frame(4, '\0');
+    qToBigEndian<quint32>(quint32(body.size()), frame.data());
+    return frame + body;
+}
+
+// Takes the first complete frame off buffer. False when there is none yet,
+// or (with *bad set) when the stream cannot be a peer speaking this protocol.
+inline bool takeFrame(QByteArray *buffer, QJsonObject *message, bool *bad) {
+    *bad = false;
+    if (buffer->size() < 4)
+        return false;
+    quint32 length = qFromBigEndian<quint32>(buffer->constData());
+    if (length > quint32(MaxFrameBytes)) {
+        *bad = true;
+        return false;
+    }
+    if (buffer->size() < int(4 + length))
+        return false;
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(buffer->mid(4, int(length)), &error);
+    buffer->remove(0, int(4 + length));
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        *bad = true;
+        return false;
+    }
+    *message = doc.object();
+    return true;
+}
+
+inline QJsonObject settingsObject(int gpu, const GpuSettings &settings) {
+    QJsonObject entry;
+    entry["gpu"] = gpu;
+    entry["power"] = settings.powerLimit;
+    entry["memory"] = settings.memoryOffset;
+    entry["core"] = settings.coreOffset;
+    entry["lock_graphics"] = QJsonArray{settings.graphicsLockMin, settings.graphicsLockMax};
+    entry["lock_memory"] = QJsonArray{settings.memoryLockMin, settings.memoryLockMax};
+    return entry;
+}
+
+// *fields gets the ApplyField mask of the keys entry has
+inline GpuSettings readSettings(const QJsonObject &entry, int *fields) {
+    *fields = (entry.contains("power") ? ApplyPowerLimit : 0)
+        | (entry.contains("memory") ? ApplyMemoryOffset : 0)
+        | (entry.contains("core") ? ApplyCoreOffset : 0)
+        | (entry.contains("lock_graphics") ? ApplyGraphicsLock : 0)
+        | (entry.contains("lock_memory") ? ApplyMemoryLock : 0);
+    GpuSettings settings;
+    settings.powerLimit = entry["power"].toInt();
+    settings.memoryOffset = entry["memory"].toInt();
+    settings.coreOffset = entry["core"].toInt();
+    QJsonArray graphicsLock = entry["lock_graphics"].toArray();
+    settings.graphicsLockMin = graphicsLock.at(0).toInt();
+    settings.graphicsLockMax = graphicsLock.at(1).toInt();
+    QJsonArray memoryLock = entry["lock_memory"].toArray();
+    settings.memoryLockMin = memoryLock.at(0).toInt();
+    settings.memoryLockMax = memoryLock.at(1).toInt();
+    return settings;
+}
+
+inline QJsonObject sampleObject(const TelemetrySample &sample) {
+    QJsonObject entry;
+    entry["gpu"] = sample.gpu;
+    entry["t"] = double(sample.timestampMs);
+    entry["power"] = sample.powerDraw;
+    entry["graphics_clock"] = sample.graphicsClock;
+    entry["memory_clock"] = sample.memoryClock;
+    entry["temperature"] = sample.temperature;
+    entry["gpu_util"] = sample.gpuUtilization;
+    entry["mem_util"] = sample.memUtilization;
+    entry["throttle"] = double(sample.throttleReasons);
+    return entry;
+}
+
+inline TelemetrySample readSample(const QJsonObject &entry) {
+    TelemetrySample sample;
+    sample.gpu = entry["gpu"].toInt();
+    sample.timestampMs = qint64(entry["t"].toDouble());
+    sample.powerDraw = float(entry["power"].toDouble(-1));
+    sample.graphicsClock = entry["graphics_clock"].toInt(-1);
+    sample.memoryClock = entry["memory_clock"].toInt(-1);
+    sample.temperature = entry["temperature"].toInt(-1);
+    sample.gpuUtilization = entry["gpu_util"].toInt(-1);
+    sample.memUtilization = entry["mem_util"].toInt(-1);
+    sample.throttleReasons = quint64(entry["throttle"].toDouble());
+    return sample;
+}
+
+}
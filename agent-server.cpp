@@ -0,0 +1,405 @@
+#include "agent-server.h"
+
+#include "agent-protocol.h"
+#include "config.h"
+
+#include <QFile>
+#include <QFutureWatcher>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QSysInfo>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QVector>
+#include <QtConcurrent>
+
+namespace {
+
+// A subscriber this far behind loses samples instead of growing the buffer
+const qint64 MaxStreamBacklog = 256 * 1024;
+
+// Runs every job on the thread pool and hands done the results in job
+// order once the last one finishes; nothing waits in between
+template <typename T>
+void runAll(QObject *context, const QVector<std::function<T()>> &jobs,
+            const std::function<void(const QVector<T> &)> &done) {
+    struct Batch {
+        QVector<T> results;
+        int remaining = 0;
+    };
+    QSharedPointer<Batch> batch(new Batch);
+    batch->results.resize(jobs.size());
+    batch->remaining = jobs.size();
+    if (jobs.isEmpty()) {
+        done(batch->results);
+        return;
+    }
+    for (int i = 0; i < jobs.size(); ++i) {
+        auto *watcher = new QFutureWatcher<T>(context);
+        QObject::connect(watcher, &QFutureWatcher<T>::finished, context, [watcher, batch, i, done]() {
+            batch->results[i] = watcher->result();
+            watcher->deleteLater();
+            if (--batch->remaining == 0)
+                done(batch->results);
+        });
+        watcher->setFuture(QtConcurrent::run(jobs[i]));
+    }
+}
+
+QJsonObject reply(int id, bool ok, const QString &error = QString()) {
+    QJsonObject response;
+    response["id"] = id;
+    response["ok"] = ok;
+    if (!error.isEmpty())
+        response["error"] = error;
+    return response;
+}
+
+// 0, 0 unlocks; the driver rounds anything else to supported clocks
+bool validLock(int min, int max) {
+    return (min == 0 && max == 0) || (min > 0 && min <= max);
+}
+
+// The checks gpu-control-helper makes before a write, against the ranges
+// the board reports
+QString validate(const GpuStaticInfo &info, const GpuSettings &settings, int fields) {
+    if (fields & ApplyPowerLimit) {
+        int min = info.minPowerLimit;
+        int max = info.maxPowerLimit;
+        if ((min > 0 && settings.powerLimit < min) || (max > 0 && settings.powerLimit > max))
+            return QString("Power limit %1 W is outside %2..%3 W").arg(settings.powerLimit).arg(min).arg(max);
+    }
+    if ((fields & ApplyMemoryOffset)
+        && (settings.memoryOffset < info.memOffsetMin || settings.memoryOffset > info.memOffsetMax))
+        return QString("Memory offset %1 is outside %2..%3").arg(settings.memoryOffset)
+            .arg(info.memOffsetMin).arg(info.memOffsetMax);
+    if ((fields & ApplyCoreOffset)
+        && (settings.coreOffset < info.coreOffsetMin || settings.coreOffset > info.coreOffsetMax))
+        return QString("Core offset %1 is outside %2..%3").arg(settings.coreOffset)
+            .arg(info.coreOffsetMin).arg(info.coreOffsetMax);
+    if ((fields & ApplyGraphicsLock) && !validLock(settings.graphicsLockMin, settings.graphicsLockMax))
+        return QString("Invalid graphics clock lock %1..%2").arg(settings.graphicsLockMin).arg(settings.graphicsLockMax);
+    if ((fields & ApplyMemoryLock) && !validLock(settings.memoryLockMin, settings.memoryLockMax))
+        return QString("Invalid memory clock lock %1..%2").arg(settings.memoryLockMin).arg(settings.memoryLockMax);
+    return QString();
+}
+
+QString peer(QIODevice *socket) {
+    auto *tcp = qobject_cast<QTcpSocket *>(socket);
+    return tcp ? QString("%1:%2").arg(tcp->peerAddress().toString()).arg(tcp->peerPort()) : QString("local client");
+}
+
+}
+
+AgentServer::AgentServer(GpuBackend *backend, int gpuCount, QObject *parent)
+    : QObject(parent), backend(backend), gpuCount(gpuCount), token(AgentProtocol::token()) {
+    applyFunction = [backend](int gpu, const GpuSettings &settings, int fields) {
+        return backend->apply(gpu, settings, fields);
+    };
+}
+
+AgentServer::~AgentServer() {
+    if (tcp)
+        tcp->close();
+    if (local)
+        local->close();
+    // Snapshots and applies still running use the backend and limits();
+    // runAll() parents each watcher to this
+    for (QFutureWatcherBase *watcher : findChildren<QFutureWatcherBase *>())
+        watcher->waitForFinished();
+}
+
+bool AgentServer::listen(const QString &address, QString *error) {
+    QString path;
+    if (AgentProtocol::isLocal(address, &path)) {
+        local = new QLocalServer(this);
+        QLocalServer::removeServer(path);
+        if (!local->listen(path)) {
+            *error = local->errorString();
+            return false;
+        }
+        connect(local, &QLocalServer::newConnection, this, [this]() {
+            while (QLocalSocket *socket = local->nextPendingConnection()) {
+                connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+                    connections.remove(socket);
+                    socket->deleteLater();
+                });
+                accept(socket);
+            }
+        });
+        return true;
+    }
+
+    QString host;
+    quint16 port = 0;
+    if (!AgentProtocol::parseTcp(address, "127.0.0.1", &host, &port)) {
+        *error = "Bad listen address " + address;
+        return false;
+    }
+    QHostAddress bind(host);
+    if (bind.isNull()) {
+        *error = "Bad listen address " + address;
+        return false;
+    }
+    // Any local user can reach loopback, and anyone at all past it
+    if (token.isEmpty() && !insecure) {
+        *error = "TCP needs GPU_CONTROL_AGENT_TOKEN set (or --agent-insecure to serve without one)";
+        return false;
+    }
+    tcp = new QTcpServer(this);
+    if (!tcp->listen(bind, port)) {
+        *error = tcp->errorString();
+        return false;
+    }
+    if (!bind.isLoopback() && token.isEmpty())
+        qWarning("Agent reachable beyond this host without GPU_CONTROL_AGENT_TOKEN set");
+    connect(tcp, &QTcpServer::newConnection, this, [this]() {
+        while (QTcpSocket *socket = tcp->nextPendingConnection()) {
+            // Frames are small and answered at once
+            socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+                connections.remove(socket);
+                socket->deleteLater();
+            });
+            accept(socket);
+        }
+    });
+    return true;
+}
+
+QString AgentServer::description() const {
+    if (local)
+        return local->fullServerName();
+    return tcp ? QString("%1:%2").arg(tcp->serverAddress().toString()).arg(tcp->serverPort()) : QString();
+}
+
+void AgentServer::accept(QIODevice *socket) {
+    Connection connection;
+    connection.authenticated = token.isEmpty();
+    connections.insert(socket, connection);
+    connect(socket, &QIODevice::readyRead, this, [this, socket]() { readFrames(socket); });
+}
+
+void AgentServer::readFrames(QIODevice *socket) {
+    auto it = connections.find(socket);
+    if (it == connections.end())
+        return;
+    it->inbox += socket->readAll();
+    forever {
+        QJsonObject request;
+        bool bad = false;
+        // handle() may grow the hash, so look the connection up every time
+        if (!AgentProtocol::takeFrame(&connections[socket].inbox, &request, &bad)) {
+            if (bad) {
+                qWarning("Dropping %s: not speaking the agent protocol", qPrintable(peer(socket)));
+                connections.remove(socket);
+                socket->close();
+            }
+            return;
+        }
+        handle(socket, request);
+    }
+}
+
+void AgentServer::send(QIODevice *socket, const QJsonObject &message) {
+    if (connections.contains(socket))
+        socket->write(AgentProtocol::encode(message));
+}
+
+void AgentServer::handle(QIODevice *socket, const QJsonObject &request) {
+    int id = request["id"].toInt();
+    QString op = request["op"].toString();
+    Connection &connection = connections[socket];
+
+    if (op == "hello") {
+        if (!token.isEmpty() && request["token"].toString().toUtf8() != token) {
+            qWarning("Rejected %s: wrong token", qPrintable(peer(socket)));
+            send(socket, reply(id, false, "Wrong token"));
+            return;
+        }
+        connection.authenticated = true;
+        QJsonObject response = reply(id, true);
+        response["host"] = QSysInfo::machineHostName();
+        response["backend"] = backend->name();
+        response["gpus"] = gpuCount;
+        send(socket, response);
+        return;
+    }
+    if (!connection.authenticated) {
+        send(socket, reply(id, false, "Not authenticated"));
+        return;
+    }
+
+    if (op == "snapshot") {
+        snapshot(socket, id);
+    } else if (op == "apply") {
+        apply(socket, id, request);
+    } else if (op == "stream") {
+        connection.stream = id;
+        send(socket, reply(id, true));
+    } else if (op == "stop") {
+        if (request["stream"].toInt() == connection.stream)
+            connection.stream = 0;
+        send(socket, reply(id, true));
+    } else {
+        send(socket, reply(id, false, "Unknown op: " + op));
+    }
+}
+
+void AgentServer::snapshot(QIODevice *socket, int id) {
+    QVector<std::function<QJsonObject()>> jobs;
+    GpuBackend *backend = this->backend;
+    for (int gpu = 0; gpu < gpuCount; ++gpu) {
+        jobs.append([backend, gpu]() {
+            GpuSnapshot snap = backend->snapshot(gpu);
+            QJsonObject entry;
+            entry["gpu"] = gpu;
+            entry["pci"] = snap.pciBusId;
+            entry["power"] = snap.powerLimit;
+            entry["graphics_clock"] = snap.graphicsClock;
+            entry["memory_clock"] = snap.memoryClock;
+            if (snap.memOffsetOk)
+                entry["memory"] = snap.memoryOffset;
+            if (snap.coreOffsetOk)
+                entry["core"] = snap.coreOffset;
+            return entry;
+        });
+    }
+    QPointer<QIODevice> guard(socket);
+    runAll<QJsonObject>(this, jobs, [this, guard, id](const QVector<QJsonObject> &entries) {
+        if (!guard)
+            return;
+        QJsonArray gpus;
+        for (const QJsonObject &entry : entries)
+            gpus.append(entry);
+        QJsonObject response = reply(id, true);
+        response["gpus"] = gpus;
+        send(guard, response);
+    });
+}
+
+void AgentServer::apply(QIODevice *socket, int id, const QJsonObject &request) {
+    QMap<int, GpuSettings> gpus;
+    QMap<int, int> sent;        // Fields each entry has; a profile has them all
+    QString source;
+    if (request.contains("profile")) {
+        QString profile = request["profile"].toString();
+        // A name, never a path out of the profiles directory
+        if (profile.contains('/') || profile.contains("..")) {
+            send(socket, reply(id, false, "Bad profile name " + profile));
+            return;
+        }
+        QString file = GpuConfig::path(profile);
+        if (!QFile::exists(file)) {
+            send(socket, reply(id, false, profile.isEmpty() ? QString("No saved settings") : "No profile " + profile));
+            return;
+        }
+        gpus = GpuConfig::load(file).gpus;
+        source = profile.isEmpty() ? QString("saved settings") : "profile " + profile;
+    } else {
+        for (const QJsonValue &value : request["gpus"].toArray()) {
+            QJsonObject entry = value.toObject();
+            int fields = 0;
+            gpus.insert(entry["gpu"].toInt(), AgentProtocol::readSettings(entry, &fields));
+            sent.insert(entry["gpu"].toInt(), fields);
+        }
+        source = "settings";
+    }
+    if (gpus.isEmpty()) {
+        send(socket, reply(id, false, "Nothing to apply"));
+        return;
+    }
+
+    // Like a profile switch: a power limit of 0 is left alone and unset
+    // clock locks are reset. Keys an entry leaves out are not written.
+    struct Job {
+        int gpu;
+        GpuSettings settings;
+        int fields;
+    };
+    QVector<Job> applied;
+    QVector<std::function<ApplyResult()>> jobs;
+    for (auto it = gpus.constBegin(); it != gpus.constEnd(); ++it) {
+        Job job{it.key(), *it, enforced & sent.value(it.key(), ApplyAll)};
+        if (job.settings.powerLimit <= 0)
+            job.fields &= ~ApplyPowerLimit;
+        applied.append(job);
+        if (job.gpu < 0 || job.gpu >= gpuCount) {
+            jobs.append([job]() {
+                ApplyResult result;
+                result.failedFields = job.fields;
+                result.errors << QString("No such GPU: %1").arg(job.gpu);
+                return result;
+            });
+            continue;
+        }
+        ApplyFunction function = applyFunction;
+        jobs.append([this, function, job]() {
+            QString error = validate(limits(job.gpu), job.settings, job.fields);
+            if (!error.isEmpty()) {
+                ApplyResult result;
+                result.failedFields = job.fields;
+                result.errors << error;
+                return result;
+            }
+            return function(job.gpu, job.settings, job.fields);
+        });
+    }
+
+    qInfo("Applying %s for %s", qPrintable(source), qPrintable(peer(socket)));
+    QPointer<QIODevice> guard(socket);
+    runAll<ApplyResult>(this, jobs, [this, guard, id, applied](const QVector<ApplyResult> &results) {
+        QJsonArray entries;
+        bool ok = true;
+        for (int i = 0; i < results.size(); ++i) {
+            const Job &job = applied[i];
+            const ApplyResult &result = results[i];
+            if (job.gpu >= 0 && job.gpu < gpuCount && onApplied)
+                onApplied(job.gpu, job.settings, job.fields, result);
+            ok &= result.ok();
+            QJsonObject entry;
+            entry["gpu"] = job.gpu;
+            entry["ok"] = result.ok();
+            entry["failed"] = result.failedFields;
+            entry["errors"] = QJsonArray::fromStringList(result.errors);
+            entries.append(entry);
+            if (!result.ok())
+                qWarning("GPU %d: %s", job.gpu, qPrintable(result.errors.join("; ")));
+        }
+        if (!guard)
+            return;
+        QJsonObject response = reply(id, ok, ok ? QString() : QString("Some settings failed"));
+        response["results"] = entries;
+        send(guard, response);
+    });
+}
+
+GpuStaticInfo AgentServer::limits(int gpu) {
+    {
+        QMutexLocker lock(&limitsMutex);
+        auto it = knownLimits.constFind(gpu);
+        if (it != knownLimits.constEnd())
+            return *it;
+    }
+    // Two first applies may both read it; either copy will do
+    GpuStaticInfo info = backend->staticInfo(gpu);
+    QMutexLocker lock(&limitsMutex);
+    knownLimits.insert(gpu, info);
+    return info;
+}
+
+void AgentServer::addSample(const TelemetrySample &sample) {
+    QJsonObject message;
+    QJsonObject body = AgentProtocol::sampleObject(sample);
+    for (auto it = connections.constBegin(); it != connections.constEnd(); ++it) {
+        if (!it->stream || it.key()->bytesToWrite() > MaxStreamBacklog)
+            continue;
+        message["stream"] = it->stream;
+        message["sample"] = body;
+        it.key()->write(AgentProtocol::encode(message));
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+
+#include <functional>
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+
+// The agent side of AgentProtocol, on TCP or a Unix socket. Snapshots and
+// applies run on the thread pool and are answered as they finish, so a slow
+// write never holds up other requests or other clients; telemetry is pushed
+// from whatever the caller feeds addSample(). Lives on the thread that owns
+// the event loop, and so do both callbacks. Remote applies are held to the
+// GPU's reported ranges, as gpu-control-helper holds local ones.
+class AgentServer : public QObject {
+public:
+    typedef std::function<ApplyResult(int gpu, const GpuSettings &settings, int fields)> ApplyFunction;
+    typedef std::function<void(int gpu, const GpuSettings &settings, int fields, const ApplyResult &result)>
+        AppliedHandler;
+
+    AgentServer(GpuBackend *backend, int gpuCount, QObject *parent = nullptr);
+    ~AgentServer() override;
+
+    // AgentProtocol::isLocal() paths or parseTcp() addresses; the host
+    // defaults to loopback. TCP needs GPU_CONTROL_AGENT_TOKEN unless
+    // setInsecure(true) was called first.
+    bool listen(const QString &address, QString *error);
+    void setInsecure(bool allow) { insecure = allow; }
+    QString description() const;
+
+    // Fields a remote apply may write, e.g. without the power limit while
+    // a governor owns it
+    void setEnforcedFields(int fields) { enforced = fields; }
+    // Defaults to backend->apply()
+    void setApplyFunction(const ApplyFunction &function) { applyFunction = function; }
+    void setAppliedHandler(const AppliedHandler &handler) { onApplied = handler; }
+
+    // Pushes the sample to every client streaming telemetry
+    void addSample(const TelemetrySample &sample);
+
+private:
+    struct Connection {
+        QByteArray inbox;
+        bool authenticated = false;
+        int stream = 0;         // Id of the stream request, 0 when not streaming
+    };
+
+    void accept(QIODevice *socket);
+    void readFrames(QIODevice *socket);
+    void handle(QIODevice *socket, const QJsonObject &request);
+    void snapshot(QIODevice *socket, int id);
+    void apply(QIODevice *socket, int id, const QJsonObject &request);
+    void send(QIODevice *socket, const QJsonObject &message);
+    // staticInfo(), read once per GPU; called from the thread pool
+    GpuStaticInfo limits(int gpu);
+
+    GpuBackend *backend;
+    int gpuCount;
+    int enforced = ApplyAll;
+    QByteArray token;
+    bool insecure = false;
+    ApplyFunction applyFunction;
+    AppliedHandler onApplied;
+    QTcpServer *tcp = nullptr;
+    QLocalServer *local = nullptr;
+    QHash<QIODevice *, Connection> connections;
+    QMutex limitsMutex;
+    QHash<int, GpuStaticInfo> knownLimits;
+};
@@ -0,0 +1,257 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QTcpServer>
+#include <QThread>
+#include <QVector>
+
+#include <cstdio>
+#include <functional>
+
+#include "agent-client.h"
+#include "agent-protocol.h"
+#include "agent-server.h"
+#include "mock-backend.h"
+
+// Three agents on loopback TCP, each over its own two-GPU mock backend,
+// driven by AgentClient the way `gpu-control --remote` drives them: hello,
+// snapshot, full and partial applies, applies the limits refuse, telemetry
+// streams, and an agent torn down with an apply still running. Exits
+// non-zero when a check fails.
+
+namespace {
+
+const char *TOKEN = "agent-test-token";
+int failures = 0;
+
+void check(bool ok, const char *name, const QString &detail) {
+    if (ok)
+        return;
+    ++failures;
+    fprintf(stderr, "FAIL %s: %s\n", name, qPrintable(detail));
+}
+
+bool waitUntil(const std::function<bool()> &done, int timeoutMs) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!done() && timer.elapsed() < timeoutMs) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        QThread::msleep(1);
+    }
+    return done();
+}
+
+// The client times requests out well inside the wait, so done always runs
+QJsonObject call(AgentClient *client, const QJsonObject &message) {
+    QJsonObject response;
+    bool answered = false;
+    client->request(message, [&](const QJsonObject &reply) {
+        response = reply;
+        answered = true;
+    });
+    waitUntil([&]() { return answered; }, 10000);
+    return response;
+}
+
+quint16 freePort() {
+    QTcpServer probe;
+    probe.listen(QHostAddress::LocalHost, 0);
+    return probe.serverPort();
+}
+
+struct Agent {
+    MockBackend *mock;
+    AgentServer *server;
+    AgentClient *client;
+    QString address;
+};
+
+Agent startAgent(const QByteArray &token) {
+    Agent agent;
+    agent.mock = new MockBackend;
+    agent.server = new AgentServer(agent.mock, agent.mock->deviceCount());
+    agent.address = QString("127.0.0.1:%1").arg(freePort());
+    QString error;
+    check(agent.server->listen(agent.address, &error), "listen", error);
+    agent.client = new AgentClient(agent.address, 5000);
+    agent.client->open();
+    QJsonObject hello;
+    hello["op"] = "hello";
+    hello["token"] = QString::fromUtf8(token);
+    QJsonObject response = call(agent.client, hello);
+    check(response["ok"].toBool(), "hello", response["error"].toString());
+    check(response["gpus"].toInt() == 2, "hello", QString("%1 GPUs").arg(response["gpus"].toInt()));
+    return agent;
+}
+
+void stopAgent(const Agent &agent) {
+    delete agent.client;
+    delete agent.server;
+    delete agent.mock;
+}
+
+QJsonObject applyRequest(const QJsonArray &gpus) {
+    QJsonObject request;
+    request["op"] = "apply";
+    request["gpus"] = gpus;
+    return request;
+}
+
+QJsonObject result(const QJsonObject &response, int index) {
+    return response["results"].toArray().at(index).toObject();
+}
+
+void snapshots(const QVector<Agent> &agents) {
+    QJsonObject request;
+    request["op"] = "snapshot";
+    for (const Agent &agent : agents) {
+        QJsonObject response = call(agent.client, request);
+        QJsonArray gpus = response["gpus"].toArray();
+        check(response["ok"].toBool() && gpus.size() == 2, "snapshot",
+              QString("%1: %2 GPUs, %3").arg(agent.address).arg(gpus.size()).arg(response["error"].toString()));
+        check(gpus.at(1).toObject()["power"].toInt() == 350, "snapshot",
+              QString("GPU 1 at %1 W").arg(gpus.at(1).toObject()["power"].toInt()));
+    }
+}
+
+// Every agent takes a full apply at once; each writes its own mock only
+void fullApply(const QVector<Agent> &agents) {
+    QVector<QJsonObject> responses(agents.size());
+    int answered = 0;
+    for (int i = 0; i < agents.size(); ++i) {
+        GpuSettings settings;
+        settings.powerLimit = 300 + 10 * i;
+        settings.memoryOffset = 500;
+        settings.coreOffset = 50;
+        QJsonArray gpus{AgentProtocol::settingsObject(0, settings)};
+        agents[i].client->request(applyRequest(gpus), [&responses, &answered, i](const QJsonObject &response) {
+            responses[i] = response;
+            ++answered;
+        });
+    }
+    waitUntil([&]() { return answered == agents.size(); }, 10000);
+    for (int i = 0; i < agents.size(); ++i) {
+        MockBackend *mock = agents[i].mock;
+        int memory = 0;
+        int core = 0;
+        mock->memoryOffset(0, &memory);
+        mock->coreOffset(0, &core);
+        check(responses[i]["ok"].toBool(), "full apply", responses[i]["error"].toString());
+        check(mock->powerLimit(0) == 300 + 10 * i && memory == 500 && core == 50, "full apply",
+              QString("%1: %2 W, memory %3, core %4").arg(agents[i].address).arg(mock->powerLimit(0))
+                  .arg(memory).arg(core));
+        check(mock->powerLimit(1) == 350, "full apply", QString("GPU 1 moved to %1 W").arg(mock->powerLimit(1)));
+    }
+}
+
+// Keys a client leaves out are left as they are, not written as 0
+void partialApply(const Agent &agent) {
+    QJsonObject entry;
+    entry["gpu"] = 0;
+    entry["memory"] = 1000;
+    QJsonObject response = call(agent.client, applyRequest(QJsonArray{entry}));
+    check(response["ok"].toBool(), "partial apply", response["error"].toString());
+    int memory = 0;
+    int core = 0;
+    agent.mock->memoryOffset(0, &memory);
+    agent.mock->coreOffset(0, &core);
+    check(memory == 1000, "partial apply", QString("memory %1").arg(memory));
+    check(agent.mock->powerLimit(0) == 300 && core == 50, "partial apply",
+          QString("untouched fields now %1 W, core %2").arg(agent.mock->powerLimit(0)).arg(core));
+}
+
+void refused(const Agent &agent) {
+    QJsonObject entry;
+    entry["gpu"] = 1;
+    entry["power"] = 9999;
+    QJsonObject response = call(agent.client, applyRequest(QJsonArray{entry}));
+    check(!response["ok"].toBool() && !result(response, 0)["ok"].toBool(), "out of range",
+          "a 9999 W limit was accepted");
+    check(agent.mock->powerLimit(1) == 350, "out of range", QString("GPU 1 at %1 W").arg(agent.mock->powerLimit(1)));
+
+    entry["gpu"] = 7;
+    entry["power"] = 300;
+    response = call(agent.client, applyRequest(QJsonArray{entry}));
+    check(!response["ok"].toBool() && result(response, 0)["errors"].toArray().at(0).toString().contains("No such GPU"),
+          "no such GPU", QString::fromUtf8(QJsonDocument(response).toJson(QJsonDocument::Compact)));
+}
+
+void wrongToken(const Agent &agent) {
+    AgentClient client(agent.address, 5000);
+    client.open();
+    QJsonObject hello;
+    hello["op"] = "hello";
+    hello["token"] = "wrong";
+    check(!call(&client, hello)["ok"].toBool(), "wrong token", "hello accepted");
+    QJsonObject entry;
+    entry["gpu"] = 0;
+    entry["power"] = 200;
+    call(&client, applyRequest(QJsonArray{entry}));
+    check(agent.mock->powerLimit(0) != 200, "wrong token", "apply went through");
+}
+
+void stream(const Agent &agent) {
+    int samples = 0;
+    agent.client->setStreamHandler([&samples](int, const QJsonObject &sample) {
+        samples += sample["gpu"].toInt() == 1 && sample["temperature"].toInt() == 61;
+    });
+    QJsonObject request;
+    request["op"] = "stream";
+    QJsonObject response = call(agent.client, request);
+    check(response["ok"].toBool(), "stream", response["error"].toString());
+    TelemetrySample sample;
+    sample.gpu = 1;
+    sample.temperature = 61;
+    agent.server->addSample(sample);
+    agent.server->addSample(sample);
+    check(waitUntil([&samples]() { return samples == 2; }, 5000), "stream",
+          QString("%1 of 2 samples arrived").arg(samples));
+    agent.client->setStreamHandler(nullptr);
+}
+
+// The server waits for its own writes before the backend can go away
+void teardownDuringApply() {
+    qputenv("GPU_CONTROL_MOCK_LATENCY_MS", "300");
+    Agent agent = startAgent(TOKEN);
+    qunsetenv("GPU_CONTROL_MOCK_LATENCY_MS");
+    QJsonObject entry;
+    entry["gpu"] = 0;
+    entry["power"] = 250;
+    agent.client->request(applyRequest(QJsonArray{entry}), [](const QJsonObject &) {});
+    waitUntil([]() { return false; }, 100);
+    delete agent.client;
+    delete agent.server;
+    check(agent.mock->powerLimit(0) == 250, "teardown", "apply did not finish before the server went away");
+    delete agent.mock;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    qputenv("GPU_CONTROL_MOCK_GPUS", "2");
+    qunsetenv("GPU_CONTROL_MOCK_LATENCY_MS");
+    qunsetenv("GPU_CONTROL_MOCK_RESET_MS");
+    qputenv("GPU_CONTROL_AGENT_TOKEN", TOKEN);
+    QCoreApplication app(argc, argv);
+
+    QVector<Agent> agents;
+    for (int i = 0; i < 3; ++i)
+        agents.append(startAgent(TOKEN));
+    snapshots(agents);
+    fullApply(agents);
+    partialApply(agents[0]);
+    refused(agents[1]);
+    wrongToken(agents[2]);
+    stream(agents[2]);
+    for (const Agent &agent : agents)
+        stopAgent(agent);
+    teardownDuringApply();
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
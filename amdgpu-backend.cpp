@@ -0,0 +1,462 @@
+#include "amdgpu-backend.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QPair>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+namespace {
+
+const char *AMD_VENDOR_ID = "0x1002";
+
+// Files read once, in one read, without QFile's buffering
+QByteArray readFile(const QString &path) {
+    char buffer[4096];
+    int fd = open(path.toLocal8Bit().constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return QByteArray();
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    close(fd);
+    return n > 0 ? QByteArray(buffer, int(n)).trimmed() : QByteArray();
+}
+
+QString runtimeDirectory() {
+    QString dir = qEnvironmentVariable("GPU_CONTROL_RUNTIME_DIR");
+    return dir.isEmpty() ? QString("/run/gpu-control") : dir;
+}
+
+}
+
+AmdgpuBackend::Attribute::~Attribute() {
+    if (fd >= 0)
+        close(fd);
+}
+
+bool AmdgpuBackend::Attribute::open(const QString &path) {
+    fd = ::open(path.toLocal8Bit().constData(), O_RDONLY | O_CLOEXEC);
+    return fd >= 0;
+}
+
+QByteArray AmdgpuBackend::Attribute::read() const {
+    // pp_od_clk_voltage is the longest at well under a page
+    char buffer[4096];
+    ssize_t n = fd >= 0 ? pread(fd, buffer, sizeof(buffer), 0) : -1;
+    return n > 0 ? QByteArray(buffer, int(n)) : QByteArray();
+}
+
+bool AmdgpuBackend::Attribute::readLong(qint64 *value) const {
+    char buffer[32];
+    ssize_t n = fd >= 0 ? pread(fd, buffer, sizeof(buffer) - 1, 0) : -1;
+    if (n <= 0)
+        return false;
+    buffer[n] = '\0';
+    char *end = nullptr;
+    errno = 0;
+    long long parsed = strtoll(buffer, &end, 10);
+    if (errno != 0 || end == buffer)
+        return false;
+    *value = parsed;
+    return true;
+}
+
+QString AmdgpuBackend::root() {
+    QString dir = qEnvironmentVariable("GPU_CONTROL_SYSFS_ROOT");
+    return dir.isEmpty() ? QString("/sys") : dir;
+}
+
+// cardN device directories of every AMD GPU, in card order
+QVector<QString> AmdgpuBackend::cardDevices() {
+    static const QRegularExpression cardName("^card(\\d+)$");
+    QDir drm(root() + "/class/drm");
+    QVector<QPair<int, QString>> found;
+    for (const QString &entry : drm.entryList(QStringList() << "card*", QDir::Dirs | QDir::NoDotAndDotDot)) {
+        auto match = cardName.match(entry);
+        if (!match.hasMatch())
+            continue;
+        QString device = drm.filePath(entry) + "/device";
+        if (readFile(device + "/vendor") == AMD_VENDOR_ID)
+            found.append(qMakePair(match.captured(1).toInt(), device));
+    }
+    std::sort(found.begin(), found.end());
+
+    QVector<QString> devices;
+    for (const auto &card : found)
+        devices.append(card.second);
+    return devices;
+}
+
+int AmdgpuBackend::detect() {
+    return cardDevices().size();
+}
+
+AmdgpuBackend::AmdgpuBackend() {
+    for (const QString &device : cardDevices()) {
+        auto *card = new Card;
+        card->device = device;
+
+        for (const QByteArray &line : readFile(device + "/uevent").split('\n')) {
+            if (line.startsWith("PCI_SLOT_NAME="))
+                card->busId = QString::fromLatin1(line.mid(14));
+        }
+        if (card->busId.isEmpty())
+            card->busId = QFileInfo(QFileInfo(device).canonicalFilePath()).fileName();
+        card->name = QString::fromUtf8(readFile(device + "/product_name"));
+        if (card->name.isEmpty())
+            card->name = "AMD GPU " + QString::fromLatin1(readFile(device + "/device"));
+
+        QStringList hwmons = QDir(device + "/hwmon").entryList(QStringList() << "hwmon*", QDir::Dirs, QDir::Name);
+        if (!hwmons.isEmpty()) {
+            card->hwmon = device + "/hwmon/" + hwmons.first();
+            card->powerCap.open(card->hwmon + "/power1_cap");
+            // Older boards report an average, newer ones an instantaneous value
+            if (!card->powerDraw.open(card->hwmon + "/power1_average"))
+                card->powerDraw.open(card->hwmon + "/power1_input");
+            card->temperature.open(card->hwmon + "/temp1_input");
+        }
+        card->sclk.open(device + "/pp_dpm_sclk");
+        card->mclk.open(device + "/pp_dpm_mclk");
+        card->gpuBusy.open(device + "/gpu_busy_percent");
+        card->memBusy.open(device + "/mem_busy_percent");
+        card->od.open(device + "/pp_od_clk_voltage");
+        loadStock(card);
+        cards.append(card);
+    }
+}
+
+AmdgpuBackend::~AmdgpuBackend() {
+    qDeleteAll(cards);
+}
+
+// Offsets are relative to the stock OD maxima, which the driver does not
+// report once they have been changed. They are recorded under /run the
+// first time any process opens the card after boot, before anything has
+// been written to it; /run is cleared on reboot, as the card is.
+void AmdgpuBackend::loadStock(Card *card) {
+    QString path = runtimeDirectory() + "/amdgpu-" + QString(card->busId).replace(':', '_') + ".stock";
+    QByteArray saved = readFile(path);
+    if (!saved.isEmpty()) {
+        for (const QByteArray &line : saved.split('\n')) {
+            if (line.startsWith("sclk="))
+                card->stockSclk = line.mid(5).toInt();
+            if (line.startsWith("mclk="))
+                card->stockMclk = line.mid(5).toInt();
+        }
+        return;
+    }
+
+    OdTable od = parseOd(card->od.read());
+    if (!od.valid)
+        return;
+    card->stockSclk = od.sclkIsOffset ? -1 : od.sclk;
+    card->stockMclk = od.mclk;
+
+    // Without write access (the GUI next to a root helper) the helper has
+    // already recorded them; this copy only lives as long as the process
+    QDir().mkpath(runtimeDirectory());
+    int fd = open(path.toLocal8Bit().constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return;
+    QByteArray text = QString("sclk=%1\nmclk=%2\n").arg(card->stockSclk).arg(card->stockMclk).toLatin1();
+    if (write(fd, text.constData(), text.size()) != text.size())
+        unlink(path.toLocal8Bit().constData());
+    close(fd);
+}
+
+AmdgpuBackend::Card *AmdgpuBackend::card(int gpu, QString *error) const {
+    if (gpu >= 0 && gpu < cards.size())
+        return cards[gpu];
+    if (error)
+        *error = QString("No such GPU: %1").arg(gpu);
+    return nullptr;
+}
+
+// "1: 2400Mhz *" marks the level in use
+int AmdgpuBackend::currentLevel(const QByteArray &table) {
+    static const QRegularExpression level("^\\d+:\\s*(\\d+)\\s*[Mm][Hh]z\\s*\\*", QRegularExpression::MultilineOption);
+    auto match = level.match(QString::fromLatin1(table));
+    return match.hasMatch() ? match.captured(1).toInt() : -1;
+}
+
+// Sections as printed by the SMU11+ (Navi and later) power code:
+//
+//   OD_SCLK:            or   OD_SCLK_OFFSET:
+//   0: 500Mhz                0Mhz
+//   1: 2500Mhz
+//   OD_MCLK:
+//   0: 97Mhz
+//   1: 1000MHz
+//   OD_RANGE:
+//   SCLK:     500Mhz   3150Mhz      (SCLK_OFFSET: with an offset)
+//   MCLK:     674Mhz   1200Mhz
+AmdgpuBackend::OdTable AmdgpuBackend::parseOd(const QByteArray &text) {
+    static const QRegularExpression levelLine("^(\\d+):\\s*(-?\\d+)\\s*[Mm][Hh]z");
+    static const QRegularExpression valueLine("^(-?\\d+)\\s*[Mm][Hh]z");
+    static const QRegularExpression rangeLine("^(SCLK|SCLK_OFFSET|MCLK):\\s*(-?\\d+)\\s*[Mm][Hh]z\\s+(-?\\d+)\\s*[Mm][Hh]z");
+
+    OdTable od;
+    QString section;
+    for (const QByteArray &raw : text.split('\n')) {
+        QString line = QString::fromLatin1(raw).trimmed();
+        if (line.startsWith("OD_") && line.endsWith(':')) {
+            section = line.chopped(1);
+            continue;
+        }
+        if (section == "OD_SCLK" || section == "OD_MCLK") {
+            auto match = levelLine.match(line);
+            if (!match.hasMatch())
+                continue;
+            // The top level is the one offsets move
+            bool sclk = section == "OD_SCLK";
+            (sclk ? od.sclkLevel : od.mclkLevel) = match.captured(1).toInt();
+            (sclk ? od.sclk : od.mclk) = match.captured(2).toInt();
+            od.valid = true;
+        } else if (section == "OD_SCLK_OFFSET") {
+            auto match = valueLine.match(line);
+            if (!match.hasMatch())
+                continue;
+            od.sclkIsOffset = true;
+            od.sclk = match.captured(1).toInt();
+            od.valid = true;
+        } else if (section == "OD_RANGE") {
+            auto match = rangeLine.match(line);
+            if (!match.hasMatch())
+                continue;
+            bool sclk = match.captured(1) != "MCLK";
+            (sclk ? od.sclkMin : od.mclkMin) = match.captured(2).toInt();
+            (sclk ? od.sclkMax : od.mclkMax) = match.captured(3).toInt();
+        }
+    }
+    return od;
+}
+
+QString AmdgpuBackend::pciBusId(int gpu) {
+    Card *c = card(gpu);
+    return c ? c->busId : QString();
+}
+
+QString AmdgpuBackend::driverVersion() {
+    // In-tree amdgpu has no version of its own; the kernel release is it
+    QByteArray version = readFile(root() + "/module/amdgpu/version");
+    if (!version.isEmpty())
+        return QString::fromLatin1(version);
+    utsname name;
+    return uname(&name) == 0 ? QString("kernel-%1").arg(name.release) : QString();
+}
+
+QString AmdgpuBackend::gpuName(int gpu) {
+    Card *c = card(gpu);
+    return c ? c->name : QString();
+}
+
+int AmdgpuBackend::hwmonWatts(const Card &card, const char *file) const {
+    if (card.hwmon.isEmpty())
+        return -1;
+    bool ok = false;
+    qint64 microwatts = readFile(card.hwmon + "/" + file).toLongLong(&ok);
+    return ok ? int(microwatts / 1000000) : -1;
+}
+
+int AmdgpuBackend::minPowerLimit(int gpu) {
+    Card *c = card(gpu);
+    return c ? hwmonWatts(*c, "power1_cap_min") : -1;
+}
+
+int AmdgpuBackend::maxPowerLimit(int gpu) {
+    Card *c = card(gpu);
+    return c ? hwmonWatts(*c, "power1_cap_max") : -1;
+}
+
+int AmdgpuBackend::defaultPowerLimit(int gpu) {
+    Card *c = card(gpu);
+    if (!c)
+        return -1;
+    // power1_cap_default only exists on 6.0+ kernels
+    int watts = hwmonWatts(*c, "power1_cap_default");
+    return watts > 0 ? watts : hwmonWatts(*c, "power1_cap_max");
+}
+
+int AmdgpuBackend::powerLimit(int gpu) {
+    Card *c = card(gpu);
+    qint64 microwatts = 0;
+    if (!c || !c->powerCap.readLong(&microwatts))
+        return -1;
+    return int(microwatts / 1000000);
+}
+
+int AmdgpuBackend::memoryClock(int gpu) {
+    Card *c = card(gpu);
+    return c ? currentLevel(c->mclk.read()) : -1;
+}
+
+int AmdgpuBackend::graphicsClock(int gpu) {
+    Card *c = card(gpu);
+    return c ? currentLevel(c->sclk.read()) : -1;
+}
+
+// Memory offsets keep the nvidia-settings convention of twice the clock
+bool AmdgpuBackend::memoryOffset(int gpu, int *mhz) {
+    Card *c = card(gpu);
+    if (!c || c->stockMclk <= 0)
+        return false;
+    OdTable od = parseOd(c->od.read());
+    if (od.mclk <= 0)
+        return false;
+    *mhz = (od.mclk - c->stockMclk) * 2;
+    return true;
+}
+
+bool AmdgpuBackend::coreOffset(int gpu, int *mhz) {
+    Card *c = card(gpu);
+    if (!c)
+        return false;
+    OdTable od = parseOd(c->od.read());
+    if (od.sclkIsOffset) {
+        *mhz = od.sclk;
+        return true;
+    }
+    if (od.sclk <= 0 || c->stockSclk <= 0)
+        return false;
+    *mhz = od.sclk - c->stockSclk;
+    return true;
+}
+
+bool AmdgpuBackend::memoryOffsetRange(int gpu, int *min, int *max) {
+    Card *c = card(gpu);
+    if (!c || c->stockMclk <= 0)
+        return false;
+    OdTable od = parseOd(c->od.read());
+    if (od.mclkMin < 0 || od.mclkMax < 0)
+        return false;
+    *min = (od.mclkMin - c->stockMclk) * 2;
+    *max = (od.mclkMax - c->stockMclk) * 2;
+    return true;
+}
+
+bool AmdgpuBackend::coreOffsetRange(int gpu, int *min, int *max) {
+    Card *c = card(gpu);
+    if (!c)
+        return false;
+    OdTable od = parseOd(c->od.read());
+    if (od.sclkMin == -1 && od.sclkMax == -1)
+        return false;
+    int base = od.sclkIsOffset ? 0 : c->stockSclk;
+    if (base < 0)
+        return false;
+    *min = od.sclkMin - base;
+    *max = od.sclkMax - base;
+    return true;
+}
+
+// amdgpu pins clocks through DPM level masks, which are too coarse on
+// current boards to stand in for a locked MHz range
+bool AmdgpuBackend::supportedClocks(int, QVector<int> *, QVector<int> *) {
+    return false;
+}
+
+bool AmdgpuBackend::sample(int gpu, TelemetrySample *out) {
+    Card *c = card(gpu);
+    if (!c)
+        return false;
+
+    qint64 value = 0;
+    out->gpu = gpu;
+    if (c->powerDraw.readLong(&value))
+        out->powerDraw = value / 1000000.0f;
+    if (c->temperature.readLong(&value))
+        out->temperature = int(value / 1000);
+    if (c->gpuBusy.readLong(&value))
+        out->gpuUtilization = int(value);
+    if (c->memBusy.readLong(&value))
+        out->memUtilization = int(value);
+    out->graphicsClock = currentLevel(c->sclk.read());
+    out->memoryClock = currentLevel(c->mclk.read());
+    return true;
+}
+
+bool AmdgpuBackend::writeAttribute(const QString &path, const QVector<QByteArray> &commands, QString *error) {
+    QMutexLocker lock(&writeMutex);
+    int fd = open(path.toLocal8Bit().constData(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (error)
+            *error = QString("%1: %2").arg(QFileInfo(path).fileName(), strerror(errno));
+        return false;
+    }
+    // The driver takes one command per write()
+    for (const QByteArray &command : commands) {
+        if (write(fd, command.constData(), command.size()) != command.size()) {
+            if (error)
+                *error = QString("%1: %2").arg(QFileInfo(path).fileName(), strerror(errno));
+            close(fd);
+            return false;
+        }
+    }
+    close(fd);
+    return true;
+}
+
+bool AmdgpuBackend::setPowerLimit(int gpu, int watts, QString *error) {
+    Card *c = card(gpu, error);
+    if (!c)
+        return false;
+    if (c->hwmon.isEmpty()) {
+        if (error)
+            *error = "No power cap on this GPU";
+        return false;
+    }
+    return writeAttribute(c->hwmon + "/power1_cap",
+                          QVector<QByteArray>() << QByteArray::number(qint64(watts) * 1000000), error);
+}
+
+bool AmdgpuBackend::setMemoryOffset(int gpu, int mhz, QString *error) {
+    Card *c = card(gpu, error);
+    if (!c)
+        return false;
+    OdTable od = parseOd(c->od.read());
+    if (od.mclkLevel < 0 || c->stockMclk <= 0) {
+        if (error)
+            *error = "Memory overclocking is not enabled (amdgpu.ppfeaturemask)";
+        return false;
+    }
+    QByteArray set = QString("m %1 %2\n").arg(od.mclkLevel).arg(c->stockMclk + mhz / 2).toLatin1();
+    return writeAttribute(c->device + "/pp_od_clk_voltage", QVector<QByteArray>() << set << "c\n", error);
+}
+
+bool AmdgpuBackend::setCoreOffset(int gpu, int mhz, QString *error) {
+    Card *c = card(gpu, error);
+    if (!c)
+        return false;
+    OdTable od = parseOd(c->od.read());
+    QByteArray set;
+    if (od.sclkIsOffset)
+        set = QString("s %1\n").arg(mhz).toLatin1();
+    else if (od.sclkLevel >= 0 && c->stockSclk > 0)
+        set = QString("s %1 %2\n").arg(od.sclkLevel).arg(c->stockSclk + mhz).toLatin1();
+    if (set.isEmpty()) {
+        if (error)
+            *error = "Core overclocking is not enabled (amdgpu.ppfeaturemask)";
+        return false;
+    }
+    return writeAttribute(c->device + "/pp_od_clk_voltage", QVector<QByteArray>() << set << "c\n", error);
+}
+
+bool AmdgpuBackend::setGraphicsClockLock(int gpu, int min, int max, QString *error) {
+    if (!card(gpu, error))
+        return false;
+    if (min == 0 && max == 0)
+        return true;
+    if (error)
+        *error = "Clock locking is not supported on amdgpu";
+    return false;
+}
+
+bool AmdgpuBackend::setMemoryClockLock(int gpu, int min, int max, QString *error) {
+    return setGraphicsClockLock(gpu, min, max, error);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QByteArray>
+#include <QMutex>
+#include <QVector>
+
+// amdgpu boards through sysfs, without a single subprocess. Cards are found
+// under /sys/class/drm; the power cap maps to hwmon power1_cap and the
+// clock offsets to the top OD_SCLK/OD_MCLK levels in pp_od_clk_voltage (or
+// OD_SCLK_OFFSET where the board has one). Every file that is polled stays
+// open, so a read is one pread().
+//
+// GPU_CONTROL_SYSFS_ROOT points it at a fake tree instead of /sys, and
+// GPU_CONTROL_RUNTIME_DIR moves the stock-clock records out of
+// /run/gpu-control.
+class AmdgpuBackend : public GpuBackend {
+public:
+    AmdgpuBackend();
+    ~AmdgpuBackend() override;
+
+    // Number of amdgpu cards under the sysfs root, without opening them
+    static int detect();
+
+    QString name() const override { return "amdgpu"; }
+    int deviceCount() override { return cards.size(); }
+
+    QString pciBusId(int gpu) override;
+    QString driverVersion() override;
+    QString gpuName(int gpu) override;
+    int minPowerLimit(int gpu) override;
+    int maxPowerLimit(int gpu) override;
+    int defaultPowerLimit(int gpu) override;
+    int powerLimit(int gpu) override;
+    int memoryClock(int gpu) override;
+    int graphicsClock(int gpu) override;
+    bool memoryOffset(int gpu, int *mhz) override;
+    bool coreOffset(int gpu, int *mhz) override;
+    bool memoryOffsetRange(int gpu, int *min, int *max) override;
+    bool coreOffsetRange(int gpu, int *min, int *max) override;
+    bool supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) override;
+    bool sample(int gpu, TelemetrySample *out) override;
+
+    bool setPowerLimit(int gpu, int watts, QString *error) override;
+    bool setMemoryOffset(int gpu, int mhz, QString *error) override;
+    bool setCoreOffset(int gpu, int mhz, QString *error) override;
+    bool setGraphicsClockLock(int gpu, int min, int max, QString *error) override;
+    bool setMemoryClockLock(int gpu, int min, int max, QString *error) override;
+
+private:
+    // A sysfs attribute held open for the backend's lifetime; reading at
+    // offset 0 makes the kernel regenerate the value.
+    class Attribute {
+    public:
+        Attribute() = default;
+        ~Attribute();
+        bool open(const QString &path);
+        bool isOpen() const { return fd >= 0; }
+        QByteArray read() const;
+        bool readLong(qint64 *value) const;
+
+    private:
+        Q_DISABLE_COPY(Attribute)
+        int fd = -1;
+    };
+
+    // The parts of pp_od_clk_voltage that offsets map onto
+    struct OdTable {
+        bool valid = false;
+        bool sclkIsOffset = false;  // OD_SCLK_OFFSET rather than OD_SCLK levels
+        int sclk = -1;              // Top level, or the offset itself
+        int sclkLevel = -1;
+        int mclk = -1;
+        int mclkLevel = -1;
+        int sclkMin = -1;
+        int sclkMax = -1;
+        int mclkMin = -1;
+        int mclkMax = -1;
+    };
+
+    struct Card {
+        QString device;             // .../cardN/device
+        QString busId;
+        QString name;
+        QString hwmon;
+        Attribute powerCap;
+        Attribute powerDraw;
+        Attribute temperature;
+        Attribute sclk;
+        Attribute mclk;
+        Attribute gpuBusy;
+        Attribute memBusy;
+        Attribute od;
+        int stockSclk = -1;         // OD maxima before anything was written
+        int stockMclk = -1;
+    };
+
+    static QString root();
+    static QVector<QString> cardDevices();
+    static int currentLevel(const QByteArray &table);
+    static OdTable parseOd(const QByteArray &text);
+    void loadStock(Card *card);
+    Card *card(int gpu, QString *error = nullptr) const;
+    int hwmonWatts(const Card &card, const char *file) const;
+    bool writeAttribute(const QString &path, const QVector<QByteArray> &commands, QString *error);
+
+    QVector<Card *> cards;
+    QMutex writeMutex;          // An OD edit is two writes that must not interleave
+};
@@ -0,0 +1,181 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QVariant>
+
+#include <cstdio>
+#include <functional>
+
+#include "amdgpu-backend.h"
+
+// AmdgpuBackend against a fake sysfs tree (GPU_CONTROL_SYSFS_ROOT): one
+// board with OD_SCLK levels, one with OD_SCLK_OFFSET, and an NVIDIA card
+// that must be skipped. Checks what is read and the exact bytes written.
+// Exits non-zero when a check fails.
+
+namespace {
+
+int failures = 0;
+
+template <typename T>
+void expect(const char *name, const T &got, const T &want) {
+    if (got == want)
+        return;
+    ++failures;
+    fprintf(stderr, "FAIL %s: got %s, want %s\n", name, qPrintable(QVariant::fromValue(got).toString()),
+            qPrintable(QVariant::fromValue(want).toString()));
+}
+
+void put(const QString &path, const QByteArray &content) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        fprintf(stderr, "Cannot create %s\n", qPrintable(path));
+    file.write(content);
+}
+
+// Swaps path for an empty file and returns what call wrote into it. The
+// backend keeps reading the old file through the descriptor it holds, so
+// the tables it parses stay as they were.
+QByteArray written(const QString &path, const std::function<bool(QString *)> &call, bool *ok) {
+    QFile::remove(path);
+    put(path, QByteArray());
+    QString error;
+    *ok = call(&error);
+    if (!*ok)
+        fprintf(stderr, "%s: %s\n", qPrintable(QFileInfo(path).fileName()), qPrintable(error));
+    QFile file(path);
+    file.open(QIODevice::ReadOnly);
+    return file.readAll();
+}
+
+void fakeCard(const QString &drm, int index, const QByteArray &vendor, const QByteArray &slot,
+              const QByteArray &od) {
+    QString device = QString("%1/card%2/device").arg(drm).arg(index);
+    put(device + "/vendor", vendor + "\n");
+    put(device + "/uevent", "DRIVER=amdgpu\nPCI_ID=1002:73BF\nPCI_SLOT_NAME=" + slot + "\n");
+    put(device + "/product_name", "Radeon Test " + QByteArray::number(index) + "\n");
+    QString hwmon = device + "/hwmon/hwmon" + QString::number(index + 3);
+    put(hwmon + "/power1_cap", "250000000\n");
+    put(hwmon + "/power1_cap_min", "100000000\n");
+    put(hwmon + "/power1_cap_max", "300000000\n");
+    put(hwmon + "/power1_cap_default", "255000000\n");
+    put(hwmon + "/power1_average", "212000000\n");
+    put(hwmon + "/temp1_input", "65000\n");
+    put(device + "/pp_dpm_sclk", "0: 500Mhz\n1: 2310Mhz *\n2: 2500Mhz\n");
+    put(device + "/pp_dpm_mclk", "0: 97Mhz\n1: 456Mhz\n2: 1000Mhz *\n");
+    put(device + "/gpu_busy_percent", "97\n");
+    put(device + "/mem_busy_percent", "40\n");
+    put(device + "/pp_od_clk_voltage", od);
+}
+
+}
+
+int main() {
+    QTemporaryDir sysfs;
+    QTemporaryDir runtime;
+    if (!sysfs.isValid() || !runtime.isValid()) {
+        fprintf(stderr, "No temporary directory\n");
+        return 1;
+    }
+    qputenv("GPU_CONTROL_SYSFS_ROOT", sysfs.path().toLocal8Bit());
+    qputenv("GPU_CONTROL_RUNTIME_DIR", runtime.path().toLocal8Bit());
+
+    QString drm = sysfs.path() + "/class/drm";
+    fakeCard(drm, 0, "0x1002", "0000:03:00.0",
+             "OD_SCLK:\n0: 500Mhz\n1: 2500Mhz\nOD_MCLK:\n0: 97Mhz\n1: 1000MHz\n"
+             "OD_VDDGFX_OFFSET:\n0mV\nOD_RANGE:\nSCLK:     500Mhz       3150Mhz\nMCLK:     674Mhz       1200Mhz\n");
+    // Connector entries sit next to the cards and are not cards
+    QDir().mkpath(drm + "/card0-DP-1");
+    fakeCard(drm, 1, "0x10de", "0000:04:00.0", QByteArray());
+    fakeCard(drm, 2, "0x1002", "0000:0b:00.0",
+             "OD_SCLK_OFFSET:\n75Mhz\nOD_MCLK:\n0: 97Mhz\n1: 1249Mhz\n"
+             "OD_RANGE:\nSCLK_OFFSET:    -500Mhz       1000Mhz\nMCLK:     97Mhz       1500Mhz\n");
+    // The offset board was opened earlier this boot, at a lower memory clock
+    put(runtime.path() + "/amdgpu-0000_0b_00.0.stock", "sclk=-1\nmclk=1200\n");
+
+    expect("detect", AmdgpuBackend::detect(), 2);
+    AmdgpuBackend backend;
+    expect("deviceCount", backend.deviceCount(), 2);
+
+    // Level board: stock recorded from the table as it is now
+    expect("pciBusId", backend.pciBusId(0), QString("0000:03:00.0"));
+    expect("gpuName", backend.gpuName(0), QString("Radeon Test 0"));
+    QFile stock(runtime.path() + "/amdgpu-0000_03_00.0.stock");
+    stock.open(QIODevice::ReadOnly);
+    expect("stock record", stock.readAll(), QByteArray("sclk=2500\nmclk=1000\n"));
+    expect("minPowerLimit", backend.minPowerLimit(0), 100);
+    expect("maxPowerLimit", backend.maxPowerLimit(0), 300);
+    expect("defaultPowerLimit", backend.defaultPowerLimit(0), 255);
+    expect("powerLimit", backend.powerLimit(0), 250);
+    expect("graphicsClock", backend.graphicsClock(0), 2310);
+    expect("memoryClock", backend.memoryClock(0), 1000);
+
+    int mhz = 12345;
+    int min = 0;
+    int max = 0;
+    expect("coreOffset ok", backend.coreOffset(0, &mhz), true);
+    expect("coreOffset", mhz, 0);
+    expect("memoryOffset ok", backend.memoryOffset(0, &mhz), true);
+    expect("memoryOffset", mhz, 0);
+    expect("coreOffsetRange ok", backend.coreOffsetRange(0, &min, &max), true);
+    expect("coreOffsetRange min", min, -2000);
+    expect("coreOffsetRange max", max, 650);
+    expect("memoryOffsetRange ok", backend.memoryOffsetRange(0, &min, &max), true);
+    expect("memoryOffsetRange min", min, -652);
+    expect("memoryOffsetRange max", max, 400);
+
+    TelemetrySample sample;
+    expect("sample ok", backend.sample(0, &sample), true);
+    expect("sample power", sample.powerDraw, 212.0f);
+    expect("sample temperature", sample.temperature, 65);
+    expect("sample busy", sample.gpuUtilization, 97);
+    expect("sample memory busy", sample.memUtilization, 40);
+    expect("sample clock", sample.graphicsClock, 2310);
+
+    // Offset board: the offset is read as is; memory against the record
+    expect("offset pciBusId", backend.pciBusId(1), QString("0000:0b:00.0"));
+    expect("offset coreOffset ok", backend.coreOffset(1, &mhz), true);
+    expect("offset coreOffset", mhz, 75);
+    expect("offset memoryOffset ok", backend.memoryOffset(1, &mhz), true);
+    expect("offset memoryOffset", mhz, 98);
+    expect("offset coreOffsetRange ok", backend.coreOffsetRange(1, &min, &max), true);
+    expect("offset coreOffsetRange min", min, -500);
+    expect("offset coreOffsetRange max", max, 1000);
+
+    // Writes: one command per write(), OD edits followed by a commit
+    bool ok = false;
+    QString level = sysfs.path() + "/class/drm/card0/device";
+    QString offset = sysfs.path() + "/class/drm/card2/device";
+    expect("write power1_cap", written(level + "/hwmon/hwmon3/power1_cap", [&](QString *error) {
+        return backend.setPowerLimit(0, 280, error);
+    }, &ok), QByteArray("280000000"));
+    expect("write power1_cap ok", ok, true);
+    expect("write core level", written(level + "/pp_od_clk_voltage", [&](QString *error) {
+        return backend.setCoreOffset(0, 100, error);
+    }, &ok), QByteArray("s 1 2600\nc\n"));
+    expect("write core level ok", ok, true);
+    expect("write memory level", written(level + "/pp_od_clk_voltage", [&](QString *error) {
+        return backend.setMemoryOffset(0, 200, error);
+    }, &ok), QByteArray("m 1 1100\nc\n"));
+    expect("write memory level ok", ok, true);
+    expect("write core offset", written(offset + "/pp_od_clk_voltage", [&](QString *error) {
+        return backend.setCoreOffset(1, -30, error);
+    }, &ok), QByteArray("s -30\nc\n"));
+    expect("write core offset ok", ok, true);
+    expect("write memory offset", written(offset + "/pp_od_clk_voltage", [&](QString *error) {
+        return backend.setMemoryOffset(1, -100, error);
+    }, &ok), QByteArray("m 1 1150\nc\n"));
+    expect("write memory offset ok", ok, true);
+
+    // Nothing to undo on an unlock; a real lock is refused without a write
+    QString error;
+    expect("unlock", backend.setGraphicsClockLock(0, 0, 0, &error), true);
+    expect("lock", backend.setGraphicsClockLock(0, 1000, 2000, &error), false);
+    expect("no such GPU", backend.setPowerLimit(2, 200, &error), false);
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+# Shared by the nvidia-smi, nvidia-settings and sudo stand-ins used by
+# gpu-control-bench. Everything is driven by the environment:
+#   GPU_CONTROL_STUB_LOG         every invocation is appended here (fork count)
+#   GPU_CONTROL_STUB_LATENCY_MS  delay before each tool answers
+#   GPU_CONTROL_STUB_STATE       directory holding the writable per-GPU state
+#   GPU_CONTROL_STUB_GPUS        number of GPUs (default 1)
+#   GPU_CONTROL_STUB_NAME        board name
+#   GPU_CONTROL_STUB_DRIVER      driver version
+#   GPU_CONTROL_STUB_NO_DISPLAY  nvidia-settings fails as if X were not up
+
+stub_log() {
+    [ -n "$GPU_CONTROL_STUB_LOG" ] && echo "$*" >> "$GPU_CONTROL_STUB_LOG"
+}
+
+stub_delay() {
+    local ms=${GPU_CONTROL_STUB_LATENCY_MS:-0}
+    [ "$ms" -gt 0 ] && sleep "$((ms / 1000)).$(printf '%03d' $((ms % 1000)))"
+}
+
+STUB_GPUS=${GPU_CONTROL_STUB_GPUS:-1}
+STUB_NAME=${GPU_CONTROL_STUB_NAME:-NVIDIA GeForce RTX 4090}
+STUB_DRIVER=${GPU_CONTROL_STUB_DRIVER:-550.54.14}
+STUB_STATE=${GPU_CONTROL_STUB_STATE:-${TMPDIR:-/tmp}/gpu-control-stub-state}
+mkdir -p "$STUB_STATE"
+
+# state <gpu> <key> <default>
+state() {
+    local file="$STUB_STATE/gpu$1.$2"
+    if [ -f "$file" ]; then cat "$file"; else echo "$3"; fi
+}
+
+set_state() {
+    echo "$3" > "$STUB_STATE/gpu$1.$2"
+}
@@ -0,0 +1,121 @@
+#include "config.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+QString GpuConfig::path(const QString &profile) {
+    if (profile.isEmpty())
+        return QDir::homePath() + "/.config/gpu-control.conf";
+    return QDir::homePath() + "/.config/gpu-control/profiles/" + profile + ".conf";
+}
+
+QStringList GpuConfig::profiles() {
+    QStringList names;
+    QDir dir(QFileInfo(path("x")).absolutePath());
+    for (const QFileInfo &info : dir.entryInfoList(QStringList() << "*.conf", QDir::Files, QDir::Name))
+        names << info.completeBaseName();
+    return names;
+}
+
+GpuConfig GpuConfig::load(const QString &fileName) {
+    GpuConfig config;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return config;
+
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        auto parts = line.split("=");
+        if (parts.size() != 2)
+            continue;
+
+        QString key = parts[0].trimmed();
+        int value = parts[1].trimmed().toInt();
+        if (key == "startup") {
+            config.startup = parts[1].trimmed() == "1";
+            continue;
+        }
+        if (key == "idle") {
+            config.idleProfile = parts[1].trimmed();
+            continue;
+        }
+        if (key.startsWith("rule.")) {
+            for (const QString &pattern : parts[1].split(',', Qt::SkipEmptyParts)) {
+                ProfileRule rule;
+                rule.profile = key.mid(5);
+                rule.pattern = pattern.trimmed();
+                config.rules.append(rule);
+            }
+            continue;
+        }
+
+        // gpuN.field, or a bare field for GPU 0
+        int gpu = 0;
+        if (key.startsWith("gpu") && key.contains('.')) {
+            bool ok = false;
+            gpu = key.mid(3, key.indexOf('.') - 3).toInt(&ok);
+            if (!ok || gpu < 0)
+                continue;
+            key = key.mid(key.indexOf('.') + 1);
+        }
+
+        if (key == "power") config.gpus[gpu].powerLimit = value;
+        if (key == "memory") config.gpus[gpu].memoryOffset = value;
+        if (key == "core") config.gpus[gpu].coreOffset = value;
+        if (key == "efficient") config.efficientLimits[gpu] = value;
+        if (key == "lockgc" || key == "lockmc") {
+            QStringList range = parts[1].split(',');
+            int min = range.value(0).trimmed().toInt();
+            int max = range.value(1).trimmed().toInt();
+            if (range.size() != 2 || min <= 0 || max < min)
+                continue;
+            GpuSettings &settings = config.gpus[gpu];
+            (key == "lockgc" ? settings.graphicsLockMin : settings.memoryLockMin) = min;
+            (key == "lockgc" ? settings.graphicsLockMax : settings.memoryLockMax) = max;
+        }
+    }
+    return config;
+}
+
+bool GpuConfig::save(const QString &fileName) const {
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream(&file) << toText();
+    return true;
+}
+
+QString GpuConfig::toText() const {
+    QString text;
+    QTextStream out(&text);
+    for (auto it = gpus.constBegin(); it != gpus.constEnd(); ++it) {
+        out << "gpu" << it.key() << ".power=" << it->powerLimit << "\n";
+        out << "gpu" << it.key() << ".memory=" << it->memoryOffset << "\n";
+        out << "gpu" << it.key() << ".core=" << it->coreOffset << "\n";
+        if (it->graphicsLockMax > 0)
+            out << "gpu" << it.key() << ".lockgc=" << it->graphicsLockMin << "," << it->graphicsLockMax << "\n";
+        if (it->memoryLockMax > 0)
+            out << "gpu" << it.key() << ".lockmc=" << it->memoryLockMin << "," << it->memoryLockMax << "\n";
+    }
+    for (auto it = efficientLimits.constBegin(); it != efficientLimits.constEnd(); ++it)
+        out << "gpu" << it.key() << ".efficient=" << *it << "\n";
+    out << "startup=" << (startup ? "1" : "0") << "\n";
+    // One line per profile, in the order its first rule appeared
+    QStringList order;
+    QMap<QString, QStringList> patterns;
+    for (const ProfileRule &rule : rules) {
+        if (!patterns.contains(rule.profile))
+            order << rule.profile;
+        patterns[rule.profile] << rule.pattern;
+    }
+    for (const QString &profile : order)
+        out << "rule." << profile << "=" << patterns[profile].join(',') << "\n";
+    if (!idleProfile.isEmpty())
+        out << "idle=" << idleProfile << "\n";
+    return text;
+}
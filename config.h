@@ -0,0 +1,40 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Switches to profile while a process matching pattern runs. The pattern is
+// a wildcard on the process name, or with a "cgroup:" prefix a substring of
+// its cgroup path (a systemd unit or a batch job's slice).
+struct ProfileRule {
+    QString profile;
+    QString pattern;
+};
+
+// ~/.config/gpu-control.conf: per-GPU settings as gpuN.power=, gpuN.memory=
+// and gpuN.core= lines plus the startup flag. The flat power=/memory=/core=
+// lines written by older versions are read as GPU 0. Named profiles use the
+// same format under ~/.config/gpu-control/profiles/. gpuN.efficient= holds
+// the power limit a sweep found to give the best throughput per watt.
+// gpuN.lockgc=min,max and gpuN.lockmc=min,max lock the graphics and memory
+// clocks to a range in MHz; without them the clocks are left unlocked.
+// rule.NAME=pattern,pattern lines map workloads to profile NAME, earlier
+// lines winning, and idle=NAME names the profile for when none match.
+struct GpuConfig {
+    QMap<int, GpuSettings> gpus;
+    QMap<int, int> efficientLimits;
+    bool startup = false;
+    QVector<ProfileRule> rules;
+    QString idleProfile;        // Empty: the main settings
+
+    // The main config file, or the file of the named profile
+    static QString path(const QString &profile = QString());
+    static QStringList profiles();
+    static GpuConfig load(const QString &file = path());
+    bool save(const QString &file = path()) const;
+    QString toText() const;
+};
@@ -0,0 +1,77 @@
+#include "diagnostics-panel.h"
+#include "tracer.h"
+
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+DiagnosticsPanel::DiagnosticsPanel(QWidget *parent) : QWidget(parent, Qt::Tool) {
+    setWindowTitle("GPU Control Diagnostics");
+    resize(640, 360);
+
+    auto *layout = new QVBoxLayout(this);
+    table = new QTableWidget(0, 6);
+    table->setHorizontalHeaderLabels(QStringList() << "Operation" << "Count" << "Failed"
+                                     << "p50 ms" << "p95 ms" << "Max ms");
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    table->verticalHeader()->setVisible(false);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSortingEnabled(true);
+    layout->addWidget(table);
+
+    auto *buttons = new QHBoxLayout();
+    auto *saveBtn = new QPushButton("Save Trace...");
+    buttons->addStretch();
+    buttons->addWidget(saveBtn);
+    layout->addLayout(buttons);
+
+    refreshTimer = new QTimer(this);
+    connect(refreshTimer, &QTimer::timeout, this, &DiagnosticsPanel::refresh);
+    connect(saveBtn, &QPushButton::clicked, this, &DiagnosticsPanel::saveTrace);
+}
+
+void DiagnosticsPanel::showEvent(QShowEvent *event) {
+    refresh();
+    refreshTimer->start(1000);
+    QWidget::showEvent(event);
+}
+
+void DiagnosticsPanel::hideEvent(QHideEvent *event) {
+    refreshTimer->stop();
+    QWidget::hideEvent(event);
+}
+
+void DiagnosticsPanel::refresh() {
+    auto number = [](double value, int decimals) {
+        auto *item = new QTableWidgetItem();
+        item->setData(Qt::DisplayRole, decimals ? QVariant(QString::number(value, 'f', decimals).toDouble())
+                                                : QVariant(int(value)));
+        item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        return item;
+    };
+
+    QVector<TraceStats> stats = Tracer::instance().stats();
+    table->setSortingEnabled(false);
+    table->setRowCount(stats.size());
+    for (int row = 0; row < stats.size(); ++row) {
+        const TraceStats &s = stats[row];
+        table->setItem(row, 0, new QTableWidgetItem(s.name));
+        table->setItem(row, 1, number(s.count, 0));
+        table->setItem(row, 2, number(s.failures, 0));
+        table->setItem(row, 3, number(s.p50Ms, 2));
+        table->setItem(row, 4, number(s.p95Ms, 2));
+        table->setItem(row, 5, number(s.maxMs, 2));
+    }
+    table->setSortingEnabled(true);
+}
+
+void DiagnosticsPanel::saveTrace() {
+    QString path = QFileDialog::getSaveFileName(this, "Save Trace", "gpu-control-trace.json",
+                                                "Chrome trace (*.json)");
+    if (!path.isEmpty())
+        Tracer::instance().writeChromeTrace(path);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QWidget>
+
+class QTableWidget;
+class QTimer;
+
+// Hidden latency table (Ctrl+Shift+D): p50/p95/max per traced operation
+// type, refreshed once a second while shown.
+class DiagnosticsPanel : public QWidget {
+public:
+    explicit DiagnosticsPanel(QWidget *parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    void refresh();
+    void saveTrace();
+
+    QTableWidget *table;
+    QTimer *refreshTimer;
+};
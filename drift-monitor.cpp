@@ -0,0 +1,211 @@
+#include "drift-monitor.h"
+#include "tracer.h"
+
+#include <QDBusConnection>
+#include <QDBusError>
+#include <QDir>
+#include <QFileSystemWatcher>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+DriftMonitor::DriftMonitor(GpuBackend *backend, int gpuCount, QObject *parent)
+    : QObject(parent), backend(backend), gpuCount(gpuCount) {
+    periodic = new QTimer(this);
+    connect(periodic, &QTimer::timeout, this, &DriftMonitor::periodicCheck);
+    pending = new QTimer(this);
+    pending->setSingleShot(true);
+    connect(pending, &QTimer::timeout, this, &DriftMonitor::check);
+    connect(&running, &QFutureWatcherBase::finished, this, &DriftMonitor::checked);
+    displays = new QFileSystemWatcher(this);
+}
+
+DriftMonitor::~DriftMonitor() {
+    // The check holds the backend
+    running.waitForFinished();
+    if (ueventSocket >= 0)
+        close(ueventSocket);
+}
+
+void DriftMonitor::setTarget(const QMap<int, GpuSettings> &settings, int fields) {
+    QMutexLocker lock(&targetMutex);
+    target = settings;
+    this->fields = fields;
+    ++targetVersion;
+    // What it has already written back follows the old target
+    if (running.isRunning())
+        again = true;
+}
+
+void DriftMonitor::start(int checkIntervalMs) {
+    bool session = qgetenv("GPU_CONTROL_DBUS") == "session";
+    QDBusConnection bus = session ? QDBusConnection::sessionBus() : QDBusConnection::systemBus();
+    // On a private bus the signal comes from dbus-send, not logind
+    if (!bus.connect(session ? QString() : QString("org.freedesktop.login1"), "/org/freedesktop/login1",
+                     "org.freedesktop.login1.Manager", "PrepareForSleep", this, SLOT(prepareForSleep(bool))))
+        qWarning("Not watching for resume: %s", qPrintable(bus.lastError().message()));
+
+    // Kernel uevents, the same multicast group udev listens to
+    ueventSocket = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    sockaddr_nl address = {};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1;
+    if (ueventSocket >= 0 && bind(ueventSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+        uevents = new QSocketNotifier(ueventSocket, QSocketNotifier::Read, this);
+        connect(uevents, &QSocketNotifier::activated, this, &DriftMonitor::readUevents);
+    } else {
+        qWarning("Not watching driver events");
+    }
+
+    // A new X server shows up as a new socket; nvidia-settings offsets do
+    // not survive the old one
+    if (QDir("/tmp/.X11-unix").exists()) {
+        displays->addPath("/tmp/.X11-unix");
+        connect(displays, &QFileSystemWatcher::directoryChanged, this,
+                [this]() { schedule("display server change", 3000); });
+    }
+
+    if (checkIntervalMs > 0)
+        periodic->start(checkIntervalMs);
+}
+
+void DriftMonitor::prepareForSleep(bool starting) {
+    if (!starting)
+        schedule("resume", 2000);
+}
+
+void DriftMonitor::readUevents() {
+    char buffer[8192];
+    ssize_t n;
+    while ((n = recv(ueventSocket, buffer, sizeof(buffer) - 1, 0)) > 0) {
+        buffer[n] = '\0';
+        // "action@devpath" followed by NUL-separated KEY=value pairs
+        QByteArray message = QByteArray(buffer, int(n)).replace('\0', '\n');
+        if (!message.startsWith("add@") && !message.startsWith("bind@") && !message.startsWith("change@"))
+            continue;
+        if (message.contains("\nSUBSYSTEM=drm\n") || message.contains("\nDRIVER=nvidia\n")
+            || message.contains("\nDEVPATH=/module/nvidia\n"))
+            schedule("driver event", 3000);
+    }
+}
+
+// Events come in bursts; they all fold into one check
+void DriftMonitor::schedule(const QString &why, int delayMs) {
+    if (pending->isActive() && pending->remainingTime() <= delayMs)
+        return;
+    qInfo("Checking settings after %s", qPrintable(why));
+    pendingReason = why;
+    retries = 0;
+    pending->start(delayMs);
+}
+
+// Only fills a gap: an event's check, or its retries, keep their own timing
+void DriftMonitor::periodicCheck() {
+    if (pending->isActive() || running.isRunning())
+        return;
+    pendingReason = "periodic check";
+    pending->start(0);
+}
+
+void DriftMonitor::check() {
+    if (running.isRunning()) {
+        again = true;
+        return;
+    }
+    QString reason = pendingReason;
+    running.setFuture(QtConcurrent::run([this, reason]() { return compare(reason); }));
+}
+
+DriftMonitor::Outcome DriftMonitor::compare(const QString &reason) {
+    TraceSpan span("drift check", "drift", reason);
+    QMutexLocker lock(&targetMutex);
+    QMap<int, GpuSettings> target = this->target;
+    int fields = this->fields;
+    quint64 version = targetVersion;
+    lock.unlock();
+
+    Outcome outcome;
+    outcome.reason = reason;
+    for (auto it = target.constBegin(); it != target.constEnd(); ++it) {
+        int gpu = it.key();
+        if (gpu >= gpuCount)
+            continue;
+        GpuSnapshot live = backend->snapshot(gpu);
+
+        int drifted = 0;
+        if ((fields & ApplyPowerLimit) && it->powerLimit > 0) {
+            if (live.powerLimit < 0)
+                outcome.unreadable = true;
+            else if (live.powerLimit != it->powerLimit)
+                drifted |= ApplyPowerLimit;
+        }
+        // Offsets cannot be read without X; that only matters when they
+        // are meant to be anything but stock
+        if (fields & ApplyMemoryOffset) {
+            if (!live.memOffsetOk)
+                outcome.unreadable |= it->memoryOffset != 0;
+            else if (live.memoryOffset != it->memoryOffset)
+                drifted |= ApplyMemoryOffset;
+        }
+        if (fields & ApplyCoreOffset) {
+            if (!live.coreOffsetOk)
+                outcome.unreadable |= it->coreOffset != 0;
+            else if (live.coreOffset != it->coreOffset)
+                drifted |= ApplyCoreOffset;
+        }
+        if (!drifted)
+            continue;
+
+        // Clock locks cannot be read back, but whatever reset the rest
+        // reset them too
+        int repair = drifted;
+        if (it->graphicsLockMax > 0)
+            repair |= fields & ApplyGraphicsLock;
+        if (it->memoryLockMax > 0)
+            repair |= fields & ApplyMemoryLock;
+
+        // The read took a while; a new target (a profile switch or a remote
+        // apply) has been written already and must not be undone
+        lock.relock();
+        bool stale = version != targetVersion;
+        lock.unlock();
+        if (stale)
+            break;
+        ApplyResult result = backend->apply(gpu, *it, repair);
+        if (!result.ok())
+            outcome.unreadable = true;
+        outcome.repairs.append({gpu, *it, drifted, repair, result});
+    }
+    return outcome;
+}
+
+void DriftMonitor::checked() {
+    Outcome outcome = running.result();
+    for (const Repair &repair : outcome.repairs) {
+        ++drifts;
+        qInfo("GPU %d drifted after %s (%s%s%s), %s", repair.gpu, qPrintable(outcome.reason),
+              repair.drifted & ApplyPowerLimit ? "power limit " : "",
+              repair.drifted & ApplyMemoryOffset ? "memory offset " : "",
+              repair.drifted & ApplyCoreOffset ? "core offset " : "",
+              repair.result.ok() ? "re-applied" : qPrintable(repair.result.errors.join("; ")));
+        if (onRepair)
+            onRepair(repair.gpu, repair.target, repair.written, repair.result);
+    }
+
+    // An event that came in during the check gets a fresh look
+    if (again) {
+        again = false;
+        if (!pending->isActive())
+            pending->start(0);
+        return;
+    }
+    // Right after resume the driver or X may not answer yet
+    if (outcome.unreadable && retries < 4 && !pending->isActive()) {
+        ++retries;
+        pending->start(5000 << (retries - 1));
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QFutureWatcher>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+class QFileSystemWatcher;
+class QSocketNotifier;
+class QTimer;
+
+// Puts settings back when something outside the app resets them. Suspend
+// and resume (logind PrepareForSleep on the system bus), driver loads and
+// binds (kernel uevents) and X server restarts (/tmp/.X11-unix) each trigger
+// a read-back a few seconds later; a slow periodic read-back catches
+// anything else. Only attributes that differ from the target are written.
+// Reads and writes run on the thread pool, one check at a time.
+//
+// GPU_CONTROL_DBUS=session listens on the session bus instead, so a private
+// bus and dbus-send can stand in for logind.
+class DriftMonitor : public QObject {
+    Q_OBJECT
+
+public:
+    DriftMonitor(GpuBackend *backend, int gpuCount, QObject *parent = nullptr);
+    ~DriftMonitor() override;
+
+    // What the GPUs should be running; fields masks what is enforced. A
+    // check already under way stops writing and is followed by a fresh one.
+    void setTarget(const QMap<int, GpuSettings> &settings, int fields);
+    void start(int checkIntervalMs);
+
+    quint64 driftEvents() const { return drifts; }
+    // Called for every GPU that drifted, with the target, the fields found
+    // wrong and the outcome of writing them back
+    void setRepairHandler(const std::function<void(int, const GpuSettings &, int, const ApplyResult &)> &handler) {
+        onRepair = handler;
+    }
+
+private slots:
+    void prepareForSleep(bool starting);
+
+private:
+    struct Repair {
+        int gpu;
+        GpuSettings target;
+        int drifted;        // Fields found wrong
+        int written;        // Fields written back
+        ApplyResult result;
+    };
+    struct Outcome {
+        QString reason;
+        QVector<Repair> repairs;
+        bool unreadable = false;
+    };
+
+    void schedule(const QString &why, int delayMs);
+    void periodicCheck();
+    void check();
+    void checked();
+    // Runs on the thread pool
+    Outcome compare(const QString &reason);
+    void readUevents();
+
+    GpuBackend *backend;
+    int gpuCount;
+    QMutex targetMutex;     // Guards target, fields and targetVersion
+    QMap<int, GpuSettings> target;
+    int fields = ApplyAll;
+    quint64 targetVersion = 0;
+    quint64 drifts = 0;
+    std::function<void(int, const GpuSettings &, int, const ApplyResult &)> onRepair;
+
+    QTimer *periodic;
+    QTimer *pending;
+    QString pendingReason;
+    int retries = 0;
+    QFutureWatcher<Outcome> running;
+    bool again = false;     // Something asked for a check while one ran
+    int ueventSocket = -1;
+    QSocketNotifier *uevents = nullptr;
+    QFileSystemWatcher *displays;
+};
@@ -0,0 +1,187 @@
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QSemaphore>
+#include <QString>
+#include <QThread>
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+
+#include "drift-monitor.h"
+#include "mock-backend.h"
+
+// DriftMonitor on the mock backend, with a private session bus standing in
+// for logind (GPU_CONTROL_DBUS=session) and PrepareForSleep sent from a
+// second connection the way logind sends it. Exits 77, which ctest counts
+// as skipped, where dbus-daemon is unavailable; non-zero when a check fails.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *name, const QString &detail) {
+    if (ok)
+        return;
+    ++failures;
+    fprintf(stderr, "FAIL %s: %s\n", name, qPrintable(detail));
+}
+
+// Holds a drift check inside its first power limit read until the test
+// lets it go, so a target change can land mid-check every time
+class GatedMock : public MockBackend {
+public:
+    int powerLimit(int gpu) override {
+        if (gated.exchange(false)) {
+            reading.release();
+            proceed.acquire();
+        }
+        return MockBackend::powerLimit(gpu);
+    }
+
+    std::atomic<bool> gated{false};
+    QSemaphore reading;
+    QSemaphore proceed;
+};
+
+// Runs the event loop until done() or the timeout; returns done()
+bool waitUntil(const std::function<bool()> &done, int timeoutMs) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!done() && timer.elapsed() < timeoutMs) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        QThread::msleep(10);
+    }
+    return done();
+}
+
+void settle(int ms) {
+    waitUntil([]() { return false; }, ms);
+}
+
+void sendResume(QDBusConnection &logind) {
+    QDBusMessage signal = QDBusMessage::createSignal("/org/freedesktop/login1", "org.freedesktop.login1.Manager",
+                                                     "PrepareForSleep");
+    signal << false;
+    logind.send(signal);
+}
+
+QMap<int, GpuSettings> target(int power, int memory, int core) {
+    GpuSettings settings;
+    settings.powerLimit = power;
+    settings.memoryOffset = memory;
+    settings.coreOffset = core;
+    QMap<int, GpuSettings> gpus;
+    gpus[0] = settings;
+    gpus[1] = settings;
+    return gpus;
+}
+
+void put(GpuBackend *backend, const QMap<int, GpuSettings> &gpus) {
+    for (auto it = gpus.constBegin(); it != gpus.constEnd(); ++it)
+        backend->apply(it.key(), *it, ApplyPowerLimit | ApplyMemoryOffset | ApplyCoreOffset);
+}
+
+// A resume puts back what the "driver" reset on one GPU, and only that
+void repairsAfterResume(QDBusConnection &logind) {
+    MockBackend mock;
+    QMap<int, GpuSettings> wanted = target(300, 500, 50);
+    put(&mock, wanted);
+
+    DriftMonitor monitor(&mock, 2);
+    monitor.setTarget(wanted, ApplyAll);
+    int repairs = 0;
+    int repaired = 0;
+    monitor.setRepairHandler([&](int gpu, const GpuSettings &, int fields, const ApplyResult &result) {
+        ++repairs;
+        check(gpu == 0, "resume", QString("GPU %1 repaired, only GPU 0 drifted").arg(gpu));
+        check(result.ok(), "resume", result.errors.join("; "));
+        repaired |= fields;
+    });
+    monitor.start(0);
+
+    QString error;
+    mock.setPowerLimit(0, 350, &error);
+    mock.setMemoryOffset(0, 0, &error);
+    sendResume(logind);
+    bool restored = waitUntil([&]() { return repairs > 0; }, 10000);
+    check(restored, "resume", "no check within 10 s of PrepareForSleep(false)");
+    int memory = 0;
+    mock.memoryOffset(0, &memory);
+    check(mock.powerLimit(0) == 300 && memory == 500, "resume",
+          QString("GPU 0 at %1 W, memory %2 after the check").arg(mock.powerLimit(0)).arg(memory));
+    check((repaired & (ApplyPowerLimit | ApplyMemoryOffset)) == (ApplyPowerLimit | ApplyMemoryOffset)
+          && !(repaired & ApplyCoreOffset), "resume", QString("wrote fields 0x%1").arg(repaired, 0, 16));
+    check(monitor.driftEvents() == 1, "resume", QString("%1 drift events").arg(monitor.driftEvents()));
+}
+
+// A profile switch while a check reads must win over the check's stale
+// target, which would otherwise write the old profile back
+void targetChangesMidCheck(QDBusConnection &logind) {
+    GatedMock mock;
+    QMap<int, GpuSettings> before = target(300, 500, 50);
+    QMap<int, GpuSettings> after = target(200, 1000, 0);
+    put(&mock, before);
+
+    DriftMonitor monitor(&mock, 2);
+    monitor.setTarget(before, ApplyAll);
+    monitor.start(0);
+
+    QString error;
+    mock.setPowerLimit(0, 350, &error);
+    mock.gated = true;
+    sendResume(logind);
+    bool reading = waitUntil([&]() { return mock.reading.tryAcquire(); }, 10000);
+    check(reading, "mid-check", "no check within 10 s of PrepareForSleep(false)");
+
+    put(&mock, after);
+    monitor.setTarget(after, ApplyAll);
+    mock.proceed.release();
+    settle(1000);
+
+    for (int gpu = 0; gpu < 2; ++gpu) {
+        int memory = 0;
+        mock.memoryOffset(gpu, &memory);
+        check(mock.powerLimit(gpu) == 200 && memory == 1000, "mid-check",
+              QString("GPU %1 at %2 W, memory %3; the old target was written back")
+                  .arg(gpu).arg(mock.powerLimit(gpu)).arg(memory));
+    }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    qputenv("GPU_CONTROL_MOCK_GPUS", "2");
+    qunsetenv("GPU_CONTROL_MOCK_LATENCY_MS");
+    qunsetenv("GPU_CONTROL_MOCK_RESET_MS");
+    qputenv("GPU_CONTROL_DBUS", "session");
+
+    QProcess daemon;
+    daemon.start("dbus-daemon", QStringList() << "--session" << "--nofork" << "--print-address=1");
+    if (!daemon.waitForStarted(5000) || !daemon.waitForReadyRead(5000)) {
+        fprintf(stderr, "SKIP: cannot start a private dbus-daemon\n");
+        return 77;
+    }
+    qputenv("DBUS_SESSION_BUS_ADDRESS", daemon.readLine().trimmed());
+
+    QCoreApplication app(argc, argv);
+    {
+        QDBusConnection logind = QDBusConnection::connectToBus(QDBusConnection::SessionBus, "logind");
+        if (!logind.isConnected()) {
+            fprintf(stderr, "SKIP: cannot connect to the private bus\n");
+            return 77;
+        }
+        repairsAfterResume(logind);
+        targetChangesMidCheck(logind);
+    }
+    QDBusConnection::disconnectFromBus("logind");
+
+    daemon.kill();
+    daemon.waitForFinished(2000);
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+#include <QString>
+#include <QVector>
+
+#include <cstdio>
+
+#include "governor.h"
+#include "mock-backend.h"
+
+// PowerGovernor closed around the mock backend's thermal model (0.14 °C/W
+// over 30 °C ambient, 10 s lag) on simulated time, one sample per 100 ms as
+// the telemetry sampler delivers them. Exits non-zero when a check fails.
+
+namespace {
+
+const int SAMPLE_MS = 100;
+int failures = 0;
+
+void check(bool ok, const char *name, const QString &detail) {
+    if (ok)
+        return;
+    ++failures;
+    fprintf(stderr, "FAIL %s: %s\n", name, qPrintable(detail));
+}
+
+struct Step {
+    qint64 ms;
+    int temperature;
+    int limit;
+    bool wrote;
+};
+
+// Sample, update, write, as GpuControl does for one GPU
+class Loop {
+public:
+    explicit Loop(const GovernorOptions &options) : governor(options, mock.powerLimit(0)) {}
+
+    QVector<Step> run(qint64 ms, bool fullLoad) {
+        mock.simulateWorkload(0, fullLoad, nullptr);
+        QVector<Step> steps;
+        for (qint64 end = now + ms; now < end;) {
+            mock.advanceClock(SAMPLE_MS);
+            now += SAMPLE_MS;
+            TelemetrySample sample;
+            mock.sample(0, &sample);
+            sample.timestampMs = now;
+            int limit = governor.update(sample);
+            if (limit >= 0) {
+                QString error;
+                check(mock.setPowerLimit(0, limit, &error), "write", error);
+            }
+            steps.append({now, sample.temperature, mock.powerLimit(0), limit >= 0});
+        }
+        return steps;
+    }
+
+    MockBackend mock;
+    PowerGovernor governor;
+    qint64 now = 0;
+};
+
+QVector<Step> last(const QVector<Step> &steps, qint64 ms) {
+    QVector<Step> tail;
+    for (const Step &step : steps) {
+        if (step.ms > steps.last().ms - ms)
+            tail.append(step);
+    }
+    return tail;
+}
+
+// Writes never come closer together than the governor's minimum interval
+void checkWriteRate(const char *name, const QVector<Step> &steps, const GovernorOptions &options) {
+    qint64 previous = -1;
+    for (const Step &step : steps) {
+        if (!step.wrote)
+            continue;
+        check(previous < 0 || step.ms - previous >= options.minWriteIntervalMs, name,
+              QString("writes %1 ms apart at %2 s").arg(step.ms - previous).arg(step.ms / 1000.0));
+        previous = step.ms;
+    }
+}
+
+void checkBounds(const char *name, const QVector<Step> &steps, const GovernorOptions &options) {
+    for (const Step &step : steps) {
+        check(step.limit >= options.minPower && step.limit <= options.maxPower, name,
+              QString("limit %1 W at %2 s").arg(step.limit).arg(step.ms / 1000.0));
+    }
+}
+
+// Full load from the stock 350 W limit would settle near 79 °C; the
+// governor has to find the limit that holds 78 and then leave it alone
+void settles() {
+    GovernorOptions options;
+    Loop loop(options);
+    QVector<Step> steps = loop.run(600000, true);
+
+    QVector<Step> tail = last(steps, 120000);
+    int writes = 0;
+    for (const Step &step : tail) {
+        check(step.temperature <= options.target && step.temperature >= options.target - 3, "settles",
+              QString("%1 °C at %2 s").arg(step.temperature).arg(step.ms / 1000.0));
+        writes += step.wrote;
+    }
+    check(writes <= 2, "settles", QString("%1 writes in the last two minutes").arg(writes));
+    checkWriteRate("settles write rate", steps, options);
+    checkBounds("settles bounds", steps, options);
+}
+
+// A swinging, lighter load never reaches the target, so the limit parks at
+// maxPower. Once full load starts the integral must not have wound up past
+// the bound, or the limit would sit at the maximum for a minute or more.
+void antiWindup() {
+    GovernorOptions options;
+    Loop loop(options);
+    QVector<Step> light = loop.run(300000, false);
+    check(light.last().limit == options.maxPower, "anti-windup",
+          QString("limit %1 W under light load, expected the %2 W bound").arg(light.last().limit).arg(options.maxPower));
+    checkBounds("anti-windup bounds", light, options);
+
+    QVector<Step> heavy = loop.run(300000, true);
+    qint64 reacted = -1;
+    for (const Step &step : heavy) {
+        if (step.limit < options.maxPower) {
+            reacted = step.ms - light.last().ms;
+            break;
+        }
+    }
+    check(reacted >= 0 && reacted <= 20000, "anti-windup",
+          QString("limit first lowered %1 s after full load").arg(reacted / 1000.0));
+    for (const Step &step : last(heavy, 60000))
+        check(step.temperature <= options.target, "anti-windup",
+              QString("%1 °C at %2 s").arg(step.temperature).arg(step.ms / 1000.0));
+    checkWriteRate("anti-windup write rate", light + heavy, options);
+    checkBounds("anti-windup bounds", heavy, options);
+}
+
+// 40 °C needs less than the minimum limit gives; the limit stops at the
+// bound and the governor stops writing
+void clampsLow() {
+    GovernorOptions options;
+    options.target = 40;
+    Loop loop(options);
+    QVector<Step> steps = loop.run(300000, true);
+
+    QVector<Step> tail = last(steps, 60000);
+    int writes = 0;
+    for (const Step &step : tail) {
+        check(step.limit == options.minPower, "clamps low", QString("limit %1 W at %2 s").arg(step.limit).arg(step.ms / 1000.0));
+        writes += step.wrote;
+    }
+    check(writes == 0, "clamps low", QString("%1 writes while parked at the bound").arg(writes));
+    checkBounds("clamps low bounds", steps, options);
+}
+
+}
+
+int main() {
+    qputenv("GPU_CONTROL_MOCK_GPUS", "1");
+    qunsetenv("GPU_CONTROL_MOCK_LATENCY_MS");
+    qunsetenv("GPU_CONTROL_MOCK_RESET_MS");
+
+    settles();
+    antiWindup();
+    clampsLow();
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+#include "governor.h"
+
+#include <QtMath>
+
+// NVML clocks throttle reasons that mean "too hot"
+static const quint64 ThermalReasons = 0x8 | 0x20 | 0x40;
+static const quint64 PowerCapReason = 0x4;
+
+bool GovernorOptions::parse(const QString &spec, GovernorOptions *options) {
+    QString kind = spec.section(':', 0, 0).trimmed().toLower();
+    QString value = spec.section(':', 1).trimmed();
+    bool ok = true;
+    if (kind == "no-throttle") {
+        options->mode = AvoidThermalThrottle;
+        return value.isEmpty();
+    } else if (kind == "temp" || kind == "temperature") {
+        options->mode = HoldTemperature;
+        options->target = value.toDouble(&ok);
+        return ok && options->target > 0 && options->target < 120;
+    } else if (kind == "clock") {
+        options->mode = HoldClock;
+        options->target = value.toDouble(&ok);
+        return ok && options->target > 0;
+    }
+    return false;
+}
+
+QString GovernorOptions::describe() const {
+    switch (mode) {
+    case HoldTemperature:
+        return QString("hold %1 °C").arg(target);
+    case AvoidThermalThrottle:
+        return "avoid thermal throttle";
+    case HoldClock:
+        return QString("hold %1 MHz").arg(target);
+    }
+    return QString();
+}
+
+PowerGovernor::PowerGovernor(const GovernorOptions &options, int initialLimit)
+    : options(options) {
+    written = qBound(options.minPower, initialLimit, options.maxPower);
+    integral = written;
+}
+
+double PowerGovernor::error(const TelemetrySample &sample) const {
+    // Positive error means there is headroom and the limit may go up
+    switch (options.mode) {
+    case HoldTemperature:
+        return temperature < 0 ? 0 : options.target - temperature;
+    case AvoidThermalThrottle:
+        // Back off hard while throttling; creep up only while the power cap
+        // is what holds the clocks back, otherwise a higher limit buys nothing
+        if (sample.throttleReasons & ThermalReasons)
+            return -3;
+        return sample.throttleReasons & PowerCapReason ? 1 : 0;
+    case HoldClock:
+        // Only a busy GPU says anything about the clock a limit can hold
+        if (clock < 0 || sample.gpuUtilization < 50)
+            return 0;
+        return (options.target - clock) / 10;
+    }
+    return 0;
+}
+
+int PowerGovernor::update(const TelemetrySample &sample) {
+    if (sample.temperature >= 0)
+        temperature = temperature < 0 ? sample.temperature : temperature + 0.3 * (sample.temperature - temperature);
+    if (sample.graphicsClock >= 0)
+        clock = clock < 0 ? sample.graphicsClock : clock + 0.3 * (sample.graphicsClock - clock);
+
+    // A gap in the samples must not turn into one huge integral step
+    double dt = lastSampleMs < 0 ? 0 : qBound<qint64>(0, sample.timestampMs - lastSampleMs, 5000) / 1000.0;
+    lastSampleMs = sample.timestampMs;
+
+    // A cold card is far below any target; clipping the upward error keeps
+    // that from winding the limit up faster than the die can heat, which
+    // would overshoot by the time the temperature caught up
+    double e = qBound(-10.0, error(sample), 3.0);
+    if (qAbs(e) < options.hysteresis)
+        e = 0;
+
+    // Clamping the integral is the anti-windup: a target the limit range
+    // cannot reach leaves it parked at the bound, ready to move back.
+    // Throttle flags are on/off, so that mode is integral only.
+    integral = qBound<double>(options.minPower, integral + options.ki * e * dt, options.maxPower);
+    double proportional = options.mode == GovernorOptions::AvoidThermalThrottle ? 0 : options.kp * e;
+    int output = qRound(qBound<double>(options.minPower, integral + proportional, options.maxPower));
+
+    if (output == written)
+        return -1;
+    bool atBound = output == options.minPower || output == options.maxPower;
+    if (qAbs(output - written) < options.minWriteDelta && !atBound)
+        return -1;
+    if (lastWriteMs >= 0 && sample.timestampMs - lastWriteMs < options.minWriteIntervalMs)
+        return -1;
+
+    lastWriteMs = sample.timestampMs;
+    written = output;
+    return output;
+}
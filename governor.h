@@ -0,0 +1,56 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QString>
+
+struct GovernorOptions {
+    enum Mode {
+        HoldTemperature,    // Keep the filtered temperature at or below target
+        AvoidThermalThrottle,
+        HoldClock,          // Least power that keeps the graphics clock at target
+    };
+
+    Mode mode = HoldTemperature;
+    double target = 78;         // °C or MHz, depending on mode
+    int minPower = 100;
+    int maxPower = 450;
+
+    // Gains per degree (or per 10 MHz) of error; the integral term carries
+    // the steady-state limit, the proportional term reacts to changes.
+    double kp = 3.0;
+    double ki = 0.2;
+    double hysteresis = 1.0;    // Errors smaller than this count as on target
+    int minWriteIntervalMs = 2000;
+    int minWriteDelta = 5;      // Watts; smaller corrections are not written
+
+    // "temp:78", "no-throttle" or "clock:1800"
+    static bool parse(const QString &spec, GovernorOptions *options);
+    QString describe() const;
+};
+
+// PI controller from telemetry to a power limit. Feed it every sample for
+// one GPU; it answers with a new limit only when the change is big enough
+// and the last write is old enough, so the driver sees a handful of writes
+// a minute at most.
+class PowerGovernor {
+public:
+    PowerGovernor(const GovernorOptions &options, int initialLimit);
+
+    // Returns the limit to write now, or -1 to leave it alone
+    int update(const TelemetrySample &sample);
+
+    int limit() const { return written; }
+    double filteredTemperature() const { return temperature; }
+
+private:
+    double error(const TelemetrySample &sample) const;
+
+    GovernorOptions options;
+    double integral;            // Steady-state limit in watts
+    double temperature = -1;    // Exponentially smoothed
+    double clock = -1;
+    qint64 lastSampleMs = -1;
+    qint64 lastWriteMs = -1;
+    int written;
+};
@@ -0,0 +1,76 @@
+#include "gpu-backend.h"
+#include "amdgpu-backend.h"
+#include "mock-backend.h"
+#include "nvml-backend.h"
+#include "smi-backend.h"
+
+GpuBackend *GpuBackend::create(const QString &kind) {
+    QString choice = kind.isEmpty() ? qEnvironmentVariable("GPU_CONTROL_BACKEND") : kind;
+
+    if (choice == "mock")
+        return new MockBackend();
+    if (choice == "smi")
+        return new SmiBackend();
+    if (choice == "amdgpu")
+        return new AmdgpuBackend();
+
+    auto *nvml = new NvmlBackend();
+    if (nvml->isLoaded())
+        return nvml;
+    delete nvml;
+    if (AmdgpuBackend::detect() > 0)
+        return new AmdgpuBackend();
+    return new SmiBackend();
+}
+
+GpuSnapshot GpuBackend::snapshot(int gpu) {
+    GpuSnapshot snap;
+    snap.pciBusId = pciBusId(gpu);
+    snap.driverVersion = driverVersion();
+    snap.powerLimit = powerLimit(gpu);
+    snap.memoryClock = memoryClock(gpu);
+    snap.graphicsClock = graphicsClock(gpu);
+    snap.memOffsetOk = memoryOffset(gpu, &snap.memoryOffset);
+    snap.coreOffsetOk = coreOffset(gpu, &snap.coreOffset);
+    return snap;
+}
+
+GpuStaticInfo GpuBackend::staticInfo(int gpu) {
+    GpuStaticInfo info;
+    info.name = gpuName(gpu);
+    info.minPowerLimit = minPowerLimit(gpu);
+    info.maxPowerLimit = maxPowerLimit(gpu);
+    info.defaultPowerLimit = defaultPowerLimit(gpu);
+    memoryOffsetRange(gpu, &info.memOffsetMin, &info.memOffsetMax);
+    coreOffsetRange(gpu, &info.coreOffsetMin, &info.coreOffsetMax);
+    supportedClocks(gpu, &info.memoryClocks, &info.graphicsClocks);
+    return info;
+}
+
+ApplyResult GpuBackend::apply(int gpu, const GpuSettings &settings, int fields) {
+    ApplyResult result;
+    QString error;
+    if ((fields & ApplyPowerLimit) && !setPowerLimit(gpu, settings.powerLimit, &error)) {
+        result.failedFields |= ApplyPowerLimit;
+        result.errors << "Power limit: " + error;
+    }
+    if ((fields & ApplyMemoryOffset) && !setMemoryOffset(gpu, settings.memoryOffset, &error)) {
+        result.failedFields |= ApplyMemoryOffset;
+        result.errors << "Memory offset: " + error;
+    }
+    if ((fields & ApplyCoreOffset) && !setCoreOffset(gpu, settings.coreOffset, &error)) {
+        result.failedFields |= ApplyCoreOffset;
+        result.errors << "Core offset: " + error;
+    }
+    if ((fields & ApplyGraphicsLock)
+        && !setGraphicsClockLock(gpu, settings.graphicsLockMin, settings.graphicsLockMax, &error)) {
+        result.failedFields |= ApplyGraphicsLock;
+        result.errors << "Graphics clock lock: " + error;
+    }
+    if ((fields & ApplyMemoryLock)
+        && !setMemoryClockLock(gpu, settings.memoryLockMin, settings.memoryLockMax, &error)) {
+        result.failedFields |= ApplyMemoryLock;
+        result.errors << "Memory clock lock: " + error;
+    }
+    return result;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Properties that never change for a given board and driver version
+struct GpuStaticInfo {
+    QString name;
+    int minPowerLimit = -1;
+    int maxPowerLimit = -1;
+    int defaultPowerLimit = -1;
+    int memOffsetMin = -2000;
+    int memOffsetMax = 6000;
+    int coreOffsetMin = -1000;
+    int coreOffsetMax = 1000;
+    // Clocks the driver accepts for locking, highest first; empty when the
+    // board or backend cannot lock clocks
+    QVector<int> memoryClocks;
+    QVector<int> graphicsClocks;
+};
+
+// Everything that can change at runtime, read in one go
+struct GpuSnapshot {
+    QString pciBusId;
+    QString driverVersion;
+    int powerLimit = -1;
+    int memoryClock = -1;
+    int graphicsClock = -1;
+    bool memOffsetOk = false;
+    int memoryOffset = 0;
+    bool coreOffsetOk = false;
+    int coreOffset = 0;
+};
+
+// One telemetry reading. Plain data so it can be copied through a ring
+// buffer without allocating; -1 marks a value the backend couldn't read.
+struct TelemetrySample {
+    qint64 timestampMs = 0;
+    int gpu = 0;
+    float powerDraw = -1;
+    int graphicsClock = -1;
+    int memoryClock = -1;
+    int temperature = -1;
+    int gpuUtilization = -1;
+    int memUtilization = -1;
+    quint64 throttleReasons = 0;    // NVML clocks throttle reason bits
+};
+
+// Values written by an apply. Only the fields selected in the apply mask
+// are touched.
+struct GpuSettings {
+    int powerLimit = 0;
+    int memoryOffset = 0;
+    int coreOffset = 0;
+    // Locked clock ranges in MHz; a range of 0 to 0 means unlocked
+    int graphicsLockMin = 0;
+    int graphicsLockMax = 0;
+    int memoryLockMin = 0;
+    int memoryLockMax = 0;
+};
+
+enum ApplyField {
+    ApplyPowerLimit = 0x1,
+    ApplyMemoryOffset = 0x2,
+    ApplyCoreOffset = 0x4,
+    ApplyGraphicsLock = 0x8,
+    ApplyMemoryLock = 0x10,
+    ApplyClockLocks = ApplyGraphicsLock | ApplyMemoryLock,
+    ApplyAll = ApplyPowerLimit | ApplyMemoryOffset | ApplyCoreOffset | ApplyClockLocks
+};
+
+struct ApplyResult {
+    int failedFields = 0;
+    QStringList errors;     // One "Attribute: reason" line per failure
+
+    bool ok() const { return failedFields == 0; }
+};
+
+// Abstract access to one or more GPUs. Implementations must be safe to call
+// from a worker thread; the GUI never talks to the driver directly.
+class GpuBackend {
+public:
+    virtual ~GpuBackend() = default;
+
+    virtual QString name() const = 0;
+    virtual int deviceCount() = 0;
+
+    // Queries. Return -1 (or an empty string) when the value is unavailable.
+    virtual QString pciBusId(int gpu) = 0;
+    virtual QString driverVersion() = 0;
+    virtual QString gpuName(int gpu) = 0;
+    virtual int minPowerLimit(int gpu) = 0;
+    virtual int maxPowerLimit(int gpu) = 0;
+    virtual int defaultPowerLimit(int gpu) = 0;
+    virtual int powerLimit(int gpu) = 0;
+    virtual int memoryClock(int gpu) = 0;
+    virtual int graphicsClock(int gpu) = 0;
+
+    // Offsets use nvidia-settings units: memory offset is the transfer rate
+    // offset (twice the memory clock offset), core offset is in MHz.
+    virtual bool memoryOffset(int gpu, int *mhz) = 0;
+    virtual bool coreOffset(int gpu, int *mhz) = 0;
+    virtual bool memoryOffsetRange(int gpu, int *min, int *max) = 0;
+    virtual bool coreOffsetRange(int gpu, int *min, int *max) = 0;
+
+    // Memory and graphics clocks the GPU can be locked to, highest first.
+    // Returns false when the board does not support clock locking.
+    virtual bool supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) = 0;
+
+    // Batched reads. The defaults call the individual queries above;
+    // backends where each query is expensive override them.
+    virtual GpuSnapshot snapshot(int gpu);
+    virtual GpuStaticInfo staticInfo(int gpu);
+
+    // Fills everything but the timestamp for one telemetry reading. Returns
+    // false when the backend has no cheap in-process way to sample; the
+    // telemetry sampler then streams from nvidia-smi instead.
+    virtual bool sample(int, TelemetrySample *) { return false; }
+
+    // Writes. On failure, *error receives a short reason.
+    virtual bool setPowerLimit(int gpu, int watts, QString *error) = 0;
+    virtual bool setMemoryOffset(int gpu, int mhz, QString *error) = 0;
+    virtual bool setCoreOffset(int gpu, int mhz, QString *error) = 0;
+    // Pins the clock to min..max MHz; 0, 0 removes the lock. Removing a
+    // lock on a board that cannot lock clocks succeeds, as there is nothing
+    // to undo.
+    virtual bool setGraphicsClockLock(int gpu, int min, int max, QString *error) = 0;
+    virtual bool setMemoryClockLock(int gpu, int min, int max, QString *error) = 0;
+
+    // Writes the selected fields of settings. The default calls the setters
+    // one after another; backends with a per-call cost batch them instead.
+    virtual ApplyResult apply(int gpu, const GpuSettings &settings, int fields);
+
+    // Picks a backend from GPU_CONTROL_BACKEND (nvml, smi, amdgpu, mock).
+    // With no override, NVML is used when libnvidia-ml can be loaded, then
+    // sysfs when there are amdgpu cards, otherwise the
+    // nvidia-smi/nvidia-settings subprocess path.
+    static GpuBackend *create(const QString &kind = QString());
+};
@@ -0,0 +1,325 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+#include <functional>
+
+#include "config.h"
+#include "smi-backend.h"
+#include "startup-service.h"
+
+// End-to-end latency and fork-count benchmark. Runs the real code paths
+// against the stub nvidia-smi, nvidia-settings and sudo in bench/, which
+// log every invocation, so a change that adds a subprocess or slows a path
+// down shows up as a number in the JSON report.
+
+namespace {
+
+struct CaseResult {
+    QString name;
+    QVector<double> wallMs;
+    double forks = 0;       // Stub invocations per iteration
+    int failures = 0;
+};
+
+class Bench {
+public:
+    Bench(const QString &work, int iterations) : work(work), iterations(iterations) {}
+
+    int forkCount() const {
+        QFile log(work + "/forks.log");
+        if (!log.open(QIODevice::ReadOnly))
+            return 0;
+        return log.readAll().count('\n');
+    }
+
+    // Times body once per iteration; prepare runs untimed before each one
+    CaseResult run(const QString &name, std::function<bool()> body,
+                   std::function<void()> prepare = std::function<void()>()) {
+        CaseResult result;
+        result.name = name;
+        int forks = 0;
+        for (int i = 0; i < iterations; ++i) {
+            if (prepare)
+                prepare();
+            int before = forkCount();
+            QElapsedTimer timer;
+            timer.start();
+            if (!body())
+                ++result.failures;
+            result.wallMs.append(timer.nsecsElapsed() / 1e6);
+            forks += forkCount() - before;
+        }
+        result.forks = double(forks) / iterations;
+        qInfo("%-20s median %8.2f ms  %5.1f forks%s", qPrintable(name), median(result.wallMs),
+              result.forks, result.failures ? "  FAILED" : "");
+        return result;
+    }
+
+    static double median(QVector<double> values) {
+        if (values.isEmpty())
+            return 0;
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+
+private:
+    QString work;
+    int iterations;
+};
+
+bool runProcess(const QString &program, const QStringList &args, const QStringList &extraEnv = QStringList()) {
+    QProcess proc;
+    if (!extraEnv.isEmpty()) {
+        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+        for (const QString &entry : extraEnv)
+            env.insert(entry.section('=', 0, 0), entry.section('=', 1));
+        proc.setProcessEnvironment(env);
+    }
+    proc.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    proc.start(program, args);
+    if (!proc.waitForFinished(60000)) {
+        proc.kill();
+        proc.waitForFinished(1000);
+        return false;
+    }
+    return proc.exitStatus() == QProcess::NormalExit && proc.exitCode() == 0;
+}
+
+QJsonObject toJson(const CaseResult &result) {
+    QVector<double> sorted = result.wallMs;
+    std::sort(sorted.begin(), sorted.end());
+    QJsonObject object;
+    object["iterations"] = result.wallMs.size();
+    object["median_ms"] = Bench::median(result.wallMs);
+    object["min_ms"] = sorted.isEmpty() ? 0 : sorted.first();
+    object["max_ms"] = sorted.isEmpty() ? 0 : sorted.last();
+    object["forks"] = result.forks;
+    object["failures"] = result.failures;
+    return object;
+}
+
+// Fork counts may never grow; wall times may grow by tolerance percent, and
+// are only compared when checkTimes (same stub latency as the baseline).
+// Only the metrics present in the baseline are checked.
+QStringList compare(const QJsonObject &report, const QJsonObject &baseline, double tolerance, bool checkTimes) {
+    QStringList regressions;
+    QJsonObject current = report["cases"].toObject();
+    QJsonObject expected = baseline["cases"].toObject();
+    for (auto it = expected.constBegin(); it != expected.constEnd(); ++it) {
+        QJsonObject want = it.value().toObject();
+        QJsonObject got = current[it.key()].toObject();
+        if (got.isEmpty())
+            continue;
+        if (got["failures"].toInt() > 0)
+            regressions << QString("%1: %2 failed iterations").arg(it.key()).arg(got["failures"].toInt());
+        if (want.contains("forks") && got["forks"].toDouble() > want["forks"].toDouble() + 1e-9)
+            regressions << QString("%1: %2 forks, baseline %3")
+                .arg(it.key()).arg(got["forks"].toDouble()).arg(want["forks"].toDouble());
+        if (checkTimes && want.contains("median_ms")
+            && got["median_ms"].toDouble() > want["median_ms"].toDouble() * (1 + tolerance / 100))
+            regressions << QString("%1: %2 ms, baseline %3 ms")
+                .arg(it.key()).arg(got["median_ms"].toDouble(), 0, 'f', 2).arg(want["median_ms"].toDouble(), 0, 'f', 2);
+    }
+    return regressions;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("gpu-control-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Subprocess latency benchmark for GPU Control");
+    parser.addHelpOption();
+    QCommandLineOption stubsOption("stubs", "Stub nvidia-smi/nvidia-settings/sudo in <dir>.", "dir",
+                                   QCoreApplication::applicationDirPath() + "/bench");
+    QCommandLineOption latencyOption("latency", "Stub tools take <ms> to answer.", "ms", "20");
+    QCommandLineOption gpusOption("gpus", "Stub tools report <n> GPUs.", "n", "1");
+    QCommandLineOption iterationsOption("iterations", "Run each case <n> times.", "n", "10");
+    QCommandLineOption outputOption("output", "Write the JSON report to <file> instead of stdout.", "file");
+    QCommandLineOption baselineOption("baseline", "Fail on regressions against <file>.", "file");
+    QCommandLineOption toleranceOption("tolerance",
+        "Allowed wall-time growth in <percent> (default: the baseline's tolerance_percent, else 25).", "percent");
+    QCommandLineOption writeBaselineOption("write-baseline",
+        "Record this run's fork counts and median times as the baseline in <file>.", "file");
+    parser.addOption(stubsOption);
+    parser.addOption(latencyOption);
+    parser.addOption(gpusOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(outputOption);
+    parser.addOption(baselineOption);
+    parser.addOption(toleranceOption);
+    parser.addOption(writeBaselineOption);
+    parser.process(app);
+
+    QString stubs = QDir(parser.value(stubsOption)).absolutePath();
+    if (!QFile::exists(stubs + "/nvidia-smi")) {
+        qWarning("No stub tools in %s", qPrintable(stubs));
+        return 1;
+    }
+
+    // Everything the cases touch lives in a throwaway directory, and the
+    // stubs shadow the real tools for this process and its children.
+    QTemporaryDir work;
+    if (!work.isValid())
+        return 1;
+    QString home = work.path() + "/home";
+    QDir().mkpath(home);
+    qputenv("PATH", (stubs + ":" + qEnvironmentVariable("PATH")).toLocal8Bit());
+    qputenv("HOME", home.toLocal8Bit());
+    qputenv("GPU_CONTROL_BACKEND", "smi");
+    qputenv("GPU_CONTROL_HELPER_SOCKET", (work.path() + "/no-helper.sock").toLocal8Bit());
+    qputenv("GPU_CONTROL_STUB_LOG", (work.path() + "/forks.log").toLocal8Bit());
+    qputenv("GPU_CONTROL_STUB_STATE", (work.path() + "/state").toLocal8Bit());
+    qputenv("GPU_CONTROL_STUB_LATENCY_MS", parser.value(latencyOption).toLocal8Bit());
+    qputenv("GPU_CONTROL_STUB_GPUS", parser.value(gpusOption).toLocal8Bit());
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    Bench bench(work.path(), iterations);
+    QVector<CaseResult> results;
+
+    QString gui = QCoreApplication::applicationDirPath() + "/gpu-control";
+    bool haveGui = QFile::exists(gui);
+    if (!haveGui)
+        qWarning("%s not found; skipping end-to-end cases", qPrintable(gui));
+
+    // Window up and every startup query answered, with nothing cached
+    if (haveGui) {
+        results << bench.run("cold_startup", [&]() {
+            return runProcess(gui, QStringList(), QStringList() << "GPU_CONTROL_EXIT_WHEN_READY=1");
+        }, [&]() {
+            QDir(home + "/.cache").removeRecursively();
+            QDir(home + "/.config").removeRecursively();
+        });
+    }
+
+    SmiBackend backend;
+    results << bench.run("read_current_values", [&]() {
+        return backend.snapshot(0).powerLimit > 0;
+    });
+
+    // Alternate between two targets so every field is written every time.
+    // Clock locks stay out so results compare with earlier runs.
+    int flip = 0;
+    results << bench.run("apply_settings", [&]() {
+        GpuSettings settings;
+        settings.powerLimit = flip ? 300 : 350;
+        settings.memoryOffset = flip ? 1000 : 0;
+        settings.coreOffset = flip ? 100 : 0;
+        flip = !flip;
+        return backend.apply(0, settings, ApplyPowerLimit | ApplyMemoryOffset | ApplyCoreOffset).ok();
+    });
+
+    GpuConfig config;
+    config.startup = true;
+    for (int gpu = 0; gpu < parser.value(gpusOption).toInt(); ++gpu) {
+        config.gpus[gpu].powerLimit = 350;
+        config.gpus[gpu].memoryOffset = 1000;
+    }
+    results << bench.run("startup_service", [&]() {
+        return !config.toText().isEmpty() && !StartupService::unit(StartupService::execStart()).isEmpty();
+    });
+
+    // What the boot-time unit runs
+    if (haveGui) {
+        QString file = work.path() + "/boot.conf";
+        config.save(file);
+        results << bench.run("boot_apply", [&]() {
+            return runProcess(gui, QStringList() << "--apply" << "--config" << file << "--timeout" << "10");
+        });
+    }
+
+    QJsonObject cases;
+    for (const CaseResult &result : results)
+        cases[result.name] = toJson(result);
+    QJsonObject report;
+    report["latency_ms"] = parser.value(latencyOption).toInt();
+    report["gpus"] = parser.value(gpusOption).toInt();
+    report["cases"] = cases;
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile out(parser.value(outputOption));
+        if (!out.open(QIODevice::WriteOnly)) {
+            qWarning("Cannot write %s", qPrintable(out.fileName()));
+            return 1;
+        }
+        out.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    // Only a complete, clean run is worth comparing against later
+    if (parser.isSet(writeBaselineOption)) {
+        if (!haveGui) {
+            qWarning("Not recording a baseline without the end-to-end cases");
+            return 1;
+        }
+        QJsonObject recorded;
+        for (const CaseResult &result : results) {
+            if (result.failures) {
+                qWarning("%s failed %d times; not recording a baseline", qPrintable(result.name), result.failures);
+                return 1;
+            }
+            QJsonObject entry;
+            entry["forks"] = result.forks;
+            entry["median_ms"] = qRound(Bench::median(result.wallMs) * 100) / 100.0;
+            recorded[result.name] = entry;
+        }
+        QJsonObject baseline;
+        baseline["gpus"] = report["gpus"];
+        baseline["latency_ms"] = report["latency_ms"];
+        baseline["tolerance_percent"] = parser.isSet(toleranceOption) ? parser.value(toleranceOption).toDouble() : 50;
+        baseline["cases"] = recorded;
+        QFile out(parser.value(writeBaselineOption));
+        if (!out.open(QIODevice::WriteOnly)) {
+            qWarning("Cannot write %s", qPrintable(out.fileName()));
+            return 1;
+        }
+        out.write(QJsonDocument(baseline).toJson());
+        qInfo("Baseline written to %s", qPrintable(out.fileName()));
+        return 0;
+    }
+
+    if (!parser.isSet(baselineOption))
+        return 0;
+
+    QFile file(parser.value(baselineOption));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("Cannot read baseline %s", qPrintable(file.fileName()));
+        return 1;
+    }
+    QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object();
+    if (baseline["cases"].toObject().isEmpty()) {
+        qWarning("%s has no recorded cases; record them with --write-baseline "
+                 "(cmake --build . --target bench-baseline) and commit the file", qPrintable(file.fileName()));
+        return 1;
+    }
+    if (baseline["gpus"].toInt(1) != report["gpus"].toInt()) {
+        qWarning("Baseline was recorded with %d GPUs; not comparing", baseline["gpus"].toInt(1));
+        return 0;
+    }
+    // Wall times scale with the stub latency; forks do not
+    bool checkTimes = baseline["latency_ms"].toInt(report["latency_ms"].toInt()) == report["latency_ms"].toInt();
+    if (!checkTimes)
+        qWarning("Baseline times were recorded at %d ms stub latency; comparing forks only",
+                 baseline["latency_ms"].toInt());
+    double tolerance = parser.isSet(toleranceOption) ? parser.value(toleranceOption).toDouble()
+                                                     : baseline["tolerance_percent"].toDouble(25);
+    QStringList regressions = compare(report, baseline, tolerance, checkTimes);
+    for (const QString &regression : regressions)
+        qWarning("Regression: %s", qPrintable(regression));
+    return regressions.isEmpty() ? 0 : 1;
+}
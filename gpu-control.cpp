@@ -5,59 +5,110 @@
 #include <QLabel>
 #include <QSpinBox>
 #include <QPushButton>
+#include <QScrollArea>
 #include <QGroupBox>
 #include <QCheckBox>
+#include <QComboBox>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QProcess>
 #include <QFont>
 #include <QFrame>
+#include <QGridLayout>
 #include <QFile>
 #include <QTextStream>
 #include <QDir>
-
-class GpuControl : public QWidget {
-    Q_OBJECT
-
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QShortcut>
+#include <QTabWidget>
+#include <QVector>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "config.h"
+#include "diagnostics-panel.h"
+#include "governor.h"
+#include "gpu-backend.h"
+#include "headless-apply.h"
+#include "helper-backend.h"
+#include "live-applier.h"
+#include "mock-backend.h"
+#include "offset-tuner-dialog.h"
+#include "power-sweep-dialog.h"
+#include "remote-control.h"
+#include "replay-dialog.h"
+#include "sparkline.h"
+#include "startup-service.h"
+#include "static-cache.h"
+#include "telemetry.h"
+#include "telemetry-recorder.h"
+#include "tracer.h"
+#include "tracing-backend.h"
+
+// Started first thing in main() so startup milestones can be logged
+static QElapsedTimer startupTimer;
+
+// Controls, telemetry and last-known state for one GPU
+class GpuPanel : public QWidget {
 public:
-    GpuControl(QWidget *parent = nullptr) : QWidget(parent) {
-        setWindowTitle("GPU Control");
-        setMinimumSize(520, 780);
-
-        maxPowerLimit = queryMaxPowerLimit();
-        defaultPowerLimit = queryDefaultPowerLimit();
-
+    GpuPanel(int gpu, QWidget *parent = nullptr) : QWidget(parent), gpu(gpu) {
         QString spinStyle =
             "QSpinBox { min-height: 36px; min-width: 160px; font-size: 14px; padding: 4px 8px; }";
 
         auto *mainLayout = new QVBoxLayout(this);
         mainLayout->setSpacing(14);
-        mainLayout->setContentsMargins(20, 20, 20, 20);
-
-        // Title
-        auto *title = new QLabel("NVIDIA GPU Control");
-        QFont titleFont = title->font();
-        titleFont.setPointSize(18);
-        titleFont.setBold(true);
-        title->setFont(titleFont);
-        title->setAlignment(Qt::AlignCenter);
-        mainLayout->addWidget(title);
+        mainLayout->setContentsMargins(0, 8, 0, 0);
 
         // GPU name
-        gpuNameLabel = new QLabel(queryGpuName());
+        gpuNameLabel = new QLabel(QString("Detecting GPU %1...").arg(gpu));
         gpuNameLabel->setAlignment(Qt::AlignCenter);
         gpuNameLabel->setStyleSheet("color: #76b900; padding: 2px; font-size: 12px;");
         mainLayout->addWidget(gpuNameLabel);
 
-        // Status
-        statusLabel = new QLabel("Reading current values...");
-        statusLabel->setAlignment(Qt::AlignCenter);
-        statusLabel->setStyleSheet("color: #888; padding: 6px; font-size: 13px;");
-        mainLayout->addWidget(statusLabel);
-
-        // Separator
-        auto *sep1 = new QFrame();
-        sep1->setFrameShape(QFrame::HLine);
-        mainLayout->addWidget(sep1);
+        // Current values read back from the GPU
+        currentLabel = new QLabel("Reading current values...");
+        currentLabel->setAlignment(Qt::AlignCenter);
+        currentLabel->setStyleSheet("color: #888; padding: 2px; font-size: 12px;");
+        mainLayout->addWidget(currentLabel);
+
+        // Live telemetry
+        auto *telemetryGroup = new QGroupBox("Live Telemetry");
+        telemetryGroup->setStyleSheet("QGroupBox { font-size: 14px; font-weight: bold; }");
+        auto *telemetryGrid = new QGridLayout(telemetryGroup);
+        telemetryGrid->setContentsMargins(12, 16, 12, 12);
+        telemetryGrid->setHorizontalSpacing(10);
+        telemetryGrid->setVerticalSpacing(4);
+        telemetryGrid->setColumnStretch(2, 1);
+        auto addTelemetryRow = [telemetryGrid](int row, const QString &name, QLabel **value,
+                                               Sparkline **graph, const QColor &color) {
+            auto *label = new QLabel(name);
+            label->setStyleSheet("font-size: 12px; color: #aaa;");
+            *value = new QLabel("-");
+            (*value)->setStyleSheet("font-size: 12px; font-weight: bold;");
+            (*value)->setMinimumWidth(80);
+            *graph = new Sparkline(color);
+            telemetryGrid->addWidget(label, row, 0);
+            telemetryGrid->addWidget(*value, row, 1);
+            telemetryGrid->addWidget(*graph, row, 2);
+        };
+        addTelemetryRow(0, "Power", &powerDrawLabel, &powerGraph, QColor("#76b900"));
+        addTelemetryRow(1, "Core", &coreClockLabel, &coreClockGraph, QColor("#3498db"));
+        addTelemetryRow(2, "Memory", &memClockLabel, &memClockGraph, QColor("#9b59b6"));
+        addTelemetryRow(3, "Temp", &temperatureLabel, &temperatureGraph, QColor("#e67e22"));
+        addTelemetryRow(4, "Load", &utilizationLabel, &utilizationGraph, QColor("#1abc9c"));
+        utilizationGraph->setRange(0, 100);
+        auto *throttleName = new QLabel("Throttle");
+        throttleName->setStyleSheet("font-size: 12px; color: #aaa;");
+        throttleLabel = new QLabel("-");
+        throttleLabel->setStyleSheet("font-size: 12px;");
+        telemetryGrid->addWidget(throttleName, 5, 0);
+        telemetryGrid->addWidget(throttleLabel, 5, 1, 1, 2);
+        mainLayout->addWidget(telemetryGroup);
 
         // Power Limit
         auto *powerGroup = new QGroupBox("Power Limit");
@@ -84,7 +135,29 @@ public:
         powerRatioLabel->setStyleSheet("font-size: 12px; color: #aaa;");
         powerRatioHBox->addWidget(powerRatioLabel);
         powerRatioHBox->addStretch();
+        sweepBtn = new QPushButton("Sweep...");
+        sweepBtn->setToolTip("Find the power limit with the best throughput per watt");
+        powerRatioHBox->addWidget(sweepBtn);
         powerVBox->addLayout(powerRatioHBox);
+
+        // Closed-loop power limit; overrides the spinbox while enabled
+        auto *governorHBox = new QHBoxLayout();
+        governorCheck = new QCheckBox("Governor");
+        governorCheck->setToolTip("Keep adjusting the power limit to hold a target");
+        governorMode = new QComboBox();
+        governorMode->addItem("Max temperature", GovernorOptions::HoldTemperature);
+        governorMode->addItem("No thermal throttle", GovernorOptions::AvoidThermalThrottle);
+        governorMode->addItem("Core clock", GovernorOptions::HoldClock);
+        governorTarget = new QSpinBox();
+        governorStatus = new QLabel();
+        governorStatus->setStyleSheet("font-size: 12px; color: #aaa;");
+        governorHBox->addWidget(governorCheck);
+        governorHBox->addWidget(governorMode);
+        governorHBox->addWidget(governorTarget);
+        governorHBox->addWidget(governorStatus);
+        governorHBox->addStretch();
+        powerVBox->addLayout(governorHBox);
+        updateGovernorTarget();
         mainLayout->addWidget(powerGroup);
 
         // Memory Offset
@@ -133,8 +206,40 @@ public:
         coreLayout->addWidget(coreLabel);
         coreLayout->addStretch();
         coreLayout->addWidget(coreSpin);
+        tuneBtn = new QPushButton("Tune...");
+        tuneBtn->setToolTip("Search for the highest stable core and memory offsets");
+        coreLayout->addWidget(tuneBtn);
         mainLayout->addWidget(coreGroup);
 
+        // Locked clocks, picked from the driver's table of supported clocks
+        auto *lockGroup = new QGroupBox("Locked Clocks");
+        lockGroup->setStyleSheet("QGroupBox { font-size: 14px; font-weight: bold; }");
+        auto *lockGrid = new QGridLayout(lockGroup);
+        lockGrid->setContentsMargins(12, 16, 12, 12);
+        lockGrid->setHorizontalSpacing(10);
+        lockGrid->setColumnStretch(1, 1);
+        lockGrid->setColumnStretch(3, 1);
+        auto addLockRow = [lockGrid](int row, const QString &name, QCheckBox **check,
+                                     QComboBox **min, QComboBox **max) {
+            *check = new QCheckBox(name);
+            (*check)->setStyleSheet("font-size: 13px;");
+            *min = new QComboBox();
+            *max = new QComboBox();
+            auto *to = new QLabel("to");
+            to->setStyleSheet("font-size: 12px; color: #aaa;");
+            lockGrid->addWidget(*check, row, 0);
+            lockGrid->addWidget(*min, row, 1);
+            lockGrid->addWidget(to, row, 2);
+            lockGrid->addWidget(*max, row, 3);
+        };
+        addLockRow(0, "Graphics", &graphicsLockCheck, &graphicsLockMin, &graphicsLockMax);
+        addLockRow(1, "Memory", &memoryLockCheck, &memoryLockMin, &memoryLockMax);
+        lockStatus = new QLabel("Reading supported clocks...");
+        lockStatus->setStyleSheet("font-size: 12px; color: #aaa;");
+        lockGrid->addWidget(lockStatus, 2, 0, 1, 4);
+        updateLockControls();
+        mainLayout->addWidget(lockGroup);
+
         // Presets
         auto *presetGroup = new QGroupBox("Presets");
         presetGroup->setStyleSheet("QGroupBox { font-size: 14px; font-weight: bold; }");
@@ -146,24 +251,546 @@ public:
             "QPushButton { min-height: 50px; font-size: 12px; border-radius: 6px; }"
             "QPushButton:hover { background-color: #444; }";
 
-        auto *defaultBtn = new QPushButton(QString("Default\n%1W / +0").arg(defaultPowerLimit));
-        auto *lowBtn = new QPushButton(QString("Low Power\n%1W / +0").arg((int)(defaultPowerLimit * 0.75)));
-        auto *fullBtn = new QPushButton(QString("Full Power\n%1W / +0").arg(maxPowerLimit));
+        defaultBtn = new QPushButton();
+        lowBtn = new QPushButton();
+        fullBtn = new QPushButton();
+        // Filled in by a power sweep
+        efficientBtn = new QPushButton();
+        efficientBtn->setVisible(false);
+        updatePresetLabels();
         defaultBtn->setStyleSheet(presetBtnStyle);
         lowBtn->setStyleSheet(presetBtnStyle);
         fullBtn->setStyleSheet(presetBtnStyle);
+        efficientBtn->setStyleSheet(presetBtnStyle);
         presetLayout->addWidget(defaultBtn);
         presetLayout->addWidget(lowBtn);
+        presetLayout->addWidget(efficientBtn);
         presetLayout->addWidget(fullBtn);
         mainLayout->addWidget(presetGroup);
+        mainLayout->addStretch();
+
+        // Connections
+        connect(memSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &GpuPanel::updateEquiv);
+        connect(powerSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &GpuPanel::updatePowerRatio);
+        connect(defaultBtn, &QPushButton::clicked, [this]() { setPreset(defaultPowerLimit, 0, 0); });
+        connect(lowBtn, &QPushButton::clicked, [this]() { setPreset((int)(defaultPowerLimit * 0.75), 0, 0); });
+        connect(fullBtn, &QPushButton::clicked, [this]() { setPreset(maxPowerLimit, 0, 0); });
+        connect(efficientBtn, &QPushButton::clicked, [this]() { setPreset(efficientPowerLimit, 0, 0); });
+        connect(governorCheck, &QCheckBox::toggled, this, &GpuPanel::resetGovernor);
+        connect(governorMode, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this]() {
+            updateGovernorTarget();
+            resetGovernor();
+        });
+        connect(governorTarget, QOverload<int>::of(&QSpinBox::valueChanged), this, &GpuPanel::resetGovernor);
+        connect(graphicsLockCheck, &QCheckBox::toggled, this, &GpuPanel::updateLockControls);
+        connect(memoryLockCheck, &QCheckBox::toggled, this, &GpuPanel::updateLockControls);
+
+        // Edits made here, as opposed to values loaded into the controls
+        auto edited = [this](int fields) {
+            if (onEdited && !loading)
+                onEdited(fields);
+        };
+        connect(powerSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [edited]() { edited(ApplyPowerLimit); });
+        connect(memSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [edited]() { edited(ApplyMemoryOffset); });
+        connect(coreSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [edited]() { edited(ApplyCoreOffset); });
+        for (QComboBox *combo : {graphicsLockMin, graphicsLockMax})
+            connect(combo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [edited]() { edited(ApplyGraphicsLock); });
+        for (QComboBox *combo : {memoryLockMin, memoryLockMax})
+            connect(combo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [edited]() { edited(ApplyMemoryLock); });
+        connect(graphicsLockCheck, &QCheckBox::toggled, this, [edited]() { edited(ApplyGraphicsLock); });
+        connect(memoryLockCheck, &QCheckBox::toggled, this, [edited]() { edited(ApplyMemoryLock); });
+    }
+
+    int index() const { return gpu; }
+    QString name() const { return gpuName; }
+    QPushButton *sweepButton() const { return sweepBtn; }
+    QPushButton *tuneButton() const { return tuneBtn; }
+    QCheckBox *governorCheckBox() const { return governorCheck; }
+    bool governing() const { return !governor.isNull(); }
+    QString pciBusId() const { return busId; }
+    int maximumCoreOffset() const { return coreSpin->maximum(); }
+    int maximumMemoryOffset() const { return memSpin->maximum(); }
+    int minimumPower() const { return powerSpin->minimum(); }
+    int maximumPower() const { return maxPowerLimit; }
+
+    // Called with the ApplyField bits of every control the user changes
+    void setEditedHandler(const std::function<void(int)> &handler) { onEdited = handler; }
+
+    void setEfficientLimit(int watts) {
+        efficientPowerLimit = watts;
+        efficientBtn->setVisible(watts > 0);
+        updatePresetLabels();
+    }
+
+    GpuSettings settings() const {
+        GpuSettings target;
+        target.powerLimit = powerSpin->value();
+        target.memoryOffset = memSpin->value();
+        target.coreOffset = coreSpin->value();
+        // Until the clock tables arrive the lock controls are empty
+        if (!clockTablesLoaded) {
+            target.graphicsLockMin = wantedLocks.graphicsLockMin;
+            target.graphicsLockMax = wantedLocks.graphicsLockMax;
+            target.memoryLockMin = wantedLocks.memoryLockMin;
+            target.memoryLockMax = wantedLocks.memoryLockMax;
+            return target;
+        }
+        if (graphicsLockCheck->isChecked() && graphicsLockMin->count()) {
+            int a = graphicsLockMin->currentData().toInt();
+            int b = graphicsLockMax->currentData().toInt();
+            target.graphicsLockMin = qMin(a, b);
+            target.graphicsLockMax = qMax(a, b);
+        }
+        if (memoryLockCheck->isChecked() && memoryLockMin->count()) {
+            int a = memoryLockMin->currentData().toInt();
+            int b = memoryLockMax->currentData().toInt();
+            target.memoryLockMin = qMin(a, b);
+            target.memoryLockMax = qMax(a, b);
+        }
+        return target;
+    }
+
+    void setSettings(const GpuSettings &settings) {
+        Loading guard(&loading);
+        if (settings.powerLimit > 0)
+            setWantedPower(settings.powerLimit);
+        memSpin->setValue(settings.memoryOffset);
+        coreSpin->setValue(settings.coreOffset);
+        setWantedLocks(settings);
+        updateEquiv();
+        updatePowerRatio();
+    }
+
+    void setPreset(int power, int mem, int core) {
+        powerSpin->setValue(power);
+        memSpin->setValue(mem);
+        coreSpin->setValue(core);
+    }
+
+    void resetToDefaults() {
+        setPreset(defaultPowerLimit, 0, 0);
+        graphicsLockCheck->setChecked(false);
+        memoryLockCheck->setChecked(false);
+    }
+
+    // Fields of target that differ from the state last read back or applied
+    int changedFields(const GpuSettings &target) const {
+        int fields = 0;
+        if (!(knownFields & ApplyPowerLimit) || applied.powerLimit != target.powerLimit)
+            fields |= ApplyPowerLimit;
+        if (!(knownFields & ApplyMemoryOffset) || applied.memoryOffset != target.memoryOffset)
+            fields |= ApplyMemoryOffset;
+        if (!(knownFields & ApplyCoreOffset) || applied.coreOffset != target.coreOffset)
+            fields |= ApplyCoreOffset;
+        if (!(knownFields & ApplyGraphicsLock) || applied.graphicsLockMin != target.graphicsLockMin
+            || applied.graphicsLockMax != target.graphicsLockMax)
+            fields |= ApplyGraphicsLock;
+        if (!(knownFields & ApplyMemoryLock) || applied.memoryLockMin != target.memoryLockMin
+            || applied.memoryLockMax != target.memoryLockMax)
+            fields |= ApplyMemoryLock;
+        return fields;
+    }
+
+    void setOffsets(int core, int memory) {
+        coreSpin->setValue(core);
+        memSpin->setValue(memory);
+    }
+
+    // Something outside the panel wrote offsets; rewrite them on next apply
+    void forgetAppliedOffsets() {
+        knownFields &= ~(ApplyMemoryOffset | ApplyCoreOffset);
+    }
+
+    void markApplied(const GpuSettings &target, int fields, const ApplyResult &result) {
+        int written = fields & ~result.failedFields;
+        if (written & ApplyPowerLimit)
+            applied.powerLimit = target.powerLimit;
+        if (written & ApplyMemoryOffset)
+            applied.memoryOffset = target.memoryOffset;
+        if (written & ApplyCoreOffset)
+            applied.coreOffset = target.coreOffset;
+        if (written & ApplyGraphicsLock) {
+            applied.graphicsLockMin = target.graphicsLockMin;
+            applied.graphicsLockMax = target.graphicsLockMax;
+        }
+        if (written & ApplyMemoryLock) {
+            applied.memoryLockMin = target.memoryLockMin;
+            applied.memoryLockMax = target.memoryLockMax;
+        }
+        knownFields = (knownFields | written) & ~result.failedFields;
+    }
+
+    void showStaticInfo(const GpuStaticInfo &info) {
+        Loading guard(&loading);
+        gpuName = info.name.isEmpty() ? "NVIDIA GPU" : info.name;
+        gpuNameLabel->setText(QString("GPU %1: %2").arg(gpu).arg(gpuName));
+
+        maxPowerLimit = info.maxPowerLimit > 0 ? info.maxPowerLimit : 450;
+        defaultPowerLimit = info.defaultPowerLimit > 0 ? info.defaultPowerLimit : 450;
+        powerSpin->setRange(info.minPowerLimit > 0 ? info.minPowerLimit : 100, maxPowerLimit);
+        if (wantedPower > 0)
+            powerSpin->setValue(wantedPower);
+        memSpin->setRange(info.memOffsetMin, info.memOffsetMax);
+        coreSpin->setRange(info.coreOffsetMin, info.coreOffsetMax);
+
+        fillClocks(graphicsLockMin, info.graphicsClocks);
+        fillClocks(graphicsLockMax, info.graphicsClocks);
+        fillClocks(memoryLockMin, info.memoryClocks);
+        fillClocks(memoryLockMax, info.memoryClocks);
+        clockTablesLoaded = true;
+        // Locks cannot be read back, but a board without them is never locked
+        if (info.graphicsClocks.isEmpty())
+            knownFields |= ApplyGraphicsLock;
+        if (info.memoryClocks.isEmpty())
+            knownFields |= ApplyMemoryLock;
+        setWantedLocks(wantedLocks);
+
+        updatePresetLabels();
+        updateEquiv();
+        updatePowerRatio();
+    }
+
+    // useForControls: no saved settings for this GPU, so show what it runs at
+    void showCurrentValues(const GpuSnapshot &snap, bool useForControls) {
+        busId = snap.pciBusId;
+        if (snap.powerLimit > 0) {
+            applied.powerLimit = snap.powerLimit;
+            knownFields |= ApplyPowerLimit;
+        }
+        if (snap.memOffsetOk) {
+            applied.memoryOffset = snap.memoryOffset;
+            knownFields |= ApplyMemoryOffset;
+        }
+        if (snap.coreOffsetOk) {
+            applied.coreOffset = snap.coreOffset;
+            knownFields |= ApplyCoreOffset;
+        }
+
+        if (useForControls) {
+            Loading guard(&loading);
+            if (snap.memOffsetOk)
+                memSpin->setValue(snap.memoryOffset);
+            if (snap.coreOffsetOk)
+                coreSpin->setValue(snap.coreOffset);
+            if (snap.powerLimit > 0)
+                setWantedPower(snap.powerLimit);
+
+            updateEquiv();
+            updatePowerRatio();
+        }
+
+        if (snap.powerLimit > 0) {
+            QString status = QString("Current: %1W | Mem +%2 | Core +%3")
+                .arg(snap.powerLimit)
+                .arg(snap.memOffsetOk ? snap.memoryOffset : 0)
+                .arg(snap.coreOffsetOk ? snap.coreOffset : 0);
+            currentLabel->setText(status);
+        }
+    }
+
+    void addSample(const TelemetrySample &sample) {
+        powerGraph->addValue(sample.powerDraw);
+        coreClockGraph->addValue(sample.graphicsClock);
+        memClockGraph->addValue(sample.memoryClock);
+        temperatureGraph->addValue(sample.temperature);
+        utilizationGraph->addValue(sample.gpuUtilization);
+        latestSample = sample;
+        hasNewSample = true;
+    }
+
+    // Power limit the governor wants written for this sample, or -1
+    int governorUpdate(const TelemetrySample &sample) {
+        return governor ? governor->update(sample) : -1;
+    }
+
+    void governorWrote(int limit, const ApplyResult &result) {
+        GpuSettings target;
+        target.powerLimit = limit;
+        markApplied(target, ApplyPowerLimit, result);
+        if (governor)
+            governorStatus->setText(result.ok() ? QString("%1 W").arg(limit) : result.errors.join("; "));
+    }
+
+    // Labels only need the newest sample, once per drain
+    void refreshTelemetryLabels() {
+        if (!hasNewSample)
+            return;
+        hasNewSample = false;
+
+        auto show = [](QLabel *label, double value, const char *unit) {
+            label->setText(value < 0 ? QString("-") : QString("%1 %2").arg(value, 0, 'f', 0).arg(unit));
+        };
+        show(powerDrawLabel, latestSample.powerDraw, "W");
+        show(coreClockLabel, latestSample.graphicsClock, "MHz");
+        show(memClockLabel, latestSample.memoryClock, "MHz");
+        show(temperatureLabel, latestSample.temperature, "°C");
+        show(utilizationLabel, latestSample.gpuUtilization, "%");
+        throttleLabel->setText(throttleReasonText(latestSample.throttleReasons));
+    }
+
+    bool staticInfoLoaded = false;
+
+private:
+    // Marks controls as being filled in rather than edited
+    struct Loading {
+        explicit Loading(bool *flag) : flag(flag), was(*flag) { *flag = true; }
+        ~Loading() { *flag = was; }
+        bool *flag;
+        bool was;
+    };
+
+    void updateEquiv() {
+        int afterburner = memSpin->value() / 2;
+        if (afterburner >= 0)
+            memEquiv->setText(QString("+%1").arg(afterburner));
+        else
+            memEquiv->setText(QString::number(afterburner));
+    }
+
+    void updatePowerRatio() {
+        int current = powerSpin->value();
+        if (current == 0) {
+            powerRatioLabel->setText(QString("0 / %1 W").arg(maxPowerLimit));
+        } else {
+            int pct = (current * 100) / maxPowerLimit;
+            powerRatioLabel->setText(QString("%1 / %2 W  (%3%)").arg(current).arg(maxPowerLimit).arg(pct));
+        }
+    }
+
+    void updatePresetLabels() {
+        defaultBtn->setText(QString("Default\n%1W / +0").arg(defaultPowerLimit));
+        lowBtn->setText(QString("Low Power\n%1W / +0").arg((int)(defaultPowerLimit * 0.75)));
+        fullBtn->setText(QString("Full Power\n%1W / +0").arg(maxPowerLimit));
+        efficientBtn->setText(QString("Efficient\n%1W / +0").arg(efficientPowerLimit));
+    }
+
+    void updateGovernorTarget() {
+        QSignalBlocker block(governorTarget);
+        if (governorMode->currentData().toInt() == GovernorOptions::HoldClock) {
+            governorTarget->setRange(300, 3500);
+            governorTarget->setSingleStep(15);
+            governorTarget->setSuffix(" MHz");
+            governorTarget->setValue(1800);
+        } else {
+            governorTarget->setRange(40, 100);
+            governorTarget->setSingleStep(1);
+            governorTarget->setSuffix(" °C");
+            governorTarget->setValue(78);
+        }
+        governorTarget->setEnabled(governorMode->currentData().toInt() != GovernorOptions::AvoidThermalThrottle);
+    }
+
+    static void fillClocks(QComboBox *combo, const QVector<int> &clocks) {
+        QSignalBlocker block(combo);
+        combo->clear();
+        for (int mhz : clocks)
+            combo->addItem(QString("%1 MHz").arg(mhz), mhz);
+    }
+
+    // Selects mhz, adding it in order when the table lacks it, so a saved
+    // value from another driver version is kept rather than silently moved
+    static void selectClock(QComboBox *combo, int mhz) {
+        int index = combo->findData(mhz);
+        if (index < 0) {
+            index = 0;
+            while (index < combo->count() && combo->itemData(index).toInt() > mhz)
+                ++index;
+            combo->insertItem(index, QString("%1 MHz").arg(mhz), mhz);
+        }
+        combo->setCurrentIndex(index);
+    }
+
+    // Saved locks arrive before the clock tables do; keep them until then
+    void setWantedLocks(const GpuSettings &settings) {
+        wantedLocks = settings;
+        if (!clockTablesLoaded)
+            return;
+        if (settings.graphicsLockMax > 0 && graphicsLockMin->count()) {
+            selectClock(graphicsLockMin, settings.graphicsLockMin);
+            selectClock(graphicsLockMax, settings.graphicsLockMax);
+        }
+        if (settings.memoryLockMax > 0 && memoryLockMin->count()) {
+            selectClock(memoryLockMin, settings.memoryLockMin);
+            selectClock(memoryLockMax, settings.memoryLockMax);
+        }
+        graphicsLockCheck->setChecked(settings.graphicsLockMax > 0 && graphicsLockMin->count());
+        memoryLockCheck->setChecked(settings.memoryLockMax > 0 && memoryLockMin->count());
+        updateLockControls();
+    }
+
+    void updateLockControls() {
+        bool graphics = graphicsLockMin->count() > 0;
+        bool memory = memoryLockMin->count() > 0;
+        graphicsLockCheck->setEnabled(graphics);
+        memoryLockCheck->setEnabled(memory);
+        graphicsLockMin->setEnabled(graphics && graphicsLockCheck->isChecked());
+        graphicsLockMax->setEnabled(graphics && graphicsLockCheck->isChecked());
+        memoryLockMin->setEnabled(memory && memoryLockCheck->isChecked());
+        memoryLockMax->setEnabled(memory && memoryLockCheck->isChecked());
+        if (!clockTablesLoaded)
+            lockStatus->setText("Reading supported clocks...");
+        else if (!graphics && !memory)
+            lockStatus->setText("This GPU does not support locked clocks");
+        else if (!memory)
+            lockStatus->setText("Memory clock locking is not supported on this GPU");
+        else
+            lockStatus->setText("Pins clocks to a range for steady latency; unchecked leaves them free");
+    }
+
+    // Restarts the controller from whatever limit is in force, so changing
+    // the target mid-run does not jump back to the spinbox value
+    void resetGovernor() {
+        if (!governorCheck->isChecked()) {
+            governor.reset();
+            governorStatus->clear();
+            return;
+        }
+        GovernorOptions options;
+        options.mode = GovernorOptions::Mode(governorMode->currentData().toInt());
+        options.target = governorTarget->value();
+        options.minPower = powerSpin->minimum();
+        options.maxPower = maxPowerLimit;
+        int limit = governor ? governor->limit()
+            : knownFields & ApplyPowerLimit ? applied.powerLimit : powerSpin->value();
+        governor.reset(new PowerGovernor(options, limit));
+        governorStatus->setText(QString("%1 W").arg(governor->limit()));
+    }
+
+    // The spinbox range is only known once the limits query returns, so
+    // remember the requested value and re-apply it then.
+    void setWantedPower(int power) {
+        wantedPower = power;
+        powerSpin->setValue(power);
+    }
+
+    int gpu;
+    QString gpuName;
+    QString busId;
+    QSpinBox *powerSpin;
+    QSpinBox *memSpin;
+    QSpinBox *coreSpin;
+    QLabel *memEquiv;
+    QLabel *gpuNameLabel;
+    QLabel *currentLabel;
+    QLabel *powerRatioLabel;
+    QPushButton *defaultBtn;
+    QPushButton *lowBtn;
+    QPushButton *fullBtn;
+    QPushButton *efficientBtn;
+    QPushButton *sweepBtn;
+    QPushButton *tuneBtn;
+    QCheckBox *governorCheck;
+    QComboBox *governorMode;
+    QSpinBox *governorTarget;
+    QLabel *governorStatus;
+    QScopedPointer<PowerGovernor> governor;
+    QCheckBox *graphicsLockCheck;
+    QComboBox *graphicsLockMin;
+    QComboBox *graphicsLockMax;
+    QCheckBox *memoryLockCheck;
+    QComboBox *memoryLockMin;
+    QComboBox *memoryLockMax;
+    QLabel *lockStatus;
+    bool clockTablesLoaded = false;
+    GpuSettings wantedLocks;
+    QLabel *powerDrawLabel;
+    QLabel *coreClockLabel;
+    QLabel *memClockLabel;
+    QLabel *temperatureLabel;
+    QLabel *utilizationLabel;
+    QLabel *throttleLabel;
+    Sparkline *powerGraph;
+    Sparkline *coreClockGraph;
+    Sparkline *memClockGraph;
+    Sparkline *temperatureGraph;
+    Sparkline *utilizationGraph;
+    TelemetrySample latestSample;
+    bool hasNewSample = false;
+    // Placeholders until the real limits arrive from the backend
+    int maxPowerLimit = 450;
+    int defaultPowerLimit = 450;
+    int wantedPower = 0;
+    int efficientPowerLimit = 0;
+    GpuSettings applied;        // Last state read back or written
+    int knownFields = 0;        // ApplyField mask of trustworthy values in applied
+    std::function<void(int)> onEdited;
+    bool loading = false;
+};
+
+class GpuControl : public QWidget {
+    Q_OBJECT
+
+public:
+    GpuControl(QWidget *parent = nullptr) : QWidget(parent) {
+        setWindowTitle("GPU Control");
+        setMinimumSize(520, 780);
+
+        GpuBackend *created = GpuBackend::create();
+        simulator = dynamic_cast<MockBackend *>(created);
+        backend.reset(HelperBackend::wrapIfAvailable(new TracingBackend(created)));
+        qInfo("GPU backend: %s", qPrintable(backend->name()));
+
+        auto *mainLayout = new QVBoxLayout(this);
+        mainLayout->setSpacing(14);
+        mainLayout->setContentsMargins(20, 20, 20, 20);
+
+        // Title
+        auto *title = new QLabel("NVIDIA GPU Control");
+        QFont titleFont = title->font();
+        titleFont.setPointSize(18);
+        titleFont.setBold(true);
+        title->setFont(titleFont);
+        title->setAlignment(Qt::AlignCenter);
+        mainLayout->addWidget(title);
+
+        // Status
+        statusLabel = new QLabel("Reading current values...");
+        statusLabel->setAlignment(Qt::AlignCenter);
+        statusLabel->setStyleSheet("color: #888; padding: 6px; font-size: 13px;");
+        mainLayout->addWidget(statusLabel);
+
+        // Separator
+        auto *sep1 = new QFrame();
+        sep1->setFrameShape(QFrame::HLine);
+        mainLayout->addWidget(sep1);
+
+        // One tab per GPU; the tab bar only shows up with more than one
+        tabs = new QTabWidget();
+        tabs->setTabBarAutoHide(true);
+        mainLayout->addWidget(tabs, 1);
+
+        // Settings file that Apply saves to: the main one, or a named profile
+        // for `--apply --profile NAME` and the rule.NAME= workload rules
+        auto *profileHBox = new QHBoxLayout();
+        auto *profileLabel = new QLabel("Profile:");
+        profileLabel->setStyleSheet("font-size: 13px; padding: 4px;");
+        profileHBox->addWidget(profileLabel);
+        profileCombo = new QComboBox();
+        profileCombo->setToolTip("Apply writes the GPUs and saves to this profile");
+        profileHBox->addWidget(profileCombo, 1);
+        auto *saveProfileBtn = new QPushButton("Save as...");
+        saveProfileBtn->setToolTip("Save the current values as a new profile");
+        profileHBox->addWidget(saveProfileBtn);
+        mainLayout->addLayout(profileHBox);
 
         // Startup checkbox
+        auto *optionsHBox = new QHBoxLayout();
         startupCheck = new QCheckBox("Apply on startup");
         startupCheck->setStyleSheet("font-size: 13px; padding: 4px;");
-        mainLayout->addWidget(startupCheck);
+        optionsHBox->addWidget(startupCheck);
+        liveCheck = new QCheckBox("Live apply");
+        liveCheck->setStyleSheet("font-size: 13px; padding: 4px;");
+        liveCheck->setToolTip("Write changes a moment after you stop adjusting; Apply still saves them");
+        optionsHBox->addWidget(liveCheck);
+        optionsHBox->addStretch();
+        auto *historyBtn = new QPushButton("History...");
+        historyBtn->setToolTip("Replay recorded telemetry (Ctrl+H)");
+        historyBtn->setShortcut(QKeySequence("Ctrl+H"));
+        optionsHBox->addWidget(historyBtn);
+        mainLayout->addLayout(optionsHBox);
 
         // Apply button
-        auto *applyBtn = new QPushButton("Apply");
+        applyBtn = new QPushButton("Apply");
         applyBtn->setFixedHeight(48);
         applyBtn->setStyleSheet(
             "QPushButton { background-color: #4CAF50; color: white; font-size: 16px; font-weight: bold; border-radius: 8px; }"
@@ -183,52 +810,75 @@ public:
         mainLayout->addWidget(resetBtn);
 
         // Connections
-        connect(memSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &GpuControl::updateEquiv);
-        connect(powerSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &GpuControl::updatePowerRatio);
-        connect(defaultBtn, &QPushButton::clicked, [this]() { setPreset(defaultPowerLimit, 0, 0); });
-        connect(lowBtn, &QPushButton::clicked, [this]() { setPreset((int)(defaultPowerLimit * 0.75), 0, 0); });
-        connect(fullBtn, &QPushButton::clicked, [this]() { setPreset(maxPowerLimit, 0, 0); });
-        connect(applyBtn, &QPushButton::clicked, this, &GpuControl::applySettings);
+        connect(applyBtn, &QPushButton::clicked, this, [this]() { applySettings(); });
         connect(resetBtn, &QPushButton::clicked, this, &GpuControl::resetDefaults);
-
+        connect(historyBtn, &QPushButton::clicked, this, &GpuControl::openHistory);
+        connect(liveCheck, &QCheckBox::toggled, this, &GpuControl::setLiveApply);
+        connect(profileCombo, QOverload<int>::of(&QComboBox::activated), this, &GpuControl::selectProfile);
+        connect(saveProfileBtn, &QPushButton::clicked, this, &GpuControl::saveProfileAs);
+
+        // Hidden per-operation latency stats
+        auto *diagnostics = new DiagnosticsPanel(this);
+        auto *diagnosticsShortcut = new QShortcut(QKeySequence("Ctrl+Shift+D"), this);
+        connect(diagnosticsShortcut, &QShortcut::activated, [diagnostics]() {
+            diagnostics->setVisible(!diagnostics->isVisible());
+        });
+
+        // Everything below runs in the background; widgets fill in as
+        // results arrive so the window can paint immediately. GPU 0 is
+        // queried straight away while the remaining devices are enumerated.
         loadConfig();
+        fillProfiles();
+        pendingQueries = 2;
+        addPanel(0);
+        enumerateDevices();
         ensureSudoAccess();
-        readCurrentValues();
     }
 
-private slots:
-    void updateEquiv() {
-        int afterburner = memSpin->value() / 2;
-        if (afterburner >= 0)
-            memEquiv->setText(QString("+%1").arg(afterburner));
-        else
-            memEquiv->setText(QString::number(afterburner));
+    ~GpuControl() override {
+        if (sampler)
+            sampler->stop();
+        // Outstanding queries still hold a pointer to the backend
+        QThreadPool::globalInstance()->waitForDone();
     }
 
-    void updatePowerRatio() {
-        int current = powerSpin->value();
-        if (current == 0) {
-            powerRatioLabel->setText(QString("0 / %1 W").arg(maxPowerLimit));
-        } else {
-            int pct = (current * 100) / maxPowerLimit;
-            powerRatioLabel->setText(QString("%1 / %2 W  (%3%)").arg(current).arg(maxPowerLimit).arg(pct));
+protected:
+    void paintEvent(QPaintEvent *event) override {
+        if (!firstPaintLogged) {
+            firstPaintLogged = true;
+            qInfo("Time to first paint: %lld ms", startupTimer.elapsed());
         }
+        QWidget::paintEvent(event);
     }
 
-    void setPreset(int power, int mem, int core) {
-        powerSpin->setValue(power);
-        memSpin->setValue(mem);
-        coreSpin->setValue(core);
-    }
-
+private slots:
     void ensureSudoAccess() {
-        QProcess check;
-        check.start("sudo", QStringList() << "-n" << "nvidia-smi" << "-L");
-        check.waitForFinished(3000);
-
-        if (check.exitCode() == 0)
+        // Writes go through the privileged helper; sudo is never needed.
+        // sysfs writes have no sudo path at all, so there is nothing to set up.
+        if (helper() || backend->name() == "amdgpu") {
+            queryFinished("Helper check");
             return;
+        }
+
+        auto *check = new TracedProcess(this);
+        connect(check, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+                [this, check](int exitCode, QProcess::ExitStatus status) {
+            check->deleteLater();
+            queryFinished("sudo check");
+            if (status != QProcess::NormalExit || exitCode != 0)
+                requestSudoAccess();
+        });
+        connect(check, &QProcess::errorOccurred, this, [this, check](QProcess::ProcessError error) {
+            if (error != QProcess::FailedToStart)
+                return;
+            check->deleteLater();
+            queryFinished("sudo check");
+        });
+        check->start("sudo", QStringList() << "-n" << "nvidia-smi" << "-L");
+        QTimer::singleShot(3000, check, &QProcess::kill);
+    }
 
+    void requestSudoAccess() {
         QString user = qEnvironmentVariable("USER");
         if (user.isEmpty()) {
             QProcess whoami;
@@ -237,7 +887,9 @@ private slots:
             user = whoami.readAllStandardOutput().trimmed();
         }
 
-        QString rule = user + " ALL=(ALL) NOPASSWD: /usr/bin/nvidia-smi, /usr/bin/nvidia-settings, /usr/bin/bash, /usr/bin/systemctl";
+        // Without gpu-control-helper only the two NVIDIA tools need sudo;
+        // the startup service is installed through pkexec instead.
+        QString rule = user + " ALL=(ALL) NOPASSWD: /usr/bin/nvidia-smi, /usr/bin/nvidia-settings";
 
         QMessageBox::information(this, "First Run Setup",
             "GPU Control needs one-time permission to manage your GPU.\n"
@@ -254,285 +906,567 @@ private slots:
         }
     }
 
+    // Shows the chosen file's values; for a GPU it does not mention the
+    // controls keep what they had
+    void selectProfile() {
+        profile = profileCombo->currentData().toString();
+        loadConfig();
+        for (GpuPanel *panel : panels) {
+            if (savedConfig.gpus.contains(panel->index()))
+                panel->setSettings(savedConfig.gpus[panel->index()]);
+            panel->setEfficientLimit(savedConfig.efficientLimits.value(panel->index()));
+        }
+        statusLabel->setText(profile.isEmpty() ? QString("Editing the saved settings")
+                             : QString("Editing profile %1; Apply writes and saves it").arg(profile));
+        statusLabel->setStyleSheet("color: #888; padding: 6px; font-size: 13px;");
+    }
+
+    void saveProfileAs() {
+        QString name = QInputDialog::getText(this, "Save Profile", "Profile name:").trimmed();
+        if (name.isEmpty())
+            return;
+        // A name, never a path out of the profiles directory
+        if (name.contains('/') || name.startsWith('.')) {
+            QMessageBox::warning(this, "Save Profile", "Bad profile name " + name);
+            return;
+        }
+        GpuConfig config;
+        config.efficientLimits = savedConfig.efficientLimits;
+        for (GpuPanel *panel : panels)
+            config.gpus[panel->index()] = panel->settings();
+        if (!config.save(GpuConfig::path(name))) {
+            QMessageBox::warning(this, "Save Profile", "Cannot write " + GpuConfig::path(name));
+            return;
+        }
+        fillProfiles(name);
+        selectProfile();
+    }
+
     void resetDefaults() {
-        setPreset(defaultPowerLimit, 0, 0);
-        applySettings();
-        statusLabel->setText("Reset to stock defaults");
-        statusLabel->setStyleSheet("color: #e67e22; padding: 6px; font-size: 13px; font-weight: bold;");
-    }
-
-    void applySettings() {
-        int power = powerSpin->value();
-        int mem = memSpin->value();
-        int core = coreSpin->value();
-        bool startup = startupCheck->isChecked();
-
-        QStringList errors;
-
-        QProcess plProc;
-        plProc.start("sudo", QStringList() << "nvidia-smi" << "-pl" << QString::number(power));
-        plProc.waitForFinished(5000);
-        if (plProc.exitCode() != 0)
-            errors << "Power limit: " + plProc.readAllStandardError().trimmed();
-
-        QProcess memProc;
-        memProc.start("sudo", QStringList() << "nvidia-settings" << "-a"
-            << QString("[gpu:0]/GPUMemoryTransferRateOffsetAllPerformanceLevels=%1").arg(mem));
-        memProc.waitForFinished(5000);
-        if (memProc.exitCode() != 0)
-            errors << "Memory offset: " + memProc.readAllStandardError().trimmed();
-
-        QProcess coreProc;
-        coreProc.start("sudo", QStringList() << "nvidia-settings" << "-a"
-            << QString("[gpu:0]/GPUGraphicsClockOffsetAllPerformanceLevels=%1").arg(core));
-        coreProc.waitForFinished(5000);
-        if (coreProc.exitCode() != 0)
-            errors << "Core offset: " + coreProc.readAllStandardError().trimmed();
-
-        if (startup) {
-            writeStartupService(power, mem, core);
-        } else {
-            removeStartupService();
+        for (GpuPanel *panel : panels)
+            panel->resetToDefaults();
+        applySettings("Reset to stock defaults");
+    }
+
+    // Writes run on the thread pool and the rest happens once the last one
+    // is back, so the window keeps painting through a slow sudo chain.
+    // doneText replaces the usual status line on success.
+    void applySettings(const QString &doneText = QString()) {
+        if (applying)
+            return;
+        auto span = QSharedPointer<TraceSpan>::create("applySettings", "ui");
+        QElapsedTimer timer;
+        timer.start();
+
+        struct Job {
+            GpuPanel *panel;
+            GpuSettings target;
+            int fields;
+            ApplyResult result;
+        };
+        struct Batch {
+            QVector<Job> jobs;
+            int remaining = 0;
+        };
+        QSharedPointer<Batch> batch(new Batch);
+
+        // Only write what differs from the state last read back or applied,
+        // and write every GPU at once so N cards cost about as much as one
+        for (GpuPanel *panel : panels) {
+            Job job;
+            job.panel = panel;
+            job.target = panel->settings();
+            job.fields = panel->changedFields(job.target);
+            // The governor owns the power limit while it runs
+            if (panel->governing())
+                job.fields &= ~ApplyPowerLimit;
+            if (job.fields)
+                ++batch->remaining;
+            batch->jobs.append(job);
+        }
+        if (!batch->remaining) {
+            finishApply(batch->jobs.size(), 0, QStringList(), batch->jobs.isEmpty() ? GpuSettings()
+                        : batch->jobs.first().target, configFor(batch->jobs), timer, doneText);
+            return;
         }
 
-        saveConfig(power, mem, core, startup);
+        applying = true;
+        applyBtn->setEnabled(false);
+        statusLabel->setText("Applying...");
+        statusLabel->setStyleSheet("color: #888; padding: 6px; font-size: 13px;");
+        GpuBackend *b = backend.data();
+        for (int i = 0; i < batch->jobs.size(); ++i) {
+            const Job &job = batch->jobs[i];
+            if (!job.fields)
+                continue;
+            int gpu = job.panel->index();
+            GpuSettings target = job.target;
+            int fields = job.fields;
+            runQuery<ApplyResult>([b, gpu, target, fields]() { return b->apply(gpu, target, fields); },
+                                  [this, batch, i, span, timer, doneText](const ApplyResult &result) {
+                batch->jobs[i].result = result;
+                if (--batch->remaining)
+                    return;
+                QStringList errors;
+                int changed = 0;
+                for (const Job &job : batch->jobs) {
+                    if (!job.fields)
+                        continue;
+                    ++changed;
+                    job.panel->markApplied(job.target, job.fields, job.result);
+                    for (const QString &error : job.result.errors)
+                        errors << (panels.size() > 1 ? QString("GPU %1: %2").arg(job.panel->index()).arg(error) : error);
+                }
+                applying = false;
+                applyBtn->setEnabled(true);
+                finishApply(batch->jobs.size(), changed, errors, batch->jobs.first().target,
+                            configFor(batch->jobs), timer, doneText);
+            });
+        }
+    }
 
+private:
+    template <typename Jobs>
+    GpuConfig configFor(const Jobs &jobs) const {
+        GpuConfig config = savedConfig;
+        if (profile.isEmpty())
+            config.startup = startupCheck->isChecked();
+        for (const auto &job : jobs)
+            config.gpus[job.panel->index()] = job.target;
+        return config;
+    }
+
+    // Saves what was applied, keeps the startup unit in step and reports.
+    // The unit follows the main settings only; profiles have none.
+    void finishApply(int total, int changed, const QStringList &errors, const GpuSettings &first,
+                     const GpuConfig &config, const QElapsedTimer &timer, const QString &doneText) {
+        if (profile.isEmpty())
+            syncStartupService(config.startup, config.gpus);
+
+        config.save(GpuConfig::path(profile));
+        savedConfig = config;
+
+        qint64 elapsed = timer.elapsed();
+        qInfo("Apply: %d of %d GPUs changed in %lld ms", changed, total, elapsed);
         if (errors.isEmpty()) {
-            statusLabel->setText(QString("Applied: %1W | Mem +%2 | Core +%3").arg(power).arg(mem).arg(core));
-            statusLabel->setStyleSheet("color: #4CAF50; padding: 6px; font-size: 13px; font-weight: bold;");
+            QString text;
+            if (!doneText.isEmpty()) {
+                text = doneText;
+            } else if (!changed) {
+                text = QString("No changes to apply  (%1 ms)").arg(elapsed);
+            } else if (total == 1) {
+                text = QString("Applied: %1W | Mem +%2 | Core +%3  (%4 ms)")
+                    .arg(first.powerLimit).arg(first.memoryOffset).arg(first.coreOffset).arg(elapsed);
+            } else {
+                text = QString("Applied to %1 of %2 GPUs  (%3 ms)").arg(changed).arg(total).arg(elapsed);
+            }
+            statusLabel->setText(text);
+            statusLabel->setStyleSheet(doneText.isEmpty()
+                ? "color: #4CAF50; padding: 6px; font-size: 13px; font-weight: bold;"
+                : "color: #e67e22; padding: 6px; font-size: 13px; font-weight: bold;");
         } else {
+            statusLabel->clear();
             QMessageBox::warning(this, "Errors", errors.join("\n"));
         }
     }
 
-private:
-    QSpinBox *powerSpin;
-    QSpinBox *memSpin;
-    QSpinBox *coreSpin;
-    QLabel *memEquiv;
     QLabel *statusLabel;
-    QLabel *gpuNameLabel;
-    QLabel *powerRatioLabel;
+    QPushButton *applyBtn;
+    bool applying = false;
+    QTabWidget *tabs;
+    QComboBox *profileCombo;
     QCheckBox *startupCheck;
-    int maxPowerLimit;
-    int defaultPowerLimit;
+    QCheckBox *liveCheck;
+    QVector<GpuPanel *> panels;
+    QVector<LiveApplier *> liveAppliers;
+    TelemetrySampler *sampler = nullptr;
+    QScopedPointer<TelemetryRecorder> recorder;
+    QScopedPointer<GpuBackend> backend;
+    MockBackend *simulator = nullptr;       // Inside backend when it is the mock
+    QString profile;                        // Empty: the main settings
+    GpuConfig savedConfig;                  // Contents of profile's file
+    bool startupInstalled = false;
+    QMap<int, GpuSettings> startupValues;   // Values baked into the startup service
+    bool startupBusy = false;               // An install or removal is running
+    bool startupWanted = false;             // Latest request, for when it ends
+    QMap<int, GpuSettings> startupWantedValues;
+    int pendingQueries = 0;
+    bool firstPaintLogged = false;
+
+    // Runs query on the global thread pool and hands its result to handler
+    // on the GUI thread.
+    template <typename T, typename Query, typename Handler>
+    void runQuery(Query query, Handler handler) {
+        auto *watcher = new QFutureWatcher<T>(this);
+        connect(watcher, &QFutureWatcherBase::finished, this, [watcher, handler]() {
+            handler(watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(QtConcurrent::run(query));
+    }
 
-    int queryMaxPowerLimit() {
-        QProcess proc;
-        proc.start("nvidia-smi", QStringList()
-            << "--query-gpu=power.max_limit"
-            << "--format=csv,noheader,nounits");
-        proc.waitForFinished(5000);
-        QString output = proc.readAllStandardOutput().trimmed();
-        int val = output.split(".").first().toInt();
-        return val > 0 ? val : 450;
+    void queryFinished(const char *what) {
+        qInfo("%s ready after %lld ms", what, startupTimer.elapsed());
+        if (--pendingQueries != 0)
+            return;
+        qInfo("Time to fully populated: %lld ms", startupTimer.elapsed());
+        // Lets gpu-control-bench time a cold start end to end
+        if (qEnvironmentVariableIsSet("GPU_CONTROL_EXIT_WHEN_READY"))
+            QTimer::singleShot(0, qApp, &QCoreApplication::quit);
     }
 
-    int queryDefaultPowerLimit() {
-        QProcess proc;
-        proc.start("nvidia-smi", QStringList()
-            << "--query-gpu=power.default_limit"
-            << "--format=csv,noheader,nounits");
-        proc.waitForFinished(5000);
-        QString output = proc.readAllStandardOutput().trimmed();
-        int val = output.split(".").first().toInt();
-        return val > 0 ? val : 450;
+    static bool sameSettings(const QMap<int, GpuSettings> &a, const QMap<int, GpuSettings> &b) {
+        if (a.size() != b.size())
+            return false;
+        for (auto it = a.constBegin(); it != a.constEnd(); ++it) {
+            auto other = b.constFind(it.key());
+            if (other == b.constEnd() || other->powerLimit != it->powerLimit
+                || other->memoryOffset != it->memoryOffset || other->coreOffset != it->coreOffset
+                || other->graphicsLockMin != it->graphicsLockMin || other->graphicsLockMax != it->graphicsLockMax
+                || other->memoryLockMin != it->memoryLockMin || other->memoryLockMax != it->memoryLockMax)
+                return false;
+        }
+        return true;
     }
 
-    QString queryGpuName() {
-        QProcess proc;
-        proc.start("nvidia-smi", QStringList()
-            << "--query-gpu=name"
-            << "--format=csv,noheader");
-        proc.waitForFinished(5000);
-        QString name = proc.readAllStandardOutput().trimmed();
-        return name.isEmpty() ? "NVIDIA GPU" : name;
+    void addPanel(int gpu) {
+        auto *panel = new GpuPanel(gpu);
+        if (savedConfig.gpus.contains(gpu))
+            panel->setSettings(savedConfig.gpus[gpu]);
+        panel->setEfficientLimit(savedConfig.efficientLimits.value(gpu));
+        connect(panel->sweepButton(), &QPushButton::clicked, this, [this, panel]() { openSweep(panel); });
+        connect(panel->tuneButton(), &QPushButton::clicked, this, [this, panel]() { openTuner(panel); });
+        connect(panel->governorCheckBox(), &QCheckBox::toggled, this, [this, panel](bool on) {
+            // Hand the power limit back to the panel's setting
+            if (!on)
+                writeGovernedLimit(panel, panel->settings().powerLimit);
+        });
+        panels.append(panel);
+        // The panel is taller than the minimum window; it scrolls rather
+        // than pushing Apply off a small screen
+        auto *scroll = new QScrollArea();
+        scroll->setWidget(panel);
+        scroll->setWidgetResizable(true);
+        scroll->setFrameShape(QFrame::NoFrame);
+        scroll->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+        tabs->addTab(scroll, QString("GPU %1").arg(gpu));
+
+        auto *live = new LiveApplier(backend.data(), gpu, panel);
+        live->setEnabled(liveCheck->isChecked());
+        live->setSource([panel]() { return panel->settings(); }, [panel](const GpuSettings &target) {
+            int fields = panel->changedFields(target);
+            // The governor owns the power limit while it runs
+            return panel->governing() ? fields & ~ApplyPowerLimit : fields;
+        });
+        live->setWrittenHandler([this, panel](const GpuSettings &target, int fields, const ApplyResult &result,
+                                              qint64 ms) { liveWritten(panel, target, fields, result, ms); });
+        panel->setEditedHandler([live](int fields) { live->edited(fields); });
+        liveAppliers.append(live);
+
+        pendingQueries += 2;
+        readCurrentValues(panel);
     }
 
-    QString configPath() {
-        return QDir::homePath() + "/.config/gpu-control.conf";
+    void setLiveApply(bool on) {
+        for (LiveApplier *live : liveAppliers)
+            live->setEnabled(on);
+        statusLabel->setText(on ? "Live apply: changes are written as you make them" : "Live apply off");
+        statusLabel->setStyleSheet("color: #888; padding: 6px; font-size: 13px;");
     }
 
-    void saveConfig(int power, int mem, int core, bool startup) {
-        QFile file(configPath());
-        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-            QTextStream out(&file);
-            out << "power=" << power << "\n";
-            out << "memory=" << mem << "\n";
-            out << "core=" << core << "\n";
-            out << "startup=" << (startup ? "1" : "0") << "\n";
+    // Errors go to the status line; a dialog per keystroke would be unusable
+    void liveWritten(GpuPanel *panel, const GpuSettings &target, int fields, const ApplyResult &result, qint64 ms) {
+        panel->markApplied(target, fields, result);
+        QString prefix = panels.size() > 1 ? QString("GPU %1: ").arg(panel->index()) : QString();
+        if (!result.ok()) {
+            statusLabel->setText(prefix + result.errors.join("; "));
+            statusLabel->setStyleSheet("color: #e74c3c; padding: 6px; font-size: 13px; font-weight: bold;");
+            return;
         }
+        QStringList parts;
+        if (fields & ApplyPowerLimit)
+            parts << QString("%1W").arg(target.powerLimit);
+        if (fields & ApplyMemoryOffset)
+            parts << QString("Mem %1%2").arg(target.memoryOffset >= 0 ? "+" : "").arg(target.memoryOffset);
+        if (fields & ApplyCoreOffset)
+            parts << QString("Core %1%2").arg(target.coreOffset >= 0 ? "+" : "").arg(target.coreOffset);
+        if (fields & ApplyGraphicsLock)
+            parts << (target.graphicsLockMax > 0
+                      ? QString("Core lock %1-%2 MHz").arg(target.graphicsLockMin).arg(target.graphicsLockMax)
+                      : QString("Core unlocked"));
+        if (fields & ApplyMemoryLock)
+            parts << (target.memoryLockMax > 0
+                      ? QString("Mem lock %1-%2 MHz").arg(target.memoryLockMin).arg(target.memoryLockMax)
+                      : QString("Mem unlocked"));
+        statusLabel->setText(QString("Live: %1%2  (%3 ms, Apply to save)").arg(prefix, parts.join(" | ")).arg(ms));
+        statusLabel->setStyleSheet("color: #4CAF50; padding: 6px; font-size: 13px; font-weight: bold;");
     }
 
-    void loadConfig() {
-        QFile file(configPath());
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream in(&file);
-            while (!in.atEnd()) {
-                QString line = in.readLine();
-                auto parts = line.split("=");
-                if (parts.size() == 2) {
-                    if (parts[0] == "power") powerSpin->setValue(parts[1].toInt());
-                    if (parts[0] == "memory") memSpin->setValue(parts[1].toInt());
-                    if (parts[0] == "core") coreSpin->setValue(parts[1].toInt());
-                    if (parts[0] == "startup") startupCheck->setChecked(parts[1] == "1");
-                }
-            }
+    void openSweep(GpuPanel *panel) {
+        int gpu = panel->index();
+        auto *dialog = new PowerSweepDialog(backend.data(), simulator, gpu, panel->minimumPower(), panel->maximumPower(),
+                                            [this, panel, gpu](int watts) {
+            panel->setEfficientLimit(watts);
+            savedConfig.efficientLimits[gpu] = watts;
+            savedConfig.save(GpuConfig::path(profile));
+        }, this);
+        dialog->setAttribute(Qt::WA_DeleteOnClose);
+        dialog->open();
+    }
+
+    void openHistory() {
+        // Hand the last few seconds to the reader too
+        if (recorder)
+            recorder->flush();
+        auto *dialog = new ReplayDialog(this);
+        dialog->setAttribute(Qt::WA_DeleteOnClose);
+        dialog->show();
+    }
+
+    void openTuner(GpuPanel *panel) {
+        auto *dialog = new OffsetTunerDialog(backend.data(), simulator, panel->index(), panel->pciBusId(),
+                                             panel->maximumCoreOffset(), panel->maximumMemoryOffset(),
+                                             [panel](int core, int memory) { panel->setOffsets(core, memory); }, this);
+        dialog->setAttribute(Qt::WA_DeleteOnClose);
+        // Probes write offsets behind the panel's back; the tuner puts the
+        // old ones back, but rewrite them on the next apply in case that failed
+        connect(dialog, &QDialog::finished, this, [panel]() { panel->forgetAppliedOffsets(); });
+        dialog->open();
+    }
+
+    void enumerateDevices() {
+        GpuBackend *b = backend.data();
+        runQuery<int>([b]() { return b->deviceCount(); }, [this](int count) {
+            for (int gpu = panels.size(); gpu < count; ++gpu)
+                addPanel(gpu);
+            startTelemetry(qMax(1, count));
+            queryFinished(QString("Device enumeration (%1 GPUs)").arg(count).toLatin1().constData());
+        });
+    }
+
+    // Static properties come from the on-disk cache when this board and
+    // driver have been seen before; otherwise they are queried and stored.
+    void loadStaticInfo(GpuPanel *panel, const GpuSnapshot &snap) {
+        GpuStaticInfo info;
+        if (StaticCache::load(snap.pciBusId, snap.driverVersion, &info)) {
+            showStaticInfo(panel, info);
+            queryFinished("Static properties (cached)");
+            return;
         }
-        updateEquiv();
-        updatePowerRatio();
+
+        GpuBackend *b = backend.data();
+        int gpu = panel->index();
+        QString busId = snap.pciBusId;
+        QString driver = snap.driverVersion;
+        runQuery<GpuStaticInfo>([b, gpu, busId, driver]() {
+            GpuStaticInfo info = b->staticInfo(gpu);
+            StaticCache::store(busId, driver, info);
+            return info;
+        }, [this, panel](const GpuStaticInfo &info) {
+            showStaticInfo(panel, info);
+            queryFinished("Static properties");
+        });
     }
 
-    void readCurrentValues() {
-        QProcess smiProc;
-        smiProc.start("nvidia-smi", QStringList()
-            << "--query-gpu=power.limit,clocks.current.memory,clocks.current.graphics"
-            << "--format=csv,noheader,nounits");
-        smiProc.waitForFinished(5000);
-        QString smiOut = smiProc.readAllStandardOutput().trimmed();
-
-        // Get clock offsets from nvidia-settings
-        QProcess memOffProc;
-        memOffProc.start("nvidia-settings", QStringList() << "-t" << "-q"
-            << "[gpu:0]/GPUMemoryTransferRateOffsetAllPerformanceLevels");
-        memOffProc.waitForFinished(3000);
-        QString memOff = memOffProc.readAllStandardOutput().trimmed();
-
-        QProcess coreOffProc;
-        coreOffProc.start("nvidia-settings", QStringList() << "-t" << "-q"
-            << "[gpu:0]/GPUGraphicsClockOffsetAllPerformanceLevels");
-        coreOffProc.waitForFinished(3000);
-        QString coreOff = coreOffProc.readAllStandardOutput().trimmed();
-
-        // Get current power limit
-        QProcess powerProc;
-        powerProc.start("nvidia-smi", QStringList()
-            << "--query-gpu=power.limit"
-            << "--format=csv,noheader,nounits");
-        powerProc.waitForFinished(5000);
-        QString powerVal = powerProc.readAllStandardOutput().trimmed().split('.').first();
-
-        // Update spinboxes with current values from GPU (if config wasn't loaded or was empty)
-        QFile configFile(configPath());
-        bool configExists = configFile.exists();
-
-        if (!configExists) {
-            // No config file, try to read current values from GPU
-            bool memOk = false;
-            int memVal = memOff.toInt(&memOk);
-            if (memOk && memOffProc.exitCode() == 0) {
-                memSpin->setValue(memVal);
-            }
+    void showStaticInfo(GpuPanel *panel, const GpuStaticInfo &info) {
+        panel->showStaticInfo(info);
+        // Tabs are added in panel order and never removed
+        tabs->setTabText(panels.indexOf(panel), QString("GPU %1: %2").arg(panel->index()).arg(panel->name()));
+    }
 
-            bool coreOk = false;
-            int coreVal = coreOff.toInt(&coreOk);
-            if (coreOk && coreOffProc.exitCode() == 0) {
-                coreSpin->setValue(coreVal);
-            }
+    void loadConfig() {
+        savedConfig = GpuConfig::load(GpuConfig::path(profile));
+        startupCheck->setEnabled(profile.isEmpty());
+        if (!profile.isEmpty())
+            return;
+        startupCheck->setChecked(savedConfig.startup);
+        startupInstalled = savedConfig.startup;
+        startupValues = savedConfig.gpus;
+    }
 
-            bool powerOk = false;
-            int powerInt = powerVal.toInt(&powerOk);
-            if (powerOk && powerInt > 0) {
-                powerSpin->setValue(powerInt);
+    void fillProfiles(const QString &select = QString()) {
+        profileCombo->clear();
+        profileCombo->addItem("Saved settings", QString());
+        for (const QString &name : GpuConfig::profiles())
+            profileCombo->addItem(name, name);
+        profileCombo->setCurrentIndex(qMax(0, profileCombo->findData(select)));
+    }
+
+    void readCurrentValues(GpuPanel *panel) {
+        GpuBackend *b = backend.data();
+        int gpu = panel->index();
+        runQuery<GpuSnapshot>([b, gpu]() { return b->snapshot(gpu); }, [this, panel](const GpuSnapshot &snap) {
+            // Controls show the GPU's live values only when nothing was saved for it
+            panel->showCurrentValues(snap, !savedConfig.gpus.contains(panel->index()));
+            queryFinished("Current values");
+            // The snapshot carries the bus ID and driver version that key
+            // the static-properties cache.
+            if (!panel->staticInfoLoaded) {
+                panel->staticInfoLoaded = true;
+                loadStaticInfo(panel, snap);
             }
+        });
+    }
 
-            updateEquiv();
-            updatePowerRatio();
-        }
+    void startTelemetry(int gpuCount) {
+        bool ok = false;
+        int intervalMs = qEnvironmentVariableIntValue("GPU_CONTROL_SAMPLE_MS", &ok);
+        if (!ok || intervalMs <= 0)
+            intervalMs = 100;
 
-        if (!smiOut.isEmpty()) {
-            QStringList parts = smiOut.split(",");
-            QString power = parts.size() > 0 ? parts[0].trimmed().split(".").first() + "W" : "?";
-            QString status = QString("Current: %1 | Mem +%2 | Core +%3")
-                .arg(power)
-                .arg(memOff.isEmpty() ? "0" : memOff)
-                .arg(coreOff.isEmpty() ? "0" : coreOff);
-            statusLabel->setText(status);
+        sampler = new TelemetrySampler(backend.data(), gpuCount, intervalMs, this);
+        sampler->start();
+        recorder.reset(new TelemetryRecorder);
+
+        auto *drainTimer = new QTimer(this);
+        connect(drainTimer, &QTimer::timeout, this, &GpuControl::drainTelemetry);
+        drainTimer->start(intervalMs);
+    }
+
+    // Runs on the GUI thread, the ring's only consumer
+    void drainTelemetry() {
+        TelemetrySample sample;
+        while (sampler->samples().pop(&sample)) {
+            if (sample.gpu < 0 || sample.gpu >= panels.size())
+                continue;
+            GpuPanel *panel = panels[sample.gpu];
+            panel->addSample(sample);
+            recorder->append(sample);
+            int limit = panel->governorUpdate(sample);
+            if (limit > 0)
+                writeGovernedLimit(panel, limit);
         }
+        for (GpuPanel *panel : panels)
+            panel->refreshTelemetryLabels();
     }
 
-    void writeStartupService(int power, int mem, int core) {
+    void writeGovernedLimit(GpuPanel *panel, int limit) {
+        GpuBackend *b = backend.data();
+        int gpu = panel->index();
+        GpuSettings target;
+        target.powerLimit = limit;
+        runQuery<ApplyResult>([b, gpu, target]() { return b->apply(gpu, target, ApplyPowerLimit); },
+                              [panel, limit](const ApplyResult &result) { panel->governorWrote(limit, result); });
+    }
+
+    HelperBackend *helper() const {
+        return dynamic_cast<HelperBackend *>(backend.data());
+    }
+
+    // Brings the startup unit in line with what was saved. pkexec waits on
+    // a password prompt and the helper on systemctl, so this runs on the
+    // thread pool, one install or removal at a time; an Apply made
+    // meanwhile is picked up when the running one ends. A failure is left
+    // for the next Apply to retry.
+    void syncStartupService(bool wanted, const QMap<int, GpuSettings> &gpus) {
+        startupWanted = wanted;
+        startupWantedValues = gpus;
+        if (startupBusy)
+            return;
+        if (wanted == startupInstalled && (!wanted || sameSettings(startupValues, gpus)))
+            return;
+
+        startupBusy = true;
+        GpuBackend *b = backend.data();
+        runQuery<QString>([b, wanted, gpus]() {
+            return wanted ? installStartupService(b, gpus) : uninstallStartupService(b);
+        }, [this, wanted, gpus](const QString &error) {
+            startupBusy = false;
+            if (!error.isEmpty()) {
+                qWarning("%s startup service failed: %s", wanted ? "Installing" : "Removing", qPrintable(error));
+                statusLabel->setText(QString("Startup service: %1").arg(error));
+                statusLabel->setStyleSheet("color: #e74c3c; padding: 6px; font-size: 13px; font-weight: bold;");
+                return;
+            }
+            startupInstalled = wanted;
+            startupValues = gpus;
+            syncStartupService(startupWanted, startupWantedValues);
+        });
+    }
+
+    // Run on the thread pool; return an error, empty on success
+    static QString installStartupService(GpuBackend *b, const QMap<int, GpuSettings> &gpus) {
+        QString error;
+        if (auto *helper = dynamic_cast<HelperBackend *>(b)) {
+            helper->installStartupService(gpus, &error);
+            return error;
+        }
+
         QString setupPath = QDir::homePath() + "/.local/bin/gpu-control-setup.sh";
         QDir().mkpath(QDir::homePath() + "/.local/bin");
 
-        // Also create a startup script that will be called by the service
-        QString scriptPath = QDir::homePath() + "/.local/bin/gpu-control-startup.sh";
-        QFile script(scriptPath);
-        if (script.open(QIODevice::WriteOnly | QIODevice::Text)) {
-            QTextStream s(&script);
-            s << "#!/bin/bash\n";
-            s << "# GPU Control startup script\n";
-            s << "# This script applies saved GPU settings on boot\n\n";
-            s << "export DISPLAY=:0\n";
-            s << "export XAUTHORITY=/run/user/1000/gdm/Xauthority\n\n";
-            s << "# Wait for nvidia driver to be ready\n";
-            s << "for i in {1..30}; do\n";
-            s << "    if nvidia-smi -L >/dev/null 2>&1; then\n";
-            s << "        break\n";
-            s << "    fi\n";
-            s << "    sleep 1\n";
-            s << "done\n\n";
-            s << "# Apply power limit\n";
-            s << "nvidia-smi -pl " << power << "\n\n";
-            s << "# Wait for X display to be ready and apply clock offsets\n";
-            s << "sleep 5\n";
-            s << "for i in {1..30}; do\n";
-            s << "    if [ -n \"$DISPLAY\" ] && nvidia-settings -q [gpu:0]/GPUMemoryTransferRateOffsetAllPerformanceLevels >/dev/null 2>&1; then\n";
-            s << "        nvidia-settings -a [gpu:0]/GPUMemoryTransferRateOffsetAllPerformanceLevels=" << mem << "\n";
-            s << "        nvidia-settings -a [gpu:0]/GPUGraphicsClockOffsetAllPerformanceLevels=" << core << "\n";
-            s << "        logger \"GPU Control: Settings applied successfully\"\n";
-            s << "        exit 0\n";
-            s << "    fi\n";
-            s << "    sleep 2\n";
-            s << "done\n\n";
-            s << "logger \"GPU Control: Failed to apply settings\"\n";
-            s << "exit 1\n";
-            script.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner |
-                                  QFile::ReadGroup | QFile::ExeGroup |
-                                  QFile::ReadOther | QFile::ExeOther);
-        }
+        // The unit runs `gpu-control --apply` on a root-owned copy of the settings
+        GpuConfig config;
+        config.gpus = gpus;
+        config.startup = true;
 
         QFile setup(setupPath);
         if (setup.open(QIODevice::WriteOnly | QIODevice::Text)) {
             QTextStream out(&setup);
             out << "#!/bin/bash\n";
+            out << "mkdir -p /etc/gpu-control\n";
+            out << "cat > " << StartupService::configPath() << " << 'CONFIGEOF'\n";
+            out << config.toText();
+            out << "CONFIGEOF\n";
+            out << "rm -f /etc/gpu-control/startup.sh\n";
             out << "cat > /etc/systemd/system/gpu-control.service << 'SERVICEEOF'\n";
-            out << "[Unit]\n";
-            out << "Description=GPU Control - Power and Clock Offsets\n";
-            out << "After=nvidia-persistenced.service display-manager.service\n";
-            out << "After=graphical-session.target\n";
-            out << "Wants=display-manager.service\n\n";
-            out << "[Service]\n";
-            out << "Type=oneshot\n";
-            out << "RemainAfterExit=yes\n";
-            out << "ExecStart=" << scriptPath << "\n\n";
-            out << "[Install]\n";
-            out << "WantedBy=graphical.target\n";
+            out << StartupService::unit(StartupService::execStart());
             out << "SERVICEEOF\n";
             out << "systemctl daemon-reload\n";
             out << "systemctl enable gpu-control.service\n";
             setup.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner |
                                  QFile::ReadGroup | QFile::ExeGroup |
                                  QFile::ReadOther | QFile::ExeOther);
+            out.flush();
+            setup.close();
         }
 
-        QProcess proc;
-        proc.start("sudo", QStringList() << "bash" << setupPath);
-        proc.waitForFinished(15000);
+        TracedProcess proc;
+        proc.start("pkexec", QStringList() << "bash" << setupPath);
+        return pkexecError(&proc);
     }
 
-    void removeStartupService() {
-        QProcess proc;
-        proc.start("sudo", QStringList() << "bash" << "-c"
-            << "systemctl disable gpu-control.service; rm -f /etc/systemd/system/gpu-control.service; systemctl daemon-reload");
-        proc.waitForFinished(15000);
+    static QString uninstallStartupService(GpuBackend *b) {
+        QString error;
+        if (auto *helper = dynamic_cast<HelperBackend *>(b)) {
+            helper->removeStartupService(&error);
+            return error;
+        }
+
+        TracedProcess proc;
+        proc.start("pkexec", QStringList() << "bash" << "-c"
+            << "systemctl disable gpu-control.service; rm -f /etc/systemd/system/gpu-control.service "
+                + StartupService::configPath() + "; systemctl daemon-reload");
+        return pkexecError(&proc);
+    }
+
+    static QString pkexecError(QProcess *proc) {
+        proc->waitForFinished(30000);
+        if (proc->error() == QProcess::FailedToStart)
+            return "Cannot run pkexec";
+        if (proc->state() != QProcess::NotRunning)
+            return "pkexec did not finish within 30 s";
+        if (proc->exitStatus() != QProcess::NormalExit || proc->exitCode() != 0) {
+            QString text = QString::fromLocal8Bit(proc->readAllStandardError()).trimmed();
+            return text.isEmpty() ? QString("pkexec exited with %1").arg(proc->exitCode()) : "pkexec: " + text;
+        }
+        return QString();
     }
 };
 
 #include "gpu-control.moc"
 
 int main(int argc, char *argv[]) {
+    startupTimer.start();
+    if (HeadlessApply::requested(argc, argv))
+        return HeadlessApply::run(argc, argv);
+    if (RemoteControl::requested(argc, argv))
+        return RemoteControl::run(argc, argv);
+
     QApplication app(argc, argv);
+    installTraceExport(app.arguments());
+    // GPU queries block on the driver, not the CPU; let them all run at once.
+    QThreadPool::globalInstance()->setMaxThreadCount(qMax(QThread::idealThreadCount(), 8));
     app.setStyle("Fusion");
     GpuControl window;
     window.show();
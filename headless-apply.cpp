@@ -0,0 +1,685 @@
+#include "headless-apply.h"
+
+#include "agent-protocol.h"
+#include "agent-server.h"
+#include "config.h"
+#include "drift-monitor.h"
+#include "governor.h"
+#include "gpu-backend.h"
+#include "helper-backend.h"
+#include "metrics-server.h"
+#include "telemetry.h"
+#include "telemetry-recorder.h"
+#include "tracer.h"
+#include "tracing-backend.h"
+#include "workload-watcher.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QScopedPointer>
+#include <QTimer>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <csignal>
+#include <cstring>
+#include <functional>
+#include <unistd.h>
+
+namespace {
+
+// Seconds since boot from /proc/uptime, or -1 where that is unavailable
+double secondsSinceBoot() {
+    QFile file("/proc/uptime");
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+    bool ok = false;
+    double uptime = file.readLine().split(' ').value(0).toDouble(&ok);
+    return ok ? uptime : -1;
+}
+
+// Returns once the deadline passes, the timeout elapses, or (when watcher is
+// given) something changes in a watched directory, whichever comes first.
+void waitFor(int timeoutMs, const QDeadlineTimer &deadline, QFileSystemWatcher *watcher) {
+    QEventLoop loop;
+    QTimer::singleShot(qMin<qint64>(timeoutMs, deadline.remainingTime()), &loop, &QEventLoop::quit);
+    if (watcher)
+        QObject::connect(watcher, &QFileSystemWatcher::directoryChanged, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+// Creates backends until one sees at least one GPU. Device nodes appear in
+// /dev as the kernel module loads, so a change there triggers an immediate
+// retry; otherwise retries back off from 10 ms to 500 ms.
+GpuBackend *waitForDriver(const QString &kind, const QDeadlineTimer &deadline, int *count) {
+    QFileSystemWatcher watcher(QStringList() << "/dev");
+    int backoffMs = 10;
+    forever {
+        QScopedPointer<GpuBackend> backend(GpuBackend::create(kind));
+        *count = backend->deviceCount();
+        if (*count > 0)
+            return backend.take();
+        if (deadline.hasExpired())
+            return nullptr;
+        waitFor(backoffMs, deadline, &watcher);
+        backoffMs = qMin(backoffMs * 2, 500);
+    }
+}
+
+// The boot unit runs outside any session, so nvidia-settings has no X
+// server to talk to. Display managers start X with ":N" and "-auth FILE"
+// on its command line; take both from there and export them for the child
+// processes. Returns false when no X server is running.
+bool useRunningDisplay() {
+    QDir proc("/proc");
+    for (const QString &pid : proc.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile comm(proc.filePath(pid + "/comm"));
+        if (!comm.open(QIODevice::ReadOnly))
+            continue;
+        QByteArray name = comm.readAll().trimmed();
+        if (name != "Xorg" && name != "X")
+            continue;
+        QFile cmdline(proc.filePath(pid + "/cmdline"));
+        if (!cmdline.open(QIODevice::ReadOnly))
+            continue;
+        QList<QByteArray> args = cmdline.readAll().split('\0');
+        QByteArray display = ":0";
+        QByteArray auth;
+        for (int i = 1; i < args.size(); ++i) {
+            if (args[i].startsWith(':'))
+                display = args[i];
+            else if (args[i] == "-auth" && i + 1 < args.size())
+                auth = args[i + 1];
+        }
+        qputenv("DISPLAY", display);
+        if (!auth.isEmpty())
+            qputenv("XAUTHORITY", auth);
+        qInfo("Using X display %s (auth %s)", display.constData(), auth.isEmpty() ? "none" : auth.constData());
+        return true;
+    }
+    return false;
+}
+
+// Set while serving /metrics; applies report into it
+MetricsServer *metrics = nullptr;
+
+// backend->apply(), timed for /metrics
+ApplyResult timedApply(GpuBackend *backend, int gpu, const GpuSettings &settings, int fields) {
+    QElapsedTimer timer;
+    timer.start();
+    ApplyResult result = backend->apply(gpu, settings, fields);
+    if (metrics)
+        metrics->recordApply(result.ok(), timer.nsecsElapsed() / 1e9);
+    return result;
+}
+
+struct Pending {
+    int gpu;
+    GpuSettings settings;
+    int fields;
+    QStringList errors;
+};
+
+// Applies every entry concurrently; results come back in the same order.
+// Safe on a pool thread: nothing here touches /metrics settings.
+QVector<ApplyResult> applyEach(GpuBackend *backend, const QVector<Pending> &pending) {
+    QVector<QFuture<ApplyResult>> futures;
+    for (const Pending &entry : pending) {
+        int gpu = entry.gpu;
+        GpuSettings settings = entry.settings;
+        int fields = entry.fields;
+        futures.append(QtConcurrent::run([backend, gpu, settings, fields]() {
+            return timedApply(backend, gpu, settings, fields);
+        }));
+    }
+    QVector<ApplyResult> results;
+    for (QFuture<ApplyResult> &future : futures)
+        results.append(future.result());
+    return results;
+}
+
+// Notes what was written in /metrics and keeps only what failed
+void keepFailed(QVector<Pending> *pending, const QVector<ApplyResult> &results) {
+    QVector<Pending> failed;
+    for (int i = 0; i < pending->size(); ++i) {
+        const ApplyResult &result = results[i];
+        const Pending &entry = pending->at(i);
+        if (metrics)
+            metrics->setSettings(entry.gpu, entry.settings, entry.fields & ~result.failedFields);
+        if (result.ok())
+            continue;
+        Pending retry = entry;
+        retry.fields = result.failedFields;
+        retry.errors = result.errors;
+        failed.append(retry);
+    }
+    *pending = failed;
+}
+
+void applyAll(GpuBackend *backend, QVector<Pending> *pending) {
+    keepFailed(pending, applyEach(backend, *pending));
+}
+
+// What an apply of settings writes. A power limit of 0 means "leave it",
+// and so does an unlocked clock unless resetLocks: the driver starts out
+// unlocked, so only a profile switch can have anything to undo.
+int fieldsFor(const GpuSettings &settings, bool governed, bool resetLocks) {
+    int fields = ApplyAll;
+    if (settings.powerLimit <= 0 || governed)
+        fields &= ~ApplyPowerLimit;
+    if (settings.graphicsLockMax <= 0 && !resetLocks)
+        fields &= ~ApplyGraphicsLock;
+    if (settings.memoryLockMax <= 0 && !resetLocks)
+        fields &= ~ApplyMemoryLock;
+    return fields;
+}
+
+volatile sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+// A profile's settings as one write per GPU; the governor keeps the power limit
+QVector<Pending> profileWrites(const GpuConfig &profile, int count, bool governed) {
+    QVector<Pending> pending;
+    for (auto it = profile.gpus.constBegin(); it != profile.gpus.constEnd(); ++it) {
+        if (it.key() >= count)
+            continue;
+        Pending entry;
+        entry.gpu = it.key();
+        entry.settings = *it;
+        entry.fields = fieldsFor(*it, governed, true);
+        pending.append(entry);
+    }
+    return pending;
+}
+
+void warnFailed(const QVector<Pending> &failed) {
+    for (const Pending &entry : failed) {
+        for (const QString &error : entry.errors)
+            qWarning("GPU %d: %s", entry.gpu, qPrintable(error));
+    }
+}
+
+// Writes a profile's settings once, blocking; serve() switches profiles on
+// the thread pool instead
+void applyProfile(GpuBackend *backend, const GpuConfig &profile, int count, bool governed) {
+    QVector<Pending> pending = profileWrites(profile, count, governed);
+    applyAll(backend, &pending);
+    warnFailed(pending);
+}
+
+struct ServeOptions {
+    const GovernorOptions *governor = nullptr;
+    bool watch = false;
+    bool metrics = false;
+    bool record = false;
+    bool reapply = false;
+    QString agent;
+    bool agentInsecure = false;
+    int intervalMs = 1000;
+    int driftCheckMs = 60000;
+};
+
+// Stays up after the apply until SIGINT or SIGTERM. With governor options,
+// runs one PowerGovernor per configured GPU off the telemetry stream; with
+// watch, switches profiles as the rules in config match running processes;
+// with metrics, keeps the /metrics cache fed; with record, appends samples
+// to the telemetry history; with reapply, writes back whatever suspend, X
+// or the driver reset; with agent, answers AgentProtocol clients. On the
+// way out the saved settings are put back.
+int serve(GpuBackend *backend, const GpuConfig &config, int count, const ServeOptions &serveOptions) {
+    const GovernorOptions *governorOptions = serveOptions.governor;
+    int intervalMs = serveOptions.intervalMs;
+    QMap<int, PowerGovernor *> governors;
+    for (auto it = config.gpus.constBegin(); governorOptions && it != config.gpus.constEnd(); ++it) {
+        if (it.key() >= count)
+            continue;
+        GovernorOptions options = *governorOptions;
+        options.minPower = backend->minPowerLimit(it.key());
+        options.maxPower = backend->maxPowerLimit(it.key());
+        if (options.minPower <= 0 || options.maxPower < options.minPower) {
+            qWarning("GPU %d: power limit range unavailable, not governing it", it.key());
+            continue;
+        }
+        int initial = it->powerLimit > 0 ? it->powerLimit : backend->powerLimit(it.key());
+        governors.insert(it.key(), new PowerGovernor(options, initial));
+    }
+    if (governorOptions && governors.isEmpty())
+        return 1;
+    if (!governors.isEmpty())
+        qInfo("Governing %d GPUs: %s", governors.size(), qPrintable(governorOptions->describe()));
+
+    QScopedPointer<WorkloadWatcher> watcher;
+    if (serveOptions.watch) {
+        if (config.rules.isEmpty()) {
+            qWarning("No rule.NAME= lines in the settings; nothing to watch for");
+            return 1;
+        }
+        watcher.reset(new WorkloadWatcher(config.rules, config.idleProfile, 5000));
+        qInfo("Watching for %d workload rules", config.rules.size());
+    }
+
+    int enforced = governors.isEmpty() ? ApplyAll : ApplyAll & ~ApplyPowerLimit;
+    // What the drift monitor holds the GPUs to; profile switches and
+    // remote applies move it
+    QMap<int, GpuSettings> target = config.gpus;
+    QScopedPointer<DriftMonitor> drift;
+    if (serveOptions.reapply) {
+        drift.reset(new DriftMonitor(backend, count));
+        drift->setTarget(target, enforced);
+        drift->setRepairHandler([](int gpu, const GpuSettings &settings, int fields, const ApplyResult &result) {
+            if (!metrics)
+                return;
+            metrics->recordDrift(fields);
+            metrics->setSettings(gpu, settings, fields & ~result.failedFields);
+        });
+        drift->start(serveOptions.driftCheckMs);
+    }
+
+    bool remoteApplied = false;
+    QScopedPointer<AgentServer> agent;
+    if (!serveOptions.agent.isEmpty()) {
+        agent.reset(new AgentServer(backend, count));
+        agent->setInsecure(serveOptions.agentInsecure);
+        QString error;
+        if (!agent->listen(serveOptions.agent, &error)) {
+            qWarning("Cannot serve agent requests: %s", qPrintable(error));
+            qDeleteAll(governors);
+            return 1;
+        }
+        agent->setEnforcedFields(enforced);
+        agent->setApplyFunction([backend](int gpu, const GpuSettings &settings, int fields) {
+            return timedApply(backend, gpu, settings, fields);
+        });
+        agent->setAppliedHandler([&](int gpu, const GpuSettings &settings, int fields, const ApplyResult &result) {
+            remoteApplied = true;
+            if (metrics)
+                metrics->setSettings(gpu, settings, fields & ~result.failedFields);
+            // Only what the client sent moves the target
+            GpuSettings &held = target[gpu];
+            if (fields & ApplyPowerLimit)
+                held.powerLimit = settings.powerLimit;
+            if (fields & ApplyMemoryOffset)
+                held.memoryOffset = settings.memoryOffset;
+            if (fields & ApplyCoreOffset)
+                held.coreOffset = settings.coreOffset;
+            if (fields & ApplyGraphicsLock) {
+                held.graphicsLockMin = settings.graphicsLockMin;
+                held.graphicsLockMax = settings.graphicsLockMax;
+            }
+            if (fields & ApplyMemoryLock) {
+                held.memoryLockMin = settings.memoryLockMin;
+                held.memoryLockMax = settings.memoryLockMax;
+            }
+            if (drift)
+                drift->setTarget(target, enforced);
+        });
+        qInfo("Serving agent requests on %s", qPrintable(agent->description()));
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    QScopedPointer<TelemetryRecorder> recorder;
+    if (serveOptions.record)
+        recorder.reset(new TelemetryRecorder);
+
+    QScopedPointer<TelemetrySampler> sampler;
+    if (!governors.isEmpty() || serveOptions.metrics || recorder || agent) {
+        sampler.reset(new TelemetrySampler(backend, count, intervalMs));
+        sampler->start();
+    }
+
+    // Writes run on the thread pool, as the drift monitor's checks do, so a
+    // slow driver never holds up sampling, /metrics or agent clients. One
+    // write per GPU is in flight; the newest limit the governor asked for
+    // meanwhile goes next, and likewise the newest profile switch.
+    struct LimitWrite {
+        int limit = -1;
+        double temperature = 0;     // Filtered, for the log
+    };
+    QMap<int, QFutureWatcher<ApplyResult> *> limitWrites;
+    QMap<int, LimitWrite> limitsWritten;
+    QMap<int, LimitWrite> limitsQueued;
+    std::function<void(int, const LimitWrite &)> writeLimit = [&](int gpu, const LimitWrite &wanted) {
+        QFutureWatcher<ApplyResult> *writer = limitWrites.value(gpu);
+        if (writer->isRunning()) {
+            limitsQueued[gpu] = wanted;
+            return;
+        }
+        limitsWritten[gpu] = wanted;
+        GpuSettings settings;
+        settings.powerLimit = wanted.limit;
+        writer->setFuture(QtConcurrent::run([backend, gpu, settings]() {
+            return timedApply(backend, gpu, settings, ApplyPowerLimit);
+        }));
+    };
+    for (auto it = governors.constBegin(); it != governors.constEnd(); ++it) {
+        int gpu = it.key();
+        auto *writer = new QFutureWatcher<ApplyResult>;
+        limitWrites.insert(gpu, writer);
+        QObject::connect(writer, &QFutureWatcherBase::finished, [&, gpu, writer]() {
+            ApplyResult result = writer->result();
+            LimitWrite written = limitsWritten.value(gpu);
+            GpuSettings settings;
+            settings.powerLimit = written.limit;
+            if (metrics && result.ok())
+                metrics->setSettings(gpu, settings, ApplyPowerLimit);
+            if (result.ok())
+                qInfo("GPU %d: %.1f °C, power limit %d W", gpu, written.temperature, written.limit);
+            else
+                qWarning("GPU %d: %s", gpu, qPrintable(result.errors.join("; ")));
+            if (limitsQueued.contains(gpu))
+                writeLimit(gpu, limitsQueued.take(gpu));
+        });
+    }
+
+    QFutureWatcher<QVector<ApplyResult>> profileWrite;
+    QVector<Pending> profileWriting;
+    QVector<Pending> profileQueued;
+    bool profileIsQueued = false;
+    auto writeProfile = [&](const QVector<Pending> &pending) {
+        if (profileWrite.isRunning()) {
+            profileQueued = pending;
+            profileIsQueued = true;
+            return;
+        }
+        profileWriting = pending;
+        profileWrite.setFuture(QtConcurrent::run([backend, pending]() { return applyEach(backend, pending); }));
+    };
+    QObject::connect(&profileWrite, &QFutureWatcherBase::finished, [&]() {
+        keepFailed(&profileWriting, profileWrite.result());
+        warnFailed(profileWriting);
+        if (profileIsQueued) {
+            profileIsQueued = false;
+            writeProfile(profileQueued);
+        }
+    });
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 nextScanMs = 0;
+    QEventLoop loop;
+    QTimer tick;
+    QObject::connect(&tick, &QTimer::timeout, [&]() {
+        if (stopRequested) {
+            loop.quit();
+            return;
+        }
+
+        // /proc is scanned once a second whatever the sample rate is
+        if (watcher && clock.elapsed() >= nextScanMs) {
+            nextScanMs = clock.elapsed() + 1000;
+            if (watcher->poll(clock.elapsed())) {
+                QString profile = watcher->activeProfile();
+                qInfo("Switching to %s: %s", profile.isEmpty() ? "saved settings" : qPrintable("profile " + profile),
+                      qPrintable(watcher->reason()));
+                if (!profile.isEmpty() && !QFile::exists(GpuConfig::path(profile))) {
+                    qWarning("Profile %s does not exist", qPrintable(profile));
+                } else {
+                    GpuConfig active = profile.isEmpty() ? config : GpuConfig::load(GpuConfig::path(profile));
+                    writeProfile(profileWrites(active, count, !governors.isEmpty()));
+                    // Moved now, so a drift check cannot put the old profile back
+                    target = active.gpus;
+                    if (drift)
+                        drift->setTarget(target, enforced);
+                }
+            }
+        }
+
+        if (!sampler)
+            return;
+        if (metrics)
+            metrics->setDroppedSamples(sampler->droppedSamples());
+        TelemetrySample sample;
+        while (sampler->samples().pop(&sample)) {
+            if (metrics)
+                metrics->addSample(sample);
+            if (recorder)
+                recorder->append(sample);
+            if (agent)
+                agent->addSample(sample);
+            PowerGovernor *governor = governors.value(sample.gpu);
+            int limit = governor ? governor->update(sample) : -1;
+            if (limit < 0)
+                continue;
+            LimitWrite wanted;
+            wanted.limit = limit;
+            wanted.temperature = governor->filteredTemperature();
+            writeLimit(sample.gpu, wanted);
+        }
+    });
+    tick.start(sampler ? qMax(100, intervalMs / 2) : 1000);
+    loop.exec();
+    if (sampler)
+        sampler->stop();
+    // The writes hold the backend; what was still queued is dropped, the
+    // saved settings go back on below anyway
+    profileWrite.waitForFinished();
+    for (QFutureWatcher<ApplyResult> *writer : limitWrites)
+        writer->waitForFinished();
+    qDeleteAll(limitWrites);
+    if (drift)
+        qInfo("Re-applied drifted settings %llu times", drift->driftEvents());
+    qDeleteAll(governors);
+    agent.reset();
+
+    if (governorOptions || remoteApplied || (watcher && !watcher->activeProfile().isEmpty()))
+        applyProfile(backend, config, count, false);
+    return 0;
+}
+
+}
+
+namespace HeadlessApply {
+
+bool requested(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--apply") == 0 || strcmp(argv[i], "--agent") == 0
+            || strncmp(argv[i], "--agent=", 8) == 0)
+            return true;
+    }
+    return false;
+}
+
+int run(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("gpu-control");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Apply saved GPU settings without the GUI");
+    parser.addHelpOption();
+    QCommandLineOption applyOption("apply", "Apply saved settings and exit.");
+    QCommandLineOption profileOption("profile", "Apply profile <name> instead of the saved settings.", "name");
+    QCommandLineOption configOption("config", "Read settings from <file>.", "file");
+    QCommandLineOption backendOption("backend", "Use backend <name> (nvml, smi, amdgpu, mock).", "name");
+    QCommandLineOption timeoutOption("timeout", "Give up after <seconds>.", "seconds", "60");
+    QCommandLineOption traceOption("trace", "Write a Chrome trace of every operation to <file>.", "file");
+    QCommandLineOption governOption("govern",
+        "After applying, keep adjusting the power limit to hold <target> until stopped: "
+        "temp:<°C>, clock:<MHz> or no-throttle.", "target");
+    QCommandLineOption intervalOption("interval", "Sample every <ms> while governing.", "ms", "1000");
+    QCommandLineOption metricsOption("metrics",
+        QString("After applying, serve Prometheus metrics on <address> until stopped (e.g. %1).")
+            .arg(MetricsServer::defaultAddress()), "address");
+    QCommandLineOption recordOption("record",
+        "After applying, keep recording telemetry to the history the GUI replays, until stopped.");
+    QCommandLineOption reapplyOption("reapply",
+        "After applying, re-apply whatever suspend/resume, an X restart or a driver reload resets, until stopped.");
+    QCommandLineOption checkOption("check-interval",
+        "With --reapply, also read settings back every <seconds> (0: events only).", "seconds", "60");
+    QCommandLineOption watchOption("watch",
+        "After applying, keep switching profiles as running processes match the rule.NAME= lines "
+        "in the settings, until stopped.");
+    parser.addOption(applyOption);
+    parser.addOption(profileOption);
+    parser.addOption(configOption);
+    parser.addOption(backendOption);
+    parser.addOption(timeoutOption);
+    parser.addOption(traceOption);
+    parser.addOption(governOption);
+    parser.addOption(intervalOption);
+    parser.addOption(watchOption);
+    parser.addOption(metricsOption);
+    parser.addOption(recordOption);
+    parser.addOption(reapplyOption);
+    QCommandLineOption agentOption("agent",
+        QString("After applying, take remote queries, applies and telemetry subscriptions on <address> "
+                "(host:port or unix:/path, e.g. %1) until stopped; runs without saved settings too. "
+                "TCP requires GPU_CONTROL_AGENT_TOKEN.")
+            .arg(AgentProtocol::defaultAddress()), "address");
+    QCommandLineOption agentInsecureOption("agent-insecure",
+        "Let --agent serve TCP without GPU_CONTROL_AGENT_TOKEN, so anyone who can connect may apply settings.");
+    parser.addOption(checkOption);
+    parser.addOption(agentOption);
+    parser.addOption(agentInsecureOption);
+    parser.process(app);
+    installTraceExport(app.arguments());
+
+    GovernorOptions governorOptions;
+    if (parser.isSet(governOption) && !GovernorOptions::parse(parser.value(governOption), &governorOptions)) {
+        qWarning("Unknown governor target %s", qPrintable(parser.value(governOption)));
+        return 1;
+    }
+
+    QString file = parser.isSet(configOption)
+        ? parser.value(configOption)
+        : GpuConfig::path(parser.value(profileOption));
+    // An agent may only ever apply what its clients send
+    bool agentOnly = parser.isSet(agentOption) && !parser.isSet(profileOption) && !parser.isSet(configOption)
+        && !QFile::exists(file);
+    if (!QFile::exists(file) && !agentOnly) {
+        qWarning("No settings found at %s", qPrintable(file));
+        return 1;
+    }
+    GpuConfig config = agentOnly ? GpuConfig() : GpuConfig::load(file);
+    if (config.gpus.isEmpty() && !agentOnly) {
+        qWarning("%s has no GPU settings", qPrintable(file));
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QDeadlineTimer deadline(qMax(1, parser.value(timeoutOption).toInt()) * 1000);
+
+    int count = 0;
+    QScopedPointer<GpuBackend> backend(waitForDriver(parser.value(backendOption), deadline, &count));
+    if (!backend) {
+        qWarning("No GPU found after %lld ms", timer.elapsed());
+        return 1;
+    }
+    qInfo("Driver ready after %lld ms (backend: %s)", timer.elapsed(), qPrintable(backend->name()));
+
+    backend.reset(new TracingBackend(backend.take()));
+
+    // Started by hand as a regular user: let the helper do the writes
+    if (geteuid() != 0)
+        backend.reset(HelperBackend::wrapIfAvailable(backend.take()));
+
+    // Up before the apply so its writes show in the counters. Everything
+    // static is read once here; scrapes only ever see the cache.
+    QScopedPointer<MetricsServer> metricsServer;
+    if (parser.isSet(metricsOption)) {
+        metricsServer.reset(new MetricsServer);
+        QString error;
+        if (!metricsServer->listen(parser.value(metricsOption), &error)) {
+            qWarning("Cannot serve metrics: %s", qPrintable(error));
+            return 1;
+        }
+        for (int gpu = 0; gpu < count; ++gpu) {
+            GpuSnapshot snap = backend->snapshot(gpu);
+            metricsServer->setStaticInfo(gpu, snap.pciBusId, backend->staticInfo(gpu));
+            GpuSettings current;
+            current.powerLimit = snap.powerLimit;
+            current.memoryOffset = snap.memoryOffset;
+            current.coreOffset = snap.coreOffset;
+            metricsServer->setSettings(gpu, current, (snap.powerLimit > 0 ? ApplyPowerLimit : 0)
+                                       | (snap.memOffsetOk ? ApplyMemoryOffset : 0)
+                                       | (snap.coreOffsetOk ? ApplyCoreOffset : 0));
+        }
+        metrics = metricsServer.data();
+        qInfo("Serving metrics on http://%s:%d/metrics",
+              qPrintable(metricsServer->serverAddress().toString()), metricsServer->serverPort());
+    }
+
+    QVector<Pending> pending;
+    for (auto it = config.gpus.constBegin(); it != config.gpus.constEnd(); ++it) {
+        if (it.key() >= count) {
+            qWarning("Skipping GPU %d: only %d present", it.key(), count);
+            continue;
+        }
+        Pending entry;
+        entry.gpu = it.key();
+        entry.settings = *it;
+        entry.fields = fieldsFor(*it, false, false);
+        pending.append(entry);
+    }
+    int total = pending.size();
+
+    // Power limits land as soon as the driver is up. Offsets through
+    // nvidia-settings also need an X server, so whatever fails is retried
+    // with backoff until it sticks or the deadline passes. Without an X
+    // server, and no display manager to start one, there is no point
+    // waiting for offsets.
+    bool display = qEnvironmentVariableIsSet("DISPLAY") || useRunningDisplay();
+    bool displayExpected = display || QFile::exists("/etc/systemd/system/display-manager.service");
+    int backoffMs = 100;
+    forever {
+        applyAll(backend.data(), &pending);
+        if (!displayExpected) {
+            QVector<Pending> rest;
+            for (Pending entry : pending) {
+                if (entry.fields & (ApplyMemoryOffset | ApplyCoreOffset))
+                    qWarning("GPU %d: no X server and no display manager; not retrying clock offsets "
+                             "(NVML on 470+ drivers sets them without X)", entry.gpu);
+                entry.fields &= ~(ApplyMemoryOffset | ApplyCoreOffset);
+                if (entry.fields)
+                    rest.append(entry);
+            }
+            pending = rest;
+        }
+        if (pending.isEmpty() || deadline.hasExpired())
+            break;
+        waitFor(backoffMs, deadline, nullptr);
+        backoffMs = qMin(backoffMs * 2, 2000);
+        // The display manager may have brought X up in the meantime
+        if (!display)
+            display = useRunningDisplay();
+    }
+
+    for (const Pending &entry : pending) {
+        for (const QString &error : entry.errors)
+            qWarning("GPU %d: %s", entry.gpu, qPrintable(error));
+    }
+
+    double boot = secondsSinceBoot();
+    qInfo("Applied %d of %d GPUs in %lld ms (%.2f s after boot)",
+          total - pending.size(), total, timer.elapsed(), boot);
+
+    if (parser.isSet(governOption) || parser.isSet(watchOption) || parser.isSet(recordOption)
+        || parser.isSet(reapplyOption) || parser.isSet(agentOption) || !metricsServer.isNull()) {
+        ServeOptions options;
+        options.governor = parser.isSet(governOption) ? &governorOptions : nullptr;
+        options.watch = parser.isSet(watchOption);
+        options.metrics = !metricsServer.isNull();
+        options.record = parser.isSet(recordOption);
+        options.reapply = parser.isSet(reapplyOption);
+        options.agent = parser.value(agentOption);
+        options.agentInsecure = parser.isSet(agentInsecureOption);
+        options.driftCheckMs = qMax(0, parser.value(checkOption).toInt()) * 1000;
+        options.intervalMs = qMax(100, parser.value(intervalOption).toInt());
+        return serve(backend.data(), config, count, options);
+    }
+    return pending.isEmpty() ? 0 : 1;
+}
+
+}
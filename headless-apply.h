@@ -0,0 +1,22 @@
+#pragma once
+
+// `gpu-control --apply [--profile NAME | --config FILE]`: applies saved
+// settings without constructing any widgets, for the boot-time unit and
+// scripts. Waits for the driver to come up rather than sleeping a fixed time.
+// These keep it running afterwards, until SIGTERM:
+//   --govern    steer the power limit toward a temperature or clock target
+//   --watch     switch profiles as workloads start and stop
+//   --metrics   serve Prometheus metrics
+//   --record    keep the telemetry history
+//   --reapply   put back settings lost to suspend, X restarts or driver reloads
+//   --agent     take queries, applies and telemetry subscriptions from
+//               `gpu-control --remote` on other hosts
+namespace HeadlessApply {
+
+// True when the command line asks for a GUI-less run
+bool requested(int argc, char *argv[]);
+
+// Runs the whole apply and returns the process exit code
+int run(int argc, char *argv[]);
+
+}
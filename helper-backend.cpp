@@ -0,0 +1,181 @@
+#include "helper-backend.h"
+#include "helper-protocol.h"
+#include "tracer.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QLocalSocket>
+
+HelperBackend::HelperBackend(GpuBackend *local, const QString &socketPath)
+    : local(local), socketPath(socketPath) {
+}
+
+GpuBackend *HelperBackend::wrapIfAvailable(GpuBackend *local) {
+    QString path = HelperProtocol::socketPath();
+    if (!QFile::exists(path))
+        return local;
+
+    auto *helper = new HelperBackend(local, path);
+    QJsonObject ping;
+    ping["op"] = "ping";
+    QJsonObject response;
+    if (helper->request(ping, &response) == Answered && response["ok"].toBool())
+        return helper;
+
+    // Stale socket: hand the local backend back untouched
+    helper->local.take();
+    delete helper;
+    return local;
+}
+
+HelperBackend::Outcome HelperBackend::request(const QJsonObject &message, QJsonObject *response, QString *error) {
+    // A fresh connection per request keeps this usable from any thread;
+    // connecting to a local socket costs microseconds.
+    QByteArray line = HelperProtocol::encode(message);
+    TraceSpan span("helper " + message["op"].toString(), "helper", QString::fromUtf8(line).trimmed());
+    span.setExitCode(-1);
+
+    QLocalSocket socket;
+    socket.connectToServer(socketPath);
+    if (!socket.waitForConnected(1000)) {
+        if (error)
+            *error = "GPU Control helper is not running";
+        return Unreachable;
+    }
+
+    socket.write(line);
+    while (!socket.canReadLine()) {
+        if (!socket.waitForReadyRead(15000)) {
+            if (error)
+                *error = socket.state() == QLocalSocket::ConnectedState
+                    ? QString("No answer from gpu-control-helper within 15 s; the write may still be in progress")
+                    : QString("gpu-control-helper closed the connection");
+            return Lost;
+        }
+    }
+    QByteArray reply = socket.readLine();
+    span.setOutputBytes(reply.size());
+    if (!HelperProtocol::decode(reply, response)) {
+        if (error)
+            *error = "Malformed reply from gpu-control-helper";
+        return Lost;
+    }
+    span.setExitCode((*response)["ok"].toBool() ? 0 : 1);
+    return Answered;
+}
+
+bool HelperBackend::setPowerLimit(int gpu, int watts, QString *error) {
+    GpuSettings settings;
+    settings.powerLimit = watts;
+    ApplyResult result = apply(gpu, settings, ApplyPowerLimit);
+    if (!result.ok() && error)
+        *error = result.errors.join("; ");
+    return result.ok();
+}
+
+bool HelperBackend::setMemoryOffset(int gpu, int mhz, QString *error) {
+    GpuSettings settings;
+    settings.memoryOffset = mhz;
+    ApplyResult result = apply(gpu, settings, ApplyMemoryOffset);
+    if (!result.ok() && error)
+        *error = result.errors.join("; ");
+    return result.ok();
+}
+
+bool HelperBackend::setCoreOffset(int gpu, int mhz, QString *error) {
+    GpuSettings settings;
+    settings.coreOffset = mhz;
+    ApplyResult result = apply(gpu, settings, ApplyCoreOffset);
+    if (!result.ok() && error)
+        *error = result.errors.join("; ");
+    return result.ok();
+}
+
+bool HelperBackend::setGraphicsClockLock(int gpu, int min, int max, QString *error) {
+    GpuSettings settings;
+    settings.graphicsLockMin = min;
+    settings.graphicsLockMax = max;
+    ApplyResult result = apply(gpu, settings, ApplyGraphicsLock);
+    if (!result.ok() && error)
+        *error = result.errors.join("; ");
+    return result.ok();
+}
+
+bool HelperBackend::setMemoryClockLock(int gpu, int min, int max, QString *error) {
+    GpuSettings settings;
+    settings.memoryLockMin = min;
+    settings.memoryLockMax = max;
+    ApplyResult result = apply(gpu, settings, ApplyMemoryLock);
+    if (!result.ok() && error)
+        *error = result.errors.join("; ");
+    return result.ok();
+}
+
+ApplyResult HelperBackend::apply(int gpu, const GpuSettings &settings, int fields) {
+    QJsonObject message;
+    message["op"] = "apply";
+    message["gpu"] = gpu;
+    message["fields"] = fields;
+    message["power"] = settings.powerLimit;
+    message["memory"] = settings.memoryOffset;
+    message["core"] = settings.coreOffset;
+    if (fields & ApplyGraphicsLock)
+        message["lock_graphics"] = QJsonArray{settings.graphicsLockMin, settings.graphicsLockMax};
+    if (fields & ApplyMemoryLock)
+        message["lock_memory"] = QJsonArray{settings.memoryLockMin, settings.memoryLockMax};
+
+    QJsonObject response;
+    QString error;
+    Outcome outcome = request(message, &response, &error);
+    if (outcome == Unreachable)
+        return local->apply(gpu, settings, fields);
+
+    ApplyResult result;
+    if (outcome == Lost) {
+        result.failedFields = fields;
+        result.errors << error;
+        return result;
+    }
+    if (!response["ok"].toBool()) {
+        result.failedFields = response["failed"].toInt(fields);
+        for (const QJsonValue &error : response["errors"].toArray())
+            result.errors << error.toString();
+    }
+    return result;
+}
+
+bool HelperBackend::installStartupService(const QMap<int, GpuSettings> &gpus, QString *error) {
+    QJsonArray entries;
+    for (auto it = gpus.constBegin(); it != gpus.constEnd(); ++it) {
+        QJsonObject entry;
+        entry["gpu"] = it.key();
+        entry["power"] = it->powerLimit;
+        entry["memory"] = it->memoryOffset;
+        entry["core"] = it->coreOffset;
+        entry["lock_graphics"] = QJsonArray{it->graphicsLockMin, it->graphicsLockMax};
+        entry["lock_memory"] = QJsonArray{it->memoryLockMin, it->memoryLockMax};
+        entries.append(entry);
+    }
+    QJsonObject message;
+    message["op"] = "install_unit";
+    message["gpus"] = entries;
+
+    QJsonObject response;
+    if (request(message, &response, error) != Answered)
+        return false;
+    if (!response["ok"].toBool() && error)
+        *error = response["errors"].toArray().at(0).toString();
+    return response["ok"].toBool();
+}
+
+bool HelperBackend::removeStartupService(QString *error) {
+    QJsonObject message;
+    message["op"] = "remove_unit";
+
+    QJsonObject response;
+    if (request(message, &response, error) != Answered)
+        return false;
+    if (!response["ok"].toBool() && error)
+        *error = response["errors"].toArray().at(0).toString();
+    return response["ok"].toBool();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QJsonObject>
+#include <QMap>
+#include <QScopedPointer>
+
+// Forwards reads to a local backend and sends writes to gpu-control-helper,
+// so an apply is one socket round trip instead of sudo + fork + exec. When
+// the helper cannot be reached, writes fall back to the local backend; a
+// request the helper took but did not answer is reported as failed, never
+// written a second time.
+class HelperBackend : public GpuBackend {
+public:
+    HelperBackend(GpuBackend *local, const QString &socketPath);
+
+    // Wraps local in a HelperBackend when a helper answers on the socket;
+    // otherwise returns local unchanged.
+    static GpuBackend *wrapIfAvailable(GpuBackend *local);
+
+    // Startup unit management through the helper
+    bool installStartupService(const QMap<int, GpuSettings> &gpus, QString *error);
+    bool removeStartupService(QString *error);
+
+    QString name() const override { return local->name() + "+helper"; }
+    int deviceCount() override { return local->deviceCount(); }
+
+    QString pciBusId(int gpu) override { return local->pciBusId(gpu); }
+    QString driverVersion() override { return local->driverVersion(); }
+    QString gpuName(int gpu) override { return local->gpuName(gpu); }
+    int minPowerLimit(int gpu) override { return local->minPowerLimit(gpu); }
+    int maxPowerLimit(int gpu) override { return local->maxPowerLimit(gpu); }
+    int defaultPowerLimit(int gpu) override { return local->defaultPowerLimit(gpu); }
+    int powerLimit(int gpu) override { return local->powerLimit(gpu); }
+    int memoryClock(int gpu) override { return local->memoryClock(gpu); }
+    int graphicsClock(int gpu) override { return local->graphicsClock(gpu); }
+    bool memoryOffset(int gpu, int *mhz) override { return local->memoryOffset(gpu, mhz); }
+    bool coreOffset(int gpu, int *mhz) override { return local->coreOffset(gpu, mhz); }
+    bool memoryOffsetRange(int gpu, int *min, int *max) override { return local->memoryOffsetRange(gpu, min, max); }
+    bool coreOffsetRange(int gpu, int *min, int *max) override { return local->coreOffsetRange(gpu, min, max); }
+    bool supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) override { return local->supportedClocks(gpu, memory, graphics); }
+    GpuSnapshot snapshot(int gpu) override { return local->snapshot(gpu); }
+    GpuStaticInfo staticInfo(int gpu) override { return local->staticInfo(gpu); }
+    bool sample(int gpu, TelemetrySample *out) override { return local->sample(gpu, out); }
+
+    bool setPowerLimit(int gpu, int watts, QString *error) override;
+    bool setMemoryOffset(int gpu, int mhz, QString *error) override;
+    bool setCoreOffset(int gpu, int mhz, QString *error) override;
+    bool setGraphicsClockLock(int gpu, int min, int max, QString *error) override;
+    bool setMemoryClockLock(int gpu, int min, int max, QString *error) override;
+    ApplyResult apply(int gpu, const GpuSettings &settings, int fields) override;
+
+private:
+    enum Outcome {
+        Answered,
+        Unreachable,    // Nothing was sent; safe to do the write some other way
+        Lost,           // Sent but not answered; the helper may still be writing
+    };
+
+    // Sends one request and waits for its response
+    Outcome request(const QJsonObject &message, QJsonObject *response, QString *error = nullptr);
+
+    QScopedPointer<GpuBackend> local;
+    QString socketPath;
+};
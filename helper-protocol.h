@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+
+// Wire format between the GUI and gpu-control-helper: one compact JSON
+// object per line. Requests carry an "op"; responses carry "ok" and, on
+// failure, "errors" plus a "failed" ApplyField mask.
+//
+//   {"op":"ping"}
+//   {"op":"set_power_limit","gpu":0,"watts":300}
+//   {"op":"set_offsets","gpu":0,"memory":1000,"core":100}   (either optional)
+//   {"op":"apply","gpu":0,"fields":31,"power":300,"memory":1000,"core":100,
+//    "lock_graphics":[1500,1800],"lock_memory":[0,0]}         (locks: min, max MHz)
+//   {"op":"install_unit","gpus":[{"gpu":0,"power":300,"memory":1000,"core":100,
+//    "lock_graphics":[1500,1800],"lock_memory":[0,0]}]}
+//   {"op":"remove_unit"}
+namespace HelperProtocol {
+
+inline QString socketPath() {
+    QString path = qEnvironmentVariable("GPU_CONTROL_HELPER_SOCKET");
+    return path.isEmpty() ? QString("/run/gpu-control/helper.sock") : path;
+}
+
+inline QByteArray encode(const QJsonObject &message) {
+    return QJsonDocument(message).toJson(QJsonDocument::Compact) + '\n';
+}
+
+inline bool decode(const QByteArray &line, QJsonObject *message) {
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject())
+        return false;
+    *message = doc.object();
+    return true;
+}
+
+}
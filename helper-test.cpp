@@ -0,0 +1,172 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QVector>
+
+#include <cstdio>
+
+#include "helper-backend.h"
+#include "helper-protocol.h"
+#include "mock-backend.h"
+
+// gpu-control-helper (path in argv[1]) on a private socket over its own
+// two-GPU mock backend, driven through HelperBackend as the GUI drives it
+// and with raw protocol lines. Checks that writes go to the helper and not
+// the local backend, that the helper's limits refuse out-of-range values
+// (startup units included, before anything is written), and that writes
+// fall back to the local backend once the helper is gone. Exits non-zero
+// when a check fails.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *name, const QString &detail) {
+    if (ok)
+        return;
+    ++failures;
+    fprintf(stderr, "FAIL %s: %s\n", name, qPrintable(detail));
+}
+
+// Sends lines as one write and reads back one response per line
+QVector<QJsonObject> exchange(const QString &path, const QByteArray &lines, int expected) {
+    QVector<QJsonObject> responses;
+    QLocalSocket socket;
+    socket.connectToServer(path);
+    if (!socket.waitForConnected(1000))
+        return responses;
+    socket.write(lines);
+    while (responses.size() < expected) {
+        if (!socket.canReadLine() && !socket.waitForReadyRead(5000))
+            break;
+        while (socket.canReadLine()) {
+            QJsonObject response;
+            HelperProtocol::decode(socket.readLine(), &response);
+            responses.append(response);
+        }
+    }
+    return responses;
+}
+
+void writesGoToHelper(GpuBackend *backend) {
+    GpuSettings settings;
+    settings.powerLimit = 300;
+    settings.memoryOffset = 500;
+    ApplyResult result = backend->apply(0, settings, ApplyPowerLimit | ApplyMemoryOffset);
+    check(result.ok(), "apply", result.errors.join("; "));
+    // Reads come from the local backend, which the write never touched
+    check(backend->powerLimit(0) == 350, "apply", QString("local backend now at %1 W").arg(backend->powerLimit(0)));
+
+    GpuSettings locks;
+    locks.graphicsLockMin = 1500;
+    locks.graphicsLockMax = 1800;
+    result = backend->apply(1, locks, ApplyGraphicsLock);
+    check(result.ok(), "lock", result.errors.join("; "));
+}
+
+void limitsRefuse(HelperBackend *backend) {
+    GpuSettings settings;
+    settings.powerLimit = 9999;
+    ApplyResult result = backend->apply(0, settings, ApplyPowerLimit);
+    check(result.failedFields == ApplyPowerLimit && result.errors.value(0).contains("outside"), "power range",
+          QString("failed 0x%1: %2").arg(result.failedFields, 0, 16).arg(result.errors.join("; ")));
+
+    QString error;
+    check(!backend->setCoreOffset(0, 5000, &error) && error.contains("outside"), "core range", error);
+    check(!backend->setPowerLimit(5, 300, &error) && error.contains("No such GPU"), "no such GPU", error);
+
+    GpuSettings inverted;
+    inverted.memoryLockMin = 2000;
+    inverted.memoryLockMax = 1000;
+    result = backend->apply(0, inverted, ApplyMemoryLock);
+    check(!result.ok(), "inverted lock", "a 2000..1000 MHz lock was accepted");
+
+    // Validated before StartupService touches /etc or systemctl
+    QMap<int, GpuSettings> gpus;
+    gpus[0] = settings;
+    check(!backend->installStartupService(gpus, &error) && error.contains("outside"), "startup unit range", error);
+}
+
+void rawLines(const QString &path) {
+    QJsonObject unknown;
+    unknown["op"] = "bogus";
+    unknown["id"] = 7;
+    QJsonObject ping;
+    ping["op"] = "ping";
+    QVector<QJsonObject> responses = exchange(path, "not json\n" + HelperProtocol::encode(unknown)
+                                              + HelperProtocol::encode(ping), 3);
+    check(responses.size() == 3, "raw lines", QString("%1 of 3 responses").arg(responses.size()));
+    if (responses.size() != 3)
+        return;
+    check(!responses[0]["ok"].toBool() && responses[0]["errors"].toArray().at(0).toString() == "Malformed request",
+          "malformed", responses[0]["errors"].toArray().at(0).toString());
+    check(!responses[1]["ok"].toBool() && responses[1]["id"].toInt() == 7
+          && responses[1]["errors"].toArray().at(0).toString().startsWith("Unknown op"),
+          "unknown op", responses[1]["errors"].toArray().at(0).toString());
+    check(responses[2]["ok"].toBool() && responses[2]["backend"].toString() == "mock", "ping",
+          responses[2]["backend"].toString());
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    if (argc < 2) {
+        fprintf(stderr, "Usage: helper-test <gpu-control-helper>\n");
+        return 2;
+    }
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        fprintf(stderr, "No temporary directory\n");
+        return 1;
+    }
+    QString path = dir.filePath("helper.sock");
+    qputenv("GPU_CONTROL_MOCK_GPUS", "2");
+    qunsetenv("GPU_CONTROL_MOCK_LATENCY_MS");
+    qunsetenv("GPU_CONTROL_MOCK_RESET_MS");
+    qputenv("GPU_CONTROL_HELPER_SOCKET", path.toLocal8Bit());
+
+    QProcess helper;
+    helper.setProcessChannelMode(QProcess::ForwardedChannels);
+    helper.start(QString::fromLocal8Bit(argv[1]), QStringList() << "--socket" << path << "--group" << ""
+                 << "--backend" << "mock");
+    QElapsedTimer timer;
+    timer.start();
+    while (!QFile::exists(path) && timer.elapsed() < 5000 && helper.state() != QProcess::NotRunning)
+        QThread::msleep(10);
+    if (!QFile::exists(path)) {
+        fprintf(stderr, "gpu-control-helper did not listen on %s\n", qPrintable(path));
+        return 1;
+    }
+
+    QScopedPointer<GpuBackend> backend(HelperBackend::wrapIfAvailable(new MockBackend));
+    auto *wrapped = dynamic_cast<HelperBackend *>(backend.data());
+    check(wrapped && backend->name() == "mock+helper", "wrap", backend->name());
+    if (wrapped) {
+        writesGoToHelper(wrapped);
+        limitsRefuse(wrapped);
+        rawLines(path);
+
+        // Nothing was sent, so the local backend takes the write
+        helper.kill();
+        helper.waitForFinished(2000);
+        GpuSettings settings;
+        settings.powerLimit = 280;
+        ApplyResult result = wrapped->apply(0, settings, ApplyPowerLimit);
+        check(result.ok() && wrapped->powerLimit(0) == 280, "fallback",
+              QString("local backend at %1 W: %2").arg(wrapped->powerLimit(0)).arg(result.errors.join("; ")));
+    }
+
+    helper.kill();
+    helper.waitForFinished(2000);
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QScopedPointer>
+
+#include <grp.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gpu-backend.h"
+#include "helper-protocol.h"
+#include "startup-service.h"
+
+// Root-side half of GPU Control. Holds one backend (and with it the NVML
+// handle) for its whole lifetime and accepts a small, typed set of write
+// requests from the GUI over a Unix-domain socket.
+class HelperServer {
+public:
+    explicit HelperServer(GpuBackend *backend) : backend(backend) {
+        QObject::connect(&server, &QLocalServer::newConnection, [this]() {
+            while (QLocalSocket *socket = server.nextPendingConnection()) {
+                QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+                QObject::connect(socket, &QLocalSocket::readyRead, [this, socket]() { serve(socket); });
+            }
+        });
+    }
+
+    bool listen(const QString &path, const QString &group) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QLocalServer::removeServer(path);
+        if (!server.listen(path)) {
+            qWarning("Cannot listen on %s: %s", qPrintable(path), qPrintable(server.errorString()));
+            return false;
+        }
+
+        // Only root and members of the group may talk to the helper
+        mode_t mode = S_IRUSR | S_IWUSR;
+        if (!group.isEmpty()) {
+            if (struct group *gr = getgrnam(group.toLocal8Bit().constData())) {
+                if (chown(path.toLocal8Bit().constData(), (uid_t)-1, gr->gr_gid) == 0)
+                    mode |= S_IRGRP | S_IWGRP;
+            } else {
+                qWarning("Group %s not found; socket is owner-only", qPrintable(group));
+            }
+        }
+        chmod(path.toLocal8Bit().constData(), mode);
+        qInfo("Listening on %s (backend: %s)", qPrintable(path), qPrintable(backend->name()));
+        return true;
+    }
+
+private:
+    void serve(QLocalSocket *socket) {
+        while (socket->canReadLine()) {
+            QJsonObject request;
+            QJsonObject response;
+            if (!HelperProtocol::decode(socket->readLine(), &request)) {
+                response = failure(QStringList() << "Malformed request");
+            } else {
+                response = handle(request);
+                if (request.contains("id"))
+                    response["id"] = request["id"];
+            }
+            socket->write(HelperProtocol::encode(response));
+        }
+    }
+
+    static QJsonObject failure(const QStringList &errors, int failed = ApplyAll) {
+        QJsonObject response;
+        response["ok"] = false;
+        response["failed"] = failed;
+        response["errors"] = QJsonArray::fromStringList(errors);
+        return response;
+    }
+
+    static QJsonObject result(const ApplyResult &result) {
+        if (!result.ok())
+            return failure(result.errors, result.failedFields);
+        QJsonObject response;
+        response["ok"] = true;
+        return response;
+    }
+
+    // Rejects anything outside what the driver reports as valid before it
+    // gets anywhere near the hardware.
+    QString validate(int gpu, const GpuSettings &settings, int fields) {
+        if (gpu < 0 || gpu >= backend->deviceCount())
+            return QString("No such GPU: %1").arg(gpu);
+        if (fields & ApplyPowerLimit) {
+            int min = backend->minPowerLimit(gpu);
+            int max = backend->maxPowerLimit(gpu);
+            if ((min > 0 && settings.powerLimit < min) || (max > 0 && settings.powerLimit > max))
+                return QString("Power limit %1 W is outside %2..%3 W").arg(settings.powerLimit).arg(min).arg(max);
+        }
+        int min = 0, max = 0;
+        if ((fields & ApplyMemoryOffset) && backend->memoryOffsetRange(gpu, &min, &max)
+            && (settings.memoryOffset < min || settings.memoryOffset > max))
+            return QString("Memory offset %1 is outside %2..%3").arg(settings.memoryOffset).arg(min).arg(max);
+        if ((fields & ApplyCoreOffset) && backend->coreOffsetRange(gpu, &min, &max)
+            && (settings.coreOffset < min || settings.coreOffset > max))
+            return QString("Core offset %1 is outside %2..%3").arg(settings.coreOffset).arg(min).arg(max);
+        if ((fields & ApplyGraphicsLock) && !validLock(settings.graphicsLockMin, settings.graphicsLockMax))
+            return QString("Invalid graphics clock lock %1..%2").arg(settings.graphicsLockMin).arg(settings.graphicsLockMax);
+        if ((fields & ApplyMemoryLock) && !validLock(settings.memoryLockMin, settings.memoryLockMax))
+            return QString("Invalid memory clock lock %1..%2").arg(settings.memoryLockMin).arg(settings.memoryLockMax);
+        return QString();
+    }
+
+    // 0, 0 unlocks; the driver rounds anything else to supported clocks
+    static bool validLock(int min, int max) {
+        return (min == 0 && max == 0) || (min > 0 && min <= max);
+    }
+
+    static void readSettings(const QJsonObject &message, GpuSettings *settings) {
+        settings->powerLimit = message["power"].toInt(message["watts"].toInt());
+        settings->memoryOffset = message["memory"].toInt();
+        settings->coreOffset = message["core"].toInt();
+        QJsonArray graphicsLock = message["lock_graphics"].toArray();
+        settings->graphicsLockMin = graphicsLock.at(0).toInt();
+        settings->graphicsLockMax = graphicsLock.at(1).toInt();
+        QJsonArray memoryLock = message["lock_memory"].toArray();
+        settings->memoryLockMin = memoryLock.at(0).toInt();
+        settings->memoryLockMax = memoryLock.at(1).toInt();
+    }
+
+    QJsonObject applyChecked(int gpu, const GpuSettings &settings, int fields) {
+        QString error = validate(gpu, settings, fields);
+        if (!error.isEmpty())
+            return failure(QStringList() << error, fields);
+        return result(backend->apply(gpu, settings, fields));
+    }
+
+    QJsonObject handle(const QJsonObject &request) {
+        QString op = request["op"].toString();
+        int gpu = request["gpu"].toInt(0);
+        GpuSettings settings;
+        readSettings(request, &settings);
+
+        if (op == "ping") {
+            QJsonObject response;
+            response["ok"] = true;
+            response["backend"] = backend->name();
+            return response;
+        }
+        if (op == "set_power_limit")
+            return applyChecked(gpu, settings, ApplyPowerLimit);
+        if (op == "set_offsets") {
+            int fields = (request.contains("memory") ? ApplyMemoryOffset : 0)
+                | (request.contains("core") ? ApplyCoreOffset : 0);
+            return applyChecked(gpu, settings, fields);
+        }
+        if (op == "apply")
+            return applyChecked(gpu, settings, request["fields"].toInt() & ApplyAll);
+        if (op == "install_unit" || op == "remove_unit") {
+            QMap<int, GpuSettings> gpus;
+            for (const QJsonValue &value : request["gpus"].toArray()) {
+                QJsonObject entry = value.toObject();
+                readSettings(entry, &gpus[entry["gpu"].toInt()]);
+            }
+            // The unit applies these as root at every boot; hold them to
+            // the same limits as a live apply. A power limit of 0 is left
+            // alone at boot, so there is nothing to check.
+            for (auto it = gpus.constBegin(); op == "install_unit" && it != gpus.constEnd(); ++it) {
+                int fields = it->powerLimit > 0 ? ApplyAll : ApplyAll & ~ApplyPowerLimit;
+                QString error = validate(it.key(), *it, fields);
+                if (!error.isEmpty())
+                    return failure(QStringList() << QString("GPU %1: %2").arg(it.key()).arg(error), 0);
+            }
+
+            QString error;
+            bool ok = op == "install_unit"
+                ? StartupService::install(gpus, &error)
+                : StartupService::remove(&error);
+            return ok ? result(ApplyResult()) : failure(QStringList() << error, 0);
+        }
+        return failure(QStringList() << "Unknown op: " + op, 0);
+    }
+
+    GpuBackend *backend;
+    QLocalServer server;
+};
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("gpu-control-helper");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Privileged helper for GPU Control");
+    parser.addHelpOption();
+    QCommandLineOption socketOption("socket", "Listen on <path>.", "path", HelperProtocol::socketPath());
+    QCommandLineOption groupOption("group", "Allow members of <group> to connect.", "group", "gpu-control");
+    QCommandLineOption backendOption("backend", "Use backend <name> (nvml, smi, amdgpu, mock).", "name");
+    parser.addOption(socketOption);
+    parser.addOption(groupOption);
+    parser.addOption(backendOption);
+    parser.process(app);
+
+    QScopedPointer<GpuBackend> backend(GpuBackend::create(parser.value(backendOption)));
+    HelperServer server(backend.data());
+    if (!server.listen(parser.value(socketOption), parser.value(groupOption)))
+        return 1;
+    return app.exec();
+}
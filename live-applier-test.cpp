@@ -0,0 +1,139 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QString>
+#include <QThread>
+
+#include <cstdio>
+#include <functional>
+
+#include "live-applier.h"
+#include "mock-backend.h"
+
+// LiveApplier on the mock backend with a 50 ms quiet period, fed the way
+// GpuPanel feeds it: a memory offset slider dragged from 0 to +2000 MHz,
+// and a power limit the backend refuses followed by one it takes while the
+// refused write is still running. Exits non-zero when a check fails.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *name, const QString &detail) {
+    if (ok)
+        return;
+    ++failures;
+    fprintf(stderr, "FAIL %s: %s\n", name, qPrintable(detail));
+}
+
+bool waitUntil(const std::function<bool()> &done, int timeoutMs) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!done() && timer.elapsed() < timeoutMs) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        QThread::msleep(1);
+    }
+    return done();
+}
+
+void settle(int ms) {
+    waitUntil([]() { return false; }, ms);
+}
+
+// Stands in for GpuPanel: the controls, and what was last written from them
+struct Panel {
+    GpuSettings settings;
+    GpuSettings applied;
+
+    Panel() {
+        settings.powerLimit = applied.powerLimit = 350;
+    }
+
+    int changedFields(const GpuSettings &target) const {
+        int fields = 0;
+        if (target.powerLimit != applied.powerLimit)
+            fields |= ApplyPowerLimit;
+        if (target.memoryOffset != applied.memoryOffset)
+            fields |= ApplyMemoryOffset;
+        return fields;
+    }
+
+    void attach(LiveApplier *live) {
+        live->setSource([this]() { return settings; },
+                        [this](const GpuSettings &target) { return changedFields(target); });
+        live->setWrittenHandler([this](const GpuSettings &target, int fields, const ApplyResult &result, qint64) {
+            int written = fields & ~result.failedFields;
+            if (written & ApplyPowerLimit)
+                applied.powerLimit = target.powerLimit;
+            if (written & ApplyMemoryOffset)
+                applied.memoryOffset = target.memoryOffset;
+        });
+        live->setEnabled(true);
+    }
+};
+
+// A hundred edits end up as a handful of writes, the last one exact
+void drag() {
+    MockBackend mock;
+    LiveApplier live(&mock, 0);
+    Panel panel;
+    panel.attach(&live);
+
+    for (int mhz = 20; mhz <= 2000; mhz += 20) {
+        panel.settings.memoryOffset = mhz;
+        live.edited(ApplyMemoryOffset);
+        settle(10);
+    }
+    waitUntil([&]() { return panel.applied.memoryOffset == 2000; }, 5000);
+    settle(200);
+
+    int memory = 0;
+    mock.memoryOffset(0, &memory);
+    check(memory == 2000, "drag", QString("memory offset ended at %1").arg(memory));
+    check(live.writeCount() >= 1 && live.writeCount() <= 5, "drag",
+          QString("%1 writes for 100 edits").arg(live.writeCount()));
+}
+
+// An edit made while a refused write runs is still written; the refused
+// value itself is not written again until it is edited again
+void afterFailure() {
+    qputenv("GPU_CONTROL_MOCK_LATENCY_MS", "200");
+    MockBackend mock;
+    qunsetenv("GPU_CONTROL_MOCK_LATENCY_MS");
+    LiveApplier live(&mock, 0);
+    Panel panel;
+    panel.attach(&live);
+
+    panel.settings.powerLimit = 9999;
+    live.edited(ApplyPowerLimit);
+    settle(100);
+    panel.settings.powerLimit = 300;
+    live.edited(ApplyPowerLimit);
+    bool written = waitUntil([&]() { return panel.applied.powerLimit == 300; }, 5000);
+    check(written && mock.powerLimit(0) == 300, "after failure",
+          QString("GPU at %1 W after the refused write").arg(mock.powerLimit(0)));
+    check(live.writeCount() == 2, "after failure", QString("%1 writes").arg(live.writeCount()));
+
+    panel.settings.powerLimit = 9999;
+    live.edited(ApplyPowerLimit);
+    settle(1000);
+    check(live.writeCount() == 3, "no retry", QString("%1 writes, the refused value was retried")
+          .arg(live.writeCount()));
+    check(mock.powerLimit(0) == 300, "no retry", QString("GPU at %1 W").arg(mock.powerLimit(0)));
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    qputenv("GPU_CONTROL_MOCK_GPUS", "1");
+    qunsetenv("GPU_CONTROL_MOCK_LATENCY_MS");
+    qunsetenv("GPU_CONTROL_MOCK_RESET_MS");
+    qputenv("GPU_CONTROL_LIVE_QUIET_MS", "50");
+    QCoreApplication app(argc, argv);
+
+    drag();
+    afterFailure();
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+#include "live-applier.h"
+
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QtConcurrent>
+
+namespace {
+
+// Whether a and b agree on what field writes
+bool sameValue(int field, const GpuSettings &a, const GpuSettings &b) {
+    switch (field) {
+    case ApplyPowerLimit:
+        return a.powerLimit == b.powerLimit;
+    case ApplyMemoryOffset:
+        return a.memoryOffset == b.memoryOffset;
+    case ApplyCoreOffset:
+        return a.coreOffset == b.coreOffset;
+    case ApplyGraphicsLock:
+        return a.graphicsLockMin == b.graphicsLockMin && a.graphicsLockMax == b.graphicsLockMax;
+    case ApplyMemoryLock:
+        return a.memoryLockMin == b.memoryLockMin && a.memoryLockMax == b.memoryLockMax;
+    }
+    return false;
+}
+
+}
+
+LiveApplier::LiveApplier(GpuBackend *backend, int gpu, QObject *parent)
+    : QObject(parent), backend(backend), gpu(gpu) {
+    bool ok = false;
+    int ms = qEnvironmentVariableIntValue("GPU_CONTROL_LIVE_QUIET_MS", &ok);
+    if (ok && ms >= 0)
+        quietMs = ms;
+    maxWaitMs = qMax(maxWaitMs, quietMs);
+
+    for (int field : {ApplyPowerLimit, ApplyMemoryOffset, ApplyCoreOffset, ApplyGraphicsLock, ApplyMemoryLock}) {
+        Attribute &attribute = attributes[field];
+        attribute.quiet = new QTimer(this);
+        attribute.quiet->setSingleShot(true);
+        connect(attribute.quiet, &QTimer::timeout, this, [this, field]() { write(field); });
+    }
+}
+
+void LiveApplier::setEnabled(bool on) {
+    enabled = on;
+    if (on)
+        return;
+    for (Attribute &attribute : attributes)
+        attribute.quiet->stop();
+}
+
+void LiveApplier::edited(int fields) {
+    if (!enabled)
+        return;
+    for (auto it = attributes.begin(); it != attributes.end(); ++it) {
+        if (!(fields & it.key()))
+            continue;
+        if (!it->quiet->isActive())
+            it->burst.start();
+        // Editing a field back to a value that failed tries it again
+        it->failed = false;
+        // A long drag still lands every maxWaitMs
+        qint64 left = maxWaitMs - it->burst.elapsed();
+        it->quiet->start(int(qBound<qint64>(0, left, quietMs)));
+    }
+}
+
+void LiveApplier::write(int field) {
+    if (!enabled || !wanted || !pendingFields || attributes[field].inFlight)
+        return;
+    GpuSettings target = wanted();
+    int fields = field & pendingFields(target);
+    if (!fields || (attributes[field].failed && sameValue(field, target, attributes[field].failedTarget)))
+        return;
+
+    attributes[field].inFlight = true;
+    ++writes;
+    GpuBackend *b = backend;
+    int gpu = this->gpu;
+    QElapsedTimer timer;
+    timer.start();
+    auto *watcher = new QFutureWatcher<ApplyResult>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, field, fields, target, timer]() {
+        ApplyResult result = watcher->result();
+        watcher->deleteLater();
+        Attribute &attribute = attributes[field];
+        attribute.inFlight = false;
+        attribute.failed = !result.ok();
+        attribute.failedTarget = target;
+        if (onWritten)
+            onWritten(target, fields, result, timer.elapsed());
+        // Edits made during the write wait for their own quiet period;
+        // once that has passed, catch up now, after a failure too. write()
+        // skips the value that just failed.
+        if (!attribute.quiet->isActive())
+            write(field);
+    });
+    watcher->setFuture(QtConcurrent::run([b, gpu, target, fields]() { return b->apply(gpu, target, fields); }));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QObject>
+
+#include <functional>
+
+class QTimer;
+
+// Writes one GPU's settings while they are being adjusted. Every attribute
+// (ApplyField bit) has its own quiet-period timer, so a burst of edits
+// collapses into one write of the newest value; a burst that keeps going
+// still writes every maxWaitMs so the result shows in the telemetry while
+// dragging. At most one write per attribute is in flight at a time, on the
+// thread pool; an edit that lands during a write is written when it returns.
+// A value that failed is not retried until it is edited again.
+//
+// GPU_CONTROL_LIVE_QUIET_MS overrides the quiet period.
+class LiveApplier : public QObject {
+public:
+    LiveApplier(GpuBackend *backend, int gpu, QObject *parent = nullptr);
+
+    // The settings as they stand now, and the fields of those that still
+    // need writing
+    void setSource(const std::function<GpuSettings()> &settings, const std::function<int(const GpuSettings &)> &pending) {
+        wanted = settings;
+        pendingFields = pending;
+    }
+    // Called on the GUI thread after every write, with its duration
+    void setWrittenHandler(const std::function<void(const GpuSettings &, int, const ApplyResult &, qint64)> &handler) {
+        onWritten = handler;
+    }
+
+    void setEnabled(bool on);
+    bool isEnabled() const { return enabled; }
+    // fields were just edited; restarts their quiet periods
+    void edited(int fields);
+
+    // Writes started so far
+    quint64 writeCount() const { return writes; }
+
+private:
+    struct Attribute {
+        QTimer *quiet = nullptr;
+        QElapsedTimer burst;    // Since the first edit of the current burst
+        bool inFlight = false;
+        bool failed = false;    // failedTarget was refused, don't write it again
+        GpuSettings failedTarget;
+    };
+
+    void write(int field);
+
+    GpuBackend *backend;
+    int gpu;
+    bool enabled = false;
+    int quietMs = 300;
+    int maxWaitMs = 1500;
+    quint64 writes = 0;
+    QMap<int, Attribute> attributes;
+    std::function<GpuSettings()> wanted;
+    std::function<int(const GpuSettings &)> pendingFields;
+    std::function<void(const GpuSettings &, int, const ApplyResult &, qint64)> onWritten;
+};
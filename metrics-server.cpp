@@ -0,0 +1,212 @@
+#include "metrics-server.h"
+
+#include <QHostAddress>
+#include <QTcpSocket>
+#include <QTextStream>
+
+#include <functional>
+
+static const double BucketBounds[] = {0.005, 0.01, 0.05, 0.1, 0.5, 1, 5};
+
+MetricsServer::MetricsServer(QObject *parent) : QTcpServer(parent) {
+    connect(this, &QTcpServer::newConnection, this, [this]() {
+        while (QTcpSocket *socket = nextPendingConnection()) {
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { handle(socket); });
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        }
+    });
+}
+
+bool MetricsServer::listen(const QString &address, QString *error) {
+    QString host = address.contains(':') ? address.section(':', 0, -2) : QString();
+    bool ok = false;
+    int port = address.section(':', -1).toInt(&ok);
+    QHostAddress bind(host.isEmpty() ? QString("127.0.0.1") : host);
+    if (!ok || port <= 0 || port > 65535 || bind.isNull()) {
+        *error = "Bad listen address " + address;
+        return false;
+    }
+    if (!QTcpServer::listen(bind, quint16(port))) {
+        *error = errorString();
+        return false;
+    }
+    return true;
+}
+
+void MetricsServer::setStaticInfo(int gpu, const QString &pciBusId, const GpuStaticInfo &info) {
+    gpus[gpu].pciBusId = pciBusId;
+    gpus[gpu].info = info;
+    stale = true;
+}
+
+void MetricsServer::setSettings(int gpu, const GpuSettings &settings, int fields) {
+    Gpu &entry = gpus[gpu];
+    if (fields & ApplyPowerLimit)
+        entry.settings.powerLimit = settings.powerLimit;
+    if (fields & ApplyMemoryOffset)
+        entry.settings.memoryOffset = settings.memoryOffset;
+    if (fields & ApplyCoreOffset)
+        entry.settings.coreOffset = settings.coreOffset;
+    entry.knownFields |= fields;
+    stale = true;
+}
+
+void MetricsServer::addSample(const TelemetrySample &sample) {
+    Gpu &entry = gpus[sample.gpu];
+    entry.sample = sample;
+    entry.hasSample = true;
+    stale = true;
+}
+
+void MetricsServer::setDroppedSamples(quint64 count) {
+    if (count == droppedSamples)
+        return;
+    droppedSamples = count;
+    stale = true;
+}
+
+void MetricsServer::recordApply(bool ok, double seconds) {
+    QMutexLocker lock(&applyMutex);
+    ++applies[ok ? 1 : 0];
+    applySeconds += seconds;
+    for (int i = 0; i < Buckets; ++i) {
+        if (seconds <= BucketBounds[i])
+            ++applyBuckets[i];
+    }
+    stale = true;
+}
+
+void MetricsServer::recordDrift(int fields) {
+    QMutexLocker lock(&applyMutex);
+    if (fields & ApplyPowerLimit)
+        ++drifts[0];
+    if (fields & ApplyMemoryOffset)
+        ++drifts[1];
+    if (fields & ApplyCoreOffset)
+        ++drifts[2];
+    stale = true;
+}
+
+void MetricsServer::handle(QTcpSocket *socket) {
+    // Nothing but a request line and headers is expected; anything that big
+    // is not a scraper
+    if (socket->bytesAvailable() > 8192) {
+        socket->abort();
+        return;
+    }
+    if (!socket->canReadLine())
+        return;
+    QList<QByteArray> request = socket->readLine().trimmed().split(' ');
+    socket->readAll();
+
+    QByteArray status = "200 OK";
+    QByteArray type = "text/plain; version=0.0.4; charset=utf-8";
+    QByteArray content;
+    QByteArray path = request.value(1).split('?').value(0);
+    if (request.value(0) != "GET" && request.value(0) != "HEAD") {
+        status = "405 Method Not Allowed";
+        type = "text/plain";
+    } else if (path == "/metrics") {
+        ++scrapes;
+        content = render();
+    } else if (path == "/") {
+        type = "text/html";
+        content = "<html><body><a href=\"/metrics\">Metrics</a></body></html>\n";
+    } else {
+        status = "404 Not Found";
+        type = "text/plain";
+    }
+
+    QByteArray response = "HTTP/1.1 " + status + "\r\nContent-Type: " + type
+        + "\r\nContent-Length: " + QByteArray::number(content.size()) + "\r\nConnection: close\r\n\r\n";
+    if (request.value(0) != "HEAD")
+        response += content;
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+QByteArray MetricsServer::render() {
+    // Scrape counter changes every time, so it goes on after the cached part
+    if (stale.exchange(false)) {
+        QString text;
+        QTextStream out(&text);
+        // Enough digits for epoch timestamps and clocks in hertz
+        out.setRealNumberPrecision(15);
+        auto family = [&out](const char *name, const char *type, const char *help) {
+            out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+        };
+        auto gauge = [&](const char *name, const char *help, const std::function<double(const Gpu &)> &value,
+                         const std::function<bool(const Gpu &)> &known) {
+            family(name, "gauge", help);
+            for (auto it = gpus.constBegin(); it != gpus.constEnd(); ++it) {
+                if (!known(*it))
+                    continue;
+                out << name << "{gpu=\"" << it.key() << "\",pci_bus_id=\"" << it->pciBusId << "\"} "
+                    << value(*it) << '\n';
+            }
+        };
+        gauge("gpu_control_power_draw_watts", "Board power draw.",
+              [](const Gpu &g) { return double(g.sample.powerDraw); },
+              [](const Gpu &g) { return g.hasSample && g.sample.powerDraw >= 0; });
+        gauge("gpu_control_temperature_celsius", "GPU die temperature.",
+              [](const Gpu &g) { return double(g.sample.temperature); },
+              [](const Gpu &g) { return g.hasSample && g.sample.temperature >= 0; });
+        gauge("gpu_control_graphics_clock_hertz", "Current graphics clock.",
+              [](const Gpu &g) { return g.sample.graphicsClock * 1e6; },
+              [](const Gpu &g) { return g.hasSample && g.sample.graphicsClock >= 0; });
+        gauge("gpu_control_memory_clock_hertz", "Current memory clock.",
+              [](const Gpu &g) { return g.sample.memoryClock * 1e6; },
+              [](const Gpu &g) { return g.hasSample && g.sample.memoryClock >= 0; });
+        gauge("gpu_control_utilization_ratio", "GPU utilization, 0 to 1.",
+              [](const Gpu &g) { return g.sample.gpuUtilization / 100.0; },
+              [](const Gpu &g) { return g.hasSample && g.sample.gpuUtilization >= 0; });
+        gauge("gpu_control_throttle_reasons", "NVML clocks throttle reason bit mask.",
+              [](const Gpu &g) { return double(g.sample.throttleReasons); },
+              [](const Gpu &g) { return g.hasSample; });
+        gauge("gpu_control_sample_timestamp_seconds", "When the values above were sampled.",
+              [](const Gpu &g) { return g.sample.timestampMs / 1000.0; },
+              [](const Gpu &g) { return g.hasSample; });
+        gauge("gpu_control_power_limit_watts", "Power limit in force.",
+              [](const Gpu &g) { return double(g.settings.powerLimit); },
+              [](const Gpu &g) { return (g.knownFields & ApplyPowerLimit) != 0; });
+        gauge("gpu_control_power_limit_min_watts", "Lowest power limit the board accepts.",
+              [](const Gpu &g) { return double(g.info.minPowerLimit); },
+              [](const Gpu &g) { return g.info.minPowerLimit > 0; });
+        gauge("gpu_control_power_limit_max_watts", "Highest power limit the board accepts.",
+              [](const Gpu &g) { return double(g.info.maxPowerLimit); },
+              [](const Gpu &g) { return g.info.maxPowerLimit > 0; });
+        gauge("gpu_control_power_limit_default_watts", "Power limit the board ships with.",
+              [](const Gpu &g) { return double(g.info.defaultPowerLimit); },
+              [](const Gpu &g) { return g.info.defaultPowerLimit > 0; });
+        gauge("gpu_control_memory_offset_hertz", "Memory transfer rate offset in force.",
+              [](const Gpu &g) { return g.settings.memoryOffset * 1e6; },
+              [](const Gpu &g) { return (g.knownFields & ApplyMemoryOffset) != 0; });
+        gauge("gpu_control_core_offset_hertz", "Graphics clock offset in force.",
+              [](const Gpu &g) { return g.settings.coreOffset * 1e6; },
+              [](const Gpu &g) { return (g.knownFields & ApplyCoreOffset) != 0; });
+        family("gpu_control_telemetry_dropped_samples_total", "counter",
+               "Samples lost because the telemetry ring was full.");
+        out << "gpu_control_telemetry_dropped_samples_total " << droppedSamples << '\n';
+
+        QMutexLocker lock(&applyMutex);
+        family("gpu_control_applies_total", "counter", "Settings writes, by outcome.");
+        out << "gpu_control_applies_total{result=\"ok\"} " << applies[1] << '\n';
+        out << "gpu_control_applies_total{result=\"error\"} " << applies[0] << '\n';
+        family("gpu_control_apply_duration_seconds", "histogram", "Time taken by one settings write.");
+        for (int i = 0; i < Buckets; ++i)
+            out << "gpu_control_apply_duration_seconds_bucket{le=\"" << BucketBounds[i] << "\"} "
+                << applyBuckets[i] << '\n';
+        out << "gpu_control_apply_duration_seconds_bucket{le=\"+Inf\"} " << applies[0] + applies[1] << '\n';
+        out << "gpu_control_apply_duration_seconds_sum " << applySeconds << '\n';
+        out << "gpu_control_apply_duration_seconds_count " << applies[0] + applies[1] << '\n';
+        family("gpu_control_drift_events_total", "counter",
+               "Settings found changed behind the app's back and written again.");
+        out << "gpu_control_drift_events_total{attribute=\"power_limit\"} " << drifts[0] << '\n';
+        out << "gpu_control_drift_events_total{attribute=\"memory_offset\"} " << drifts[1] << '\n';
+        out << "gpu_control_drift_events_total{attribute=\"core_offset\"} " << drifts[2] << '\n';
+        family("gpu_control_scrapes_total", "counter", "Requests for /metrics.");
+        out.flush();
+        body = text.toUtf8();
+    }
+    return body + "gpu_control_scrapes_total " + QByteArray::number(scrapes) + '\n';
+}
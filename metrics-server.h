@@ -0,0 +1,60 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QTcpServer>
+
+#include <atomic>
+
+// Prometheus text-format /metrics over plain HTTP. Every scrape is served
+// from the latest cached telemetry and settings, so scrapes never touch the
+// driver and cost the same however many scrapers there are. Lives on the
+// thread that owns the event loop; only recordApply() may be called from
+// other threads.
+class MetricsServer : public QTcpServer {
+public:
+    explicit MetricsServer(QObject *parent = nullptr);
+
+    // "host:port", ":port" or "port"; the host defaults to loopback
+    bool listen(const QString &address, QString *error);
+
+    void setStaticInfo(int gpu, const QString &pciBusId, const GpuStaticInfo &info);
+    void setSettings(int gpu, const GpuSettings &settings, int fields);
+    void addSample(const TelemetrySample &sample);
+    // TelemetrySampler::droppedSamples(), so a consumer falling behind shows
+    void setDroppedSamples(quint64 count);
+    void recordApply(bool ok, double seconds);
+    void recordDrift(int fields);
+
+    static const char *defaultAddress() { return "127.0.0.1:9835"; }
+
+private:
+    struct Gpu {
+        QString pciBusId;
+        GpuStaticInfo info;
+        GpuSettings settings;
+        int knownFields = 0;
+        TelemetrySample sample;
+        bool hasSample = false;
+    };
+
+    void handle(QTcpSocket *socket);
+    QByteArray render();
+
+    QMap<int, Gpu> gpus;
+    QByteArray body;            // Rendered metrics, rebuilt when stale
+    std::atomic<bool> stale{true};
+    quint64 scrapes = 0;
+    quint64 droppedSamples = 0;
+
+    // Apply counters are written from worker threads
+    static const int Buckets = 7;
+    QMutex applyMutex;
+    quint64 applies[2] = {0, 0};        // failed, ok
+    quint64 applyBuckets[Buckets] = {};
+    double applySeconds = 0;
+    quint64 drifts[3] = {0, 0, 0};      // power limit, memory offset, core offset
+};
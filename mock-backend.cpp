@@ -0,0 +1,323 @@
+#include "mock-backend.h"
+
+#include <QThread>
+#include <QtMath>
+
+MockBackend::MockBackend() {
+    bool ok = false;
+    int count = qEnvironmentVariableIntValue("GPU_CONTROL_MOCK_GPUS", &ok);
+    if (!ok || count < 0)
+        count = 1;
+    latencyMs = qMax(0, qEnvironmentVariableIntValue("GPU_CONTROL_MOCK_LATENCY_MS"));
+    resetMs = qMax(0, qEnvironmentVariableIntValue("GPU_CONTROL_MOCK_RESET_MS"));
+    clock.start();
+
+    devices.resize(count);
+    for (int i = 0; i < count; ++i) {
+        devices[i].name = QString("Mock GPU %1").arg(i);
+        // No two chips overclock alike
+        devices[i].stableCoreOffset += 30 * i;
+        devices[i].stableMemoryOffset -= 200 * i;
+    }
+}
+
+void MockBackend::advanceClock(qint64 ms) {
+    QMutexLocker lock(&mutex);
+    skewMs += ms;
+}
+
+void MockBackend::simulateLatency() const {
+    if (latencyMs > 0)
+        QThread::msleep(latencyMs);
+}
+
+MockBackend::Device *MockBackend::device(int gpu, QString *error) {
+    // A driver reload drops everything back to stock, as a real one does
+    if (resetMs > 0 && elapsed() / resetMs > resets) {
+        resets = elapsed() / resetMs;
+        for (Device &dev : devices) {
+            dev.powerLimit = dev.defaultPowerLimit;
+            dev.memoryOffset = 0;
+            dev.coreOffset = 0;
+            dev.graphicsLockMin = dev.graphicsLockMax = 0;
+            dev.memoryLockMin = dev.memoryLockMax = 0;
+        }
+    }
+    if (gpu >= 0 && gpu < devices.size())
+        return &devices[gpu];
+    if (error)
+        *error = QString("No such GPU: %1").arg(gpu);
+    return nullptr;
+}
+
+int MockBackend::deviceCount() {
+    QMutexLocker lock(&mutex);
+    return devices.size();
+}
+
+QString MockBackend::pciBusId(int gpu) {
+    return QString("00000000:%1:00.0").arg(gpu + 1, 2, 16, QChar('0')).toUpper();
+}
+
+QString MockBackend::gpuName(int gpu) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    return dev ? dev->name : QString();
+}
+
+int MockBackend::minPowerLimit(int gpu) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    return dev ? dev->minPowerLimit : -1;
+}
+
+int MockBackend::maxPowerLimit(int gpu) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    return dev ? dev->maxPowerLimit : -1;
+}
+
+int MockBackend::defaultPowerLimit(int gpu) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    return dev ? dev->defaultPowerLimit : -1;
+}
+
+int MockBackend::powerLimit(int gpu) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    return dev ? dev->powerLimit : -1;
+}
+
+int MockBackend::memoryClock(int gpu) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    return dev ? lockedMemoryClock(*dev) : -1;
+}
+
+int MockBackend::lockedMemoryClock(const Device &dev) {
+    int clock = dev.baseMemoryClock + dev.memoryOffset / 2;
+    return dev.memoryLockMax > 0 ? qBound(dev.memoryLockMin, clock, dev.memoryLockMax) : clock;
+}
+
+int MockBackend::graphicsClock(int gpu) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    if (!dev)
+        return -1;
+    int clock = dev->baseGraphicsClock + dev->coreOffset;
+    return dev->graphicsLockMax > 0 ? qMin(clock, dev->graphicsLockMax) : clock;
+}
+
+bool MockBackend::memoryOffset(int gpu, int *mhz) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    if (!dev)
+        return false;
+    *mhz = dev->memoryOffset;
+    return true;
+}
+
+bool MockBackend::coreOffset(int gpu, int *mhz) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    if (!dev)
+        return false;
+    *mhz = dev->coreOffset;
+    return true;
+}
+
+bool MockBackend::memoryOffsetRange(int gpu, int *min, int *max) {
+    if (gpu < 0 || gpu >= deviceCount())
+        return false;
+    *min = -2000;
+    *max = 6000;
+    return true;
+}
+
+bool MockBackend::coreOffsetRange(int gpu, int *min, int *max) {
+    if (gpu < 0 || gpu >= deviceCount())
+        return false;
+    *min = -1000;
+    *max = 1000;
+    return true;
+}
+
+bool MockBackend::supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    if (!dev)
+        return false;
+    // The same shape as a real table: a few memory P-states and graphics
+    // clocks in 15 MHz steps up to the boost clock
+    *memory = QVector<int>() << dev->baseMemoryClock << 5001 << 810 << 405;
+    graphics->clear();
+    for (int mhz = dev->baseGraphicsClock; mhz >= 210; mhz -= 15)
+        graphics->append(mhz);
+    return true;
+}
+
+double MockBackend::demand(const Device &dev, double load) {
+    return 40 + load * (dev.maxPowerLimit - 40);
+}
+
+bool MockBackend::sample(int gpu, TelemetrySample *out) {
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    if (!dev)
+        return false;
+
+    // A load that swings between idle and flat out every 20 s, unless a
+    // simulated workload holds it at full. Demand above the power limit is
+    // clipped and shows up as a power-cap throttle; a die at the slowdown
+    // temperature loses another 20 % and reports a thermal throttle.
+    const int slowdownTemperature = 83;
+    double load = dev->fullLoad ? 1.0 : 0.5 + 0.5 * qSin(elapsed() / 20000.0 * 2 * M_PI + gpu);
+    double demand = MockBackend::demand(*dev, load);
+    double draw = qMin(demand, double(dev->powerLimit));
+    quint64 reasons = demand > dev->powerLimit ? 0x4 : 0;
+    if (dev->temperature >= slowdownTemperature) {
+        draw *= 0.8;
+        reasons |= 0x20;
+    }
+    double clockScale = demand > 0 ? draw / demand : 1.0;
+    heat(dev, draw);
+
+    int graphicsClock = int((dev->baseGraphicsClock + dev->coreOffset) * (0.3 + 0.7 * load) * qSqrt(clockScale));
+    // A lock caps the clock and holds it up at idle; power and heat can
+    // still pull it below the floor
+    if (dev->graphicsLockMax > 0) {
+        graphicsClock = qMin(graphicsClock, dev->graphicsLockMax);
+        if (!reasons)
+            graphicsClock = qMax(graphicsClock, dev->graphicsLockMin);
+    }
+
+    out->gpu = gpu;
+    out->powerDraw = draw;
+    out->graphicsClock = graphicsClock;
+    out->memoryClock = lockedMemoryClock(*dev);
+    out->temperature = qRound(dev->temperature);
+    out->gpuUtilization = int(load * 100);
+    out->memUtilization = int(load * 60);
+    out->throttleReasons = reasons;
+    return true;
+}
+
+void MockBackend::heat(Device *dev, double draw) {
+    // First-order lag: 0.14 °C/W over 30 °C ambient (93 °C flat out at
+    // 450 W) with a 10 s time constant, quick enough to watch a governor
+    // settle but slow enough that it has to anticipate.
+    const double ambient = 30;
+    const double resistance = 0.14;
+    const double tauMs = 10000;
+    qint64 now = elapsed();
+    double settled = ambient + draw * resistance;
+    if (dev->thermalMs >= 0)
+        dev->temperature += (settled - dev->temperature) * (1 - qExp(-(now - dev->thermalMs) / tauMs));
+    dev->thermalMs = now;
+}
+
+bool MockBackend::simulateWorkload(int gpu, bool running, double *throughput) {
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu);
+    if (!dev)
+        return false;
+    dev->fullLoad = running;
+    if (running || !throughput)
+        return true;
+    if (dev->coreOffset > dev->stableCoreOffset || dev->memoryOffset > dev->stableMemoryOffset) {
+        *throughput = -1;
+        return true;
+    }
+
+    // Roughly 90 W of the board power is static; throughput follows the
+    // square root of the rest, which puts the perf/W peak where dynamic
+    // power equals static power (~180 W) and makes the top end expensive.
+    const double staticPower = 90;
+    double draw = qMin(demand(*dev, 1.0), double(dev->powerLimit));
+    double dynamic = qMax(0.0, draw - staticPower) / (demand(*dev, 1.0) - staticPower);
+    // Memory offset helps until error correction starts eating the gain
+    double clockGain = 1 + dev->coreOffset / 5000.0;
+    double memoryGain = 1 + 0.03 * qMin(dev->memoryOffset, 1000) / 1000.0
+        - 0.05 * qMax(0, dev->memoryOffset - 1000) / 1000.0;
+    *throughput = 1000 * qSqrt(dynamic) * clockGain * memoryGain;
+    return true;
+}
+
+bool MockBackend::setPowerLimit(int gpu, int watts, QString *error) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu, error);
+    if (!dev)
+        return false;
+    if (watts < dev->minPowerLimit || watts > dev->maxPowerLimit) {
+        if (error)
+            *error = QString("%1 W is outside %2..%3 W").arg(watts)
+                .arg(dev->minPowerLimit).arg(dev->maxPowerLimit);
+        return false;
+    }
+    dev->powerLimit = watts;
+    return true;
+}
+
+bool MockBackend::setMemoryOffset(int gpu, int mhz, QString *error) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu, error);
+    if (!dev)
+        return false;
+    dev->memoryOffset = mhz;
+    return true;
+}
+
+bool MockBackend::setCoreOffset(int gpu, int mhz, QString *error) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu, error);
+    if (!dev)
+        return false;
+    dev->coreOffset = mhz;
+    return true;
+}
+
+bool MockBackend::setGraphicsClockLock(int gpu, int min, int max, QString *error) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu, error);
+    if (!dev)
+        return false;
+    if (min < 0 || min > max) {
+        if (error)
+            *error = QString("Invalid clock range %1,%2").arg(min).arg(max);
+        return false;
+    }
+    dev->graphicsLockMin = min;
+    dev->graphicsLockMax = max;
+    return true;
+}
+
+bool MockBackend::setMemoryClockLock(int gpu, int min, int max, QString *error) {
+    simulateLatency();
+    QMutexLocker lock(&mutex);
+    Device *dev = device(gpu, error);
+    if (!dev)
+        return false;
+    if (min < 0 || min > max) {
+        if (error)
+            *error = QString("Invalid clock range %1,%2").arg(min).arg(max);
+        return false;
+    }
+    dev->memoryLockMin = min;
+    dev->memoryLockMax = max;
+    return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVector>
+
+// In-memory backend for machines without a GPU. Device count and per-call
+// latency come from GPU_CONTROL_MOCK_GPUS and GPU_CONTROL_MOCK_LATENCY_MS so
+// the rest of the app can be exercised and timed like the real thing.
+// GPU_CONTROL_MOCK_RESET_MS simulates a driver reload that often.
+class MockBackend : public GpuBackend {
+public:
+    MockBackend();
+
+    QString name() const override { return "mock"; }
+    int deviceCount() override;
+
+    QString pciBusId(int gpu) override;
+    QString driverVersion() override { return "mock"; }
+    QString gpuName(int gpu) override;
+    int minPowerLimit(int gpu) override;
+    int maxPowerLimit(int gpu) override;
+    int defaultPowerLimit(int gpu) override;
+    int powerLimit(int gpu) override;
+    int memoryClock(int gpu) override;
+    int graphicsClock(int gpu) override;
+    bool memoryOffset(int gpu, int *mhz) override;
+    bool coreOffset(int gpu, int *mhz) override;
+    bool memoryOffsetRange(int gpu, int *min, int *max) override;
+    bool coreOffsetRange(int gpu, int *min, int *max) override;
+    bool supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) override;
+    bool sample(int gpu, TelemetrySample *out) override;
+
+    // Holds the device at full load while running is true and, when it
+    // stops, reports the throughput the performance model gives at the
+    // current settings, or -1 if the offsets made it crash. Driven by
+    // SimulatedWorkload.
+    bool simulateWorkload(int gpu, bool running, double *throughput);
+
+    // Moves simulated time (load, heat, resets) ahead, so a test can run
+    // the thermal model for minutes without waiting for them
+    void advanceClock(qint64 ms);
+
+    bool setPowerLimit(int gpu, int watts, QString *error) override;
+    bool setMemoryOffset(int gpu, int mhz, QString *error) override;
+    bool setCoreOffset(int gpu, int mhz, QString *error) override;
+    bool setGraphicsClockLock(int gpu, int min, int max, QString *error) override;
+    bool setMemoryClockLock(int gpu, int min, int max, QString *error) override;
+
+private:
+    struct Device {
+        QString name;
+        int minPowerLimit = 100;
+        int maxPowerLimit = 450;
+        int defaultPowerLimit = 350;
+        int powerLimit = 350;
+        int baseMemoryClock = 10501;
+        int baseGraphicsClock = 2520;
+        int memoryOffset = 0;
+        int coreOffset = 0;
+        int graphicsLockMin = 0;    // 0, 0: unlocked
+        int graphicsLockMax = 0;
+        int memoryLockMin = 0;
+        int memoryLockMax = 0;
+        bool fullLoad = false;  // Held by simulateWorkload()
+        double temperature = 35;
+        qint64 thermalMs = -1;  // When temperature was last advanced
+        // Highest offsets this simulated chip survives
+        int stableCoreOffset = 165;
+        int stableMemoryOffset = 1500;
+    };
+
+    // Board power at the given load (0..1) and power limit
+    static double demand(const Device &dev, double load);
+    // Moves the die temperature toward where the given draw settles it
+    void heat(Device *dev, double draw);
+    // Memory clock after its offset and lock
+    static int lockedMemoryClock(const Device &dev);
+
+    qint64 elapsed() const { return clock.elapsed() + skewMs; }
+    void simulateLatency() const;
+    Device *device(int gpu, QString *error = nullptr);
+
+    QElapsedTimer clock;        // Drives the simulated load
+    qint64 skewMs = 0;          // Added by advanceClock()
+    mutable QMutex mutex;
+    QVector<Device> devices;
+    int latencyMs = 0;
+    int resetMs = 0;
+    qint64 resets = 0;
+};
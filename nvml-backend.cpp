@@ -0,0 +1,436 @@
+#include "nvml-backend.h"
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <functional>
+
+// Layout of nvmlPciInfo_t as used by nvmlDeviceGetPciInfo_v3
+struct nvmlPciInfo_st {
+    char busIdLegacy[16];
+    unsigned int domain;
+    unsigned int bus;
+    unsigned int device;
+    unsigned int pciDeviceId;
+    unsigned int pciSubSystemId;
+    char busId[32];
+};
+
+struct nvmlUtilization_st {
+    unsigned int gpu;
+    unsigned int memory;
+};
+
+namespace {
+
+const int NVML_SUCCESS = 0;
+const int NVML_ERROR_NOT_SUPPORTED = 3;
+const int NVML_ERROR_NO_PERMISSION = 4;
+const int NVML_ERROR_FUNCTION_NOT_FOUND = 13;
+
+const int NVML_CLOCK_GRAPHICS = 0;
+const int NVML_CLOCK_MEM = 2;
+const int NVML_TEMPERATURE_GPU = 0;
+
+template <typename T>
+bool resolve(void *lib, const char *symbol, T *fn) {
+    *fn = reinterpret_cast<T>(dlsym(lib, symbol));
+    return *fn != nullptr;
+}
+
+// Errors where retrying through the subprocess path can still succeed.
+bool shouldFallBack(int ret) {
+    return ret == NVML_ERROR_NO_PERMISSION || ret == NVML_ERROR_NOT_SUPPORTED
+        || ret == NVML_ERROR_FUNCTION_NOT_FOUND;
+}
+
+}
+
+NvmlBackend::NvmlBackend() {
+    lib = dlopen("libnvidia-ml.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!lib)
+        lib = dlopen("libnvidia-ml.so", RTLD_NOW | RTLD_LOCAL);
+    if (!lib)
+        return;
+
+    bool ok = resolve(lib, "nvmlInit_v2", &nvmlInit)
+        && resolve(lib, "nvmlShutdown", &nvmlShutdown)
+        && resolve(lib, "nvmlErrorString", &nvmlErrorString)
+        && resolve(lib, "nvmlDeviceGetCount_v2", &nvmlDeviceGetCount)
+        && resolve(lib, "nvmlDeviceGetHandleByIndex_v2", &nvmlDeviceGetHandleByIndex)
+        && resolve(lib, "nvmlSystemGetDriverVersion", &nvmlSystemGetDriverVersion)
+        && resolve(lib, "nvmlDeviceGetPciInfo_v3", &nvmlDeviceGetPciInfo)
+        && resolve(lib, "nvmlDeviceGetName", &nvmlDeviceGetName)
+        && resolve(lib, "nvmlDeviceGetPowerManagementLimit", &nvmlDeviceGetPowerManagementLimit)
+        && resolve(lib, "nvmlDeviceGetPowerManagementDefaultLimit", &nvmlDeviceGetPowerManagementDefaultLimit)
+        && resolve(lib, "nvmlDeviceGetPowerManagementLimitConstraints", &nvmlDeviceGetPowerManagementLimitConstraints)
+        && resolve(lib, "nvmlDeviceSetPowerManagementLimit", &nvmlDeviceSetPowerManagementLimit)
+        && resolve(lib, "nvmlDeviceGetClockInfo", &nvmlDeviceGetClockInfo);
+
+    // Telemetry; missing symbols just leave those fields at -1
+    resolve(lib, "nvmlDeviceGetPowerUsage", &nvmlDeviceGetPowerUsage);
+    resolve(lib, "nvmlDeviceGetTemperature", &nvmlDeviceGetTemperature);
+    resolve(lib, "nvmlDeviceGetUtilizationRates", &nvmlDeviceGetUtilizationRates);
+    resolve(lib, "nvmlDeviceGetCurrentClocksThrottleReasons", &nvmlDeviceGetCurrentClocksThrottleReasons);
+
+    // VF offsets only exist on 470+ drivers; nvidia-settings covers older ones.
+    resolve(lib, "nvmlDeviceGetMemClkVfOffset", &nvmlDeviceGetMemClkVfOffset);
+    resolve(lib, "nvmlDeviceSetMemClkVfOffset", &nvmlDeviceSetMemClkVfOffset);
+    resolve(lib, "nvmlDeviceGetGpcClkVfOffset", &nvmlDeviceGetGpcClkVfOffset);
+    resolve(lib, "nvmlDeviceSetGpcClkVfOffset", &nvmlDeviceSetGpcClkVfOffset);
+    resolve(lib, "nvmlDeviceGetMemClkMinMaxVfOffset", &nvmlDeviceGetMemClkMinMaxVfOffset);
+    resolve(lib, "nvmlDeviceGetGpcClkMinMaxVfOffset", &nvmlDeviceGetGpcClkMinMaxVfOffset);
+
+    // Locked clocks arrived in 418 (graphics) and 460 (memory)
+    resolve(lib, "nvmlDeviceGetSupportedMemoryClocks", &nvmlDeviceGetSupportedMemoryClocks);
+    resolve(lib, "nvmlDeviceGetSupportedGraphicsClocks", &nvmlDeviceGetSupportedGraphicsClocks);
+    resolve(lib, "nvmlDeviceSetGpuLockedClocks", &nvmlDeviceSetGpuLockedClocks);
+    resolve(lib, "nvmlDeviceResetGpuLockedClocks", &nvmlDeviceResetGpuLockedClocks);
+    resolve(lib, "nvmlDeviceSetMemoryLockedClocks", &nvmlDeviceSetMemoryLockedClocks);
+    resolve(lib, "nvmlDeviceResetMemoryLockedClocks", &nvmlDeviceResetMemoryLockedClocks);
+
+    if (!ok || nvmlInit() != NVML_SUCCESS) {
+        dlclose(lib);
+        lib = nullptr;
+        return;
+    }
+
+    unsigned int count = 0;
+    if (nvmlDeviceGetCount(&count) == NVML_SUCCESS) {
+        for (unsigned int i = 0; i < count; ++i) {
+            nvmlDevice_t dev = nullptr;
+            if (nvmlDeviceGetHandleByIndex(i, &dev) != NVML_SUCCESS)
+                break;
+            devices.append(dev);
+        }
+    }
+    loaded = true;
+}
+
+NvmlBackend::~NvmlBackend() {
+    if (loaded)
+        nvmlShutdown();
+    if (lib)
+        dlclose(lib);
+}
+
+NvmlBackend::nvmlDevice_t NvmlBackend::device(int gpu) const {
+    return gpu >= 0 && gpu < devices.size() ? devices[gpu] : nullptr;
+}
+
+QString NvmlBackend::errorString(nvmlReturn_t ret) const {
+    return QString::fromLatin1(nvmlErrorString(ret));
+}
+
+int NvmlBackend::deviceCount() {
+    return devices.size();
+}
+
+QString NvmlBackend::pciBusId(int gpu) {
+    nvmlPciInfo_st pci = {};
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || nvmlDeviceGetPciInfo(dev, &pci) != NVML_SUCCESS)
+        return QString();
+    return QString::fromLatin1(pci.busId);
+}
+
+QString NvmlBackend::driverVersion() {
+    char version[80] = {};
+    if (nvmlSystemGetDriverVersion(version, sizeof(version)) != NVML_SUCCESS)
+        return QString();
+    return QString::fromLatin1(version);
+}
+
+QString NvmlBackend::gpuName(int gpu) {
+    char name[96] = {};
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || nvmlDeviceGetName(dev, name, sizeof(name)) != NVML_SUCCESS)
+        return QString();
+    return QString::fromLatin1(name);
+}
+
+int NvmlBackend::minPowerLimit(int gpu) {
+    unsigned int minMw = 0, maxMw = 0;
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || nvmlDeviceGetPowerManagementLimitConstraints(dev, &minMw, &maxMw) != NVML_SUCCESS)
+        return -1;
+    return minMw / 1000;
+}
+
+int NvmlBackend::maxPowerLimit(int gpu) {
+    unsigned int minMw = 0, maxMw = 0;
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || nvmlDeviceGetPowerManagementLimitConstraints(dev, &minMw, &maxMw) != NVML_SUCCESS)
+        return -1;
+    return maxMw / 1000;
+}
+
+int NvmlBackend::defaultPowerLimit(int gpu) {
+    unsigned int mw = 0;
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || nvmlDeviceGetPowerManagementDefaultLimit(dev, &mw) != NVML_SUCCESS)
+        return -1;
+    return mw / 1000;
+}
+
+int NvmlBackend::powerLimit(int gpu) {
+    unsigned int mw = 0;
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || nvmlDeviceGetPowerManagementLimit(dev, &mw) != NVML_SUCCESS)
+        return -1;
+    return mw / 1000;
+}
+
+int NvmlBackend::memoryClock(int gpu) {
+    unsigned int mhz = 0;
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || nvmlDeviceGetClockInfo(dev, NVML_CLOCK_MEM, &mhz) != NVML_SUCCESS)
+        return -1;
+    return mhz;
+}
+
+int NvmlBackend::graphicsClock(int gpu) {
+    unsigned int mhz = 0;
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || nvmlDeviceGetClockInfo(dev, NVML_CLOCK_GRAPHICS, &mhz) != NVML_SUCCESS)
+        return -1;
+    return mhz;
+}
+
+bool NvmlBackend::memoryOffset(int gpu, int *mhz) {
+    nvmlDevice_t dev = device(gpu);
+    int offset = 0;
+    if (!dev || !nvmlDeviceGetMemClkVfOffset
+        || nvmlDeviceGetMemClkVfOffset(dev, &offset) != NVML_SUCCESS)
+        return fallback.memoryOffset(gpu, mhz);
+    // NVML reports the memory clock offset; nvidia-settings uses the
+    // transfer rate, which is twice that.
+    *mhz = offset * 2;
+    return true;
+}
+
+bool NvmlBackend::coreOffset(int gpu, int *mhz) {
+    nvmlDevice_t dev = device(gpu);
+    int offset = 0;
+    if (!dev || !nvmlDeviceGetGpcClkVfOffset
+        || nvmlDeviceGetGpcClkVfOffset(dev, &offset) != NVML_SUCCESS)
+        return fallback.coreOffset(gpu, mhz);
+    *mhz = offset;
+    return true;
+}
+
+bool NvmlBackend::memoryOffsetRange(int gpu, int *min, int *max) {
+    nvmlDevice_t dev = device(gpu);
+    int lo = 0, hi = 0;
+    if (!dev || !nvmlDeviceGetMemClkMinMaxVfOffset
+        || nvmlDeviceGetMemClkMinMaxVfOffset(dev, &lo, &hi) != NVML_SUCCESS)
+        return fallback.memoryOffsetRange(gpu, min, max);
+    *min = lo * 2;
+    *max = hi * 2;
+    return true;
+}
+
+bool NvmlBackend::coreOffsetRange(int gpu, int *min, int *max) {
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || !nvmlDeviceGetGpcClkMinMaxVfOffset
+        || nvmlDeviceGetGpcClkMinMaxVfOffset(dev, min, max) != NVML_SUCCESS)
+        return fallback.coreOffsetRange(gpu, min, max);
+    return true;
+}
+
+bool NvmlBackend::supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) {
+    nvmlDevice_t dev = device(gpu);
+    if (!dev || !nvmlDeviceGetSupportedMemoryClocks || !nvmlDeviceGetSupportedGraphicsClocks)
+        return fallback.supportedClocks(gpu, memory, graphics);
+
+    // Graphics clocks are listed per memory clock; offer their union
+    unsigned int memClocks[64];
+    unsigned int memCount = 64;
+    if (nvmlDeviceGetSupportedMemoryClocks(dev, &memCount, memClocks) != NVML_SUCCESS || memCount == 0)
+        return false;
+    QVector<int> mem, gfx;
+    for (unsigned int i = 0; i < memCount; ++i) {
+        mem.append(memClocks[i]);
+        unsigned int gfxClocks[512];
+        unsigned int gfxCount = 512;
+        if (nvmlDeviceGetSupportedGraphicsClocks(dev, memClocks[i], &gfxCount, gfxClocks) != NVML_SUCCESS)
+            continue;
+        for (unsigned int j = 0; j < gfxCount; ++j) {
+            if (!gfx.contains(int(gfxClocks[j])))
+                gfx.append(gfxClocks[j]);
+        }
+    }
+    if (gfx.isEmpty())
+        return false;
+    std::sort(mem.begin(), mem.end(), std::greater<int>());
+    std::sort(gfx.begin(), gfx.end(), std::greater<int>());
+    *memory = mem;
+    *graphics = gfx;
+    return true;
+}
+
+bool NvmlBackend::sample(int gpu, TelemetrySample *out) {
+    nvmlDevice_t dev = device(gpu);
+    if (!dev)
+        return false;
+
+    unsigned int value = 0;
+    out->gpu = gpu;
+    if (nvmlDeviceGetPowerUsage && nvmlDeviceGetPowerUsage(dev, &value) == NVML_SUCCESS)
+        out->powerDraw = value / 1000.0f;
+    if (nvmlDeviceGetClockInfo(dev, NVML_CLOCK_GRAPHICS, &value) == NVML_SUCCESS)
+        out->graphicsClock = value;
+    if (nvmlDeviceGetClockInfo(dev, NVML_CLOCK_MEM, &value) == NVML_SUCCESS)
+        out->memoryClock = value;
+    if (nvmlDeviceGetTemperature && nvmlDeviceGetTemperature(dev, NVML_TEMPERATURE_GPU, &value) == NVML_SUCCESS)
+        out->temperature = value;
+    nvmlUtilization_st util = {};
+    if (nvmlDeviceGetUtilizationRates && nvmlDeviceGetUtilizationRates(dev, &util) == NVML_SUCCESS) {
+        out->gpuUtilization = util.gpu;
+        out->memUtilization = util.memory;
+    }
+    unsigned long long reasons = 0;
+    if (nvmlDeviceGetCurrentClocksThrottleReasons
+        && nvmlDeviceGetCurrentClocksThrottleReasons(dev, &reasons) == NVML_SUCCESS)
+        out->throttleReasons = reasons;
+    return true;
+}
+
+NvmlBackend::Write NvmlBackend::write(int gpu, int field, const GpuSettings &settings, QString *error) {
+    nvmlDevice_t dev = device(gpu);
+    if (!dev && field == ApplyPowerLimit) {
+        if (error)
+            *error = QString("No such GPU: %1").arg(gpu);
+        return Failed;
+    }
+    bool graphicsReset = settings.graphicsLockMin == 0 && settings.graphicsLockMax == 0;
+    bool memoryReset = settings.memoryLockMin == 0 && settings.memoryLockMax == 0;
+    nvmlReturn_t ret;
+    switch (field) {
+    case ApplyPowerLimit:
+        ret = nvmlDeviceSetPowerManagementLimit(dev, settings.powerLimit * 1000);
+        break;
+    case ApplyMemoryOffset:
+        if (!dev || !nvmlDeviceSetMemClkVfOffset)
+            return NeedsFallback;
+        ret = nvmlDeviceSetMemClkVfOffset(dev, settings.memoryOffset / 2);
+        break;
+    case ApplyCoreOffset:
+        if (!dev || !nvmlDeviceSetGpcClkVfOffset)
+            return NeedsFallback;
+        ret = nvmlDeviceSetGpcClkVfOffset(dev, settings.coreOffset);
+        break;
+    case ApplyGraphicsLock:
+        if (!dev || !nvmlDeviceSetGpuLockedClocks || !nvmlDeviceResetGpuLockedClocks)
+            return NeedsFallback;
+        ret = graphicsReset ? nvmlDeviceResetGpuLockedClocks(dev)
+                            : nvmlDeviceSetGpuLockedClocks(dev, settings.graphicsLockMin, settings.graphicsLockMax);
+        // Nothing to undo on a board that cannot lock clocks
+        if (graphicsReset && ret == NVML_ERROR_NOT_SUPPORTED)
+            return Written;
+        break;
+    case ApplyMemoryLock:
+        if (!dev || !nvmlDeviceSetMemoryLockedClocks || !nvmlDeviceResetMemoryLockedClocks)
+            return NeedsFallback;
+        ret = memoryReset ? nvmlDeviceResetMemoryLockedClocks(dev)
+                          : nvmlDeviceSetMemoryLockedClocks(dev, settings.memoryLockMin, settings.memoryLockMax);
+        if (memoryReset && ret == NVML_ERROR_NOT_SUPPORTED)
+            return Written;
+        break;
+    default:
+        return Failed;
+    }
+    if (ret == NVML_SUCCESS)
+        return Written;
+    if (shouldFallBack(ret))
+        return NeedsFallback;
+    if (error)
+        *error = errorString(ret);
+    return Failed;
+}
+
+bool NvmlBackend::writeOne(int gpu, int field, const GpuSettings &settings, QString *error) {
+    Write result = write(gpu, field, settings, error);
+    if (result != NeedsFallback)
+        return result == Written;
+    switch (field) {
+    case ApplyPowerLimit:
+        return fallback.setPowerLimit(gpu, settings.powerLimit, error);
+    case ApplyMemoryOffset:
+        return fallback.setMemoryOffset(gpu, settings.memoryOffset, error);
+    case ApplyCoreOffset:
+        return fallback.setCoreOffset(gpu, settings.coreOffset, error);
+    case ApplyGraphicsLock:
+        return fallback.setGraphicsClockLock(gpu, settings.graphicsLockMin, settings.graphicsLockMax, error);
+    default:
+        return fallback.setMemoryClockLock(gpu, settings.memoryLockMin, settings.memoryLockMax, error);
+    }
+}
+
+bool NvmlBackend::setPowerLimit(int gpu, int watts, QString *error) {
+    GpuSettings settings;
+    settings.powerLimit = watts;
+    return writeOne(gpu, ApplyPowerLimit, settings, error);
+}
+
+bool NvmlBackend::setMemoryOffset(int gpu, int mhz, QString *error) {
+    GpuSettings settings;
+    settings.memoryOffset = mhz;
+    return writeOne(gpu, ApplyMemoryOffset, settings, error);
+}
+
+bool NvmlBackend::setCoreOffset(int gpu, int mhz, QString *error) {
+    GpuSettings settings;
+    settings.coreOffset = mhz;
+    return writeOne(gpu, ApplyCoreOffset, settings, error);
+}
+
+bool NvmlBackend::setGraphicsClockLock(int gpu, int min, int max, QString *error) {
+    GpuSettings settings;
+    settings.graphicsLockMin = min;
+    settings.graphicsLockMax = max;
+    return writeOne(gpu, ApplyGraphicsLock, settings, error);
+}
+
+bool NvmlBackend::setMemoryClockLock(int gpu, int min, int max, QString *error) {
+    GpuSettings settings;
+    settings.memoryLockMin = min;
+    settings.memoryLockMax = max;
+    return writeOne(gpu, ApplyMemoryLock, settings, error);
+}
+
+ApplyResult NvmlBackend::apply(int gpu, const GpuSettings &settings, int fields) {
+    // Whatever NVML cannot write here (no root, an older driver) goes to
+    // the subprocess backend in one batch, so it costs one round of
+    // privileged processes rather than one per attribute
+    static const struct {
+        int field;
+        const char *name;
+    } attributes[] = {
+        {ApplyPowerLimit, "Power limit"},
+        {ApplyMemoryOffset, "Memory offset"},
+        {ApplyCoreOffset, "Core offset"},
+        {ApplyGraphicsLock, "Graphics clock lock"},
+        {ApplyMemoryLock, "Memory clock lock"},
+    };
+    ApplyResult result;
+    int fallbackFields = 0;
+    for (const auto &attribute : attributes) {
+        if (!(fields & attribute.field))
+            continue;
+        QString error;
+        Write written = write(gpu, attribute.field, settings, &error);
+        if (written == NeedsFallback) {
+            fallbackFields |= attribute.field;
+        } else if (written == Failed) {
+            result.failedFields |= attribute.field;
+            result.errors << QString("%1: %2").arg(attribute.name, error);
+        }
+    }
+    if (fallbackFields) {
+        ApplyResult fallen = fallback.apply(gpu, settings, fallbackFields);
+        result.failedFields |= fallen.failedFields;
+        result.errors << fallen.errors;
+    }
+    return result;
+}
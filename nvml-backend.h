@@ -0,0 +1,98 @@
+#pragma once
+
+#include "gpu-backend.h"
+#include "smi-backend.h"
+
+#include <QVector>
+
+struct nvmlDevice_st;
+struct nvmlPciInfo_st;
+struct nvmlUtilization_st;
+
+// In-process backend that loads libnvidia-ml.so at runtime and calls NVML
+// directly. The library is initialised once and device handles are kept for
+// the lifetime of the backend. Writes that need root (or symbols missing from
+// older drivers) fall back to the subprocess backend.
+class NvmlBackend : public GpuBackend {
+public:
+    NvmlBackend();
+    ~NvmlBackend() override;
+
+    // False when the library or a required symbol could not be loaded.
+    bool isLoaded() const { return loaded; }
+
+    QString name() const override { return "nvml"; }
+    int deviceCount() override;
+
+    QString pciBusId(int gpu) override;
+    QString driverVersion() override;
+    QString gpuName(int gpu) override;
+    int minPowerLimit(int gpu) override;
+    int maxPowerLimit(int gpu) override;
+    int defaultPowerLimit(int gpu) override;
+    int powerLimit(int gpu) override;
+    int memoryClock(int gpu) override;
+    int graphicsClock(int gpu) override;
+    bool memoryOffset(int gpu, int *mhz) override;
+    bool coreOffset(int gpu, int *mhz) override;
+    bool memoryOffsetRange(int gpu, int *min, int *max) override;
+    bool coreOffsetRange(int gpu, int *min, int *max) override;
+    bool supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) override;
+    bool sample(int gpu, TelemetrySample *out) override;
+
+    bool setPowerLimit(int gpu, int watts, QString *error) override;
+    bool setMemoryOffset(int gpu, int mhz, QString *error) override;
+    bool setCoreOffset(int gpu, int mhz, QString *error) override;
+    bool setGraphicsClockLock(int gpu, int min, int max, QString *error) override;
+    bool setMemoryClockLock(int gpu, int min, int max, QString *error) override;
+    ApplyResult apply(int gpu, const GpuSettings &settings, int fields) override;
+
+private:
+    typedef int nvmlReturn_t;
+    typedef nvmlDevice_st *nvmlDevice_t;
+
+    enum Write { Written, Failed, NeedsFallback };
+
+    // One ApplyField through NVML; NeedsFallback when only the subprocess
+    // backend can do it
+    Write write(int gpu, int field, const GpuSettings &settings, QString *error);
+    bool writeOne(int gpu, int field, const GpuSettings &settings, QString *error);
+
+    nvmlDevice_t device(int gpu) const;
+    QString errorString(nvmlReturn_t ret) const;
+
+    void *lib = nullptr;
+    bool loaded = false;
+    QVector<nvmlDevice_t> devices;
+    SmiBackend fallback;
+
+    nvmlReturn_t (*nvmlInit)() = nullptr;
+    nvmlReturn_t (*nvmlShutdown)() = nullptr;
+    const char *(*nvmlErrorString)(nvmlReturn_t) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetCount)(unsigned int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetHandleByIndex)(unsigned int, nvmlDevice_t *) = nullptr;
+    nvmlReturn_t (*nvmlSystemGetDriverVersion)(char *, unsigned int) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetPciInfo)(nvmlDevice_t, nvmlPciInfo_st *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetName)(nvmlDevice_t, char *, unsigned int) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetPowerManagementLimit)(nvmlDevice_t, unsigned int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetPowerManagementDefaultLimit)(nvmlDevice_t, unsigned int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetPowerManagementLimitConstraints)(nvmlDevice_t, unsigned int *, unsigned int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceSetPowerManagementLimit)(nvmlDevice_t, unsigned int) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetClockInfo)(nvmlDevice_t, int, unsigned int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetPowerUsage)(nvmlDevice_t, unsigned int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetTemperature)(nvmlDevice_t, int, unsigned int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetUtilizationRates)(nvmlDevice_t, nvmlUtilization_st *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetCurrentClocksThrottleReasons)(nvmlDevice_t, unsigned long long *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetMemClkVfOffset)(nvmlDevice_t, int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceSetMemClkVfOffset)(nvmlDevice_t, int) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetGpcClkVfOffset)(nvmlDevice_t, int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceSetGpcClkVfOffset)(nvmlDevice_t, int) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetMemClkMinMaxVfOffset)(nvmlDevice_t, int *, int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetGpcClkMinMaxVfOffset)(nvmlDevice_t, int *, int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetSupportedMemoryClocks)(nvmlDevice_t, unsigned int *, unsigned int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceGetSupportedGraphicsClocks)(nvmlDevice_t, unsigned int, unsigned int *, unsigned int *) = nullptr;
+    nvmlReturn_t (*nvmlDeviceSetGpuLockedClocks)(nvmlDevice_t, unsigned int, unsigned int) = nullptr;
+    nvmlReturn_t (*nvmlDeviceResetGpuLockedClocks)(nvmlDevice_t) = nullptr;
+    nvmlReturn_t (*nvmlDeviceSetMemoryLockedClocks)(nvmlDevice_t, unsigned int, unsigned int) = nullptr;
+    nvmlReturn_t (*nvmlDeviceResetMemoryLockedClocks)(nvmlDevice_t) = nullptr;
+};
@@ -0,0 +1,208 @@
+#include "offset-tuner-dialog.h"
+
+#include <QCheckBox>
+#include <QColor>
+#include <QFile>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTableWidget>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+
+OffsetTunerDialog::OffsetTunerDialog(GpuBackend *backend, MockBackend *simulator, int gpu, const QString &pciBusId,
+                                     int coreMax, int memoryMax, const std::function<void(int, int)> &onUse,
+                                     QWidget *parent)
+    : QDialog(parent), backend(backend), simulator(simulator), gpu(gpu), onUse(onUse) {
+    setWindowTitle(QString("Offset Tuner - GPU %1").arg(gpu));
+    resize(600, 620);
+    logPath = OffsetTuner::logPath(pciBusId.isEmpty() ? QString("gpu%1").arg(gpu) : pciBusId);
+
+    auto spin = [](int min, int max, int value, int step, const char *suffix) {
+        auto *box = new QSpinBox();
+        box->setRange(min, max);
+        box->setValue(value);
+        box->setSingleStep(step);
+        box->setSuffix(suffix);
+        return box;
+    };
+
+    auto *layout = new QVBoxLayout(this);
+    auto *form = new QFormLayout();
+    commandEdit = new QLineEdit();
+    commandEdit->setPlaceholderText("Validation command, exit 0 = stable (empty: simulated, mock backend only)");
+    patternEdit = new QLineEdit();
+    patternEdit->setPlaceholderText("Throughput regex with one group (default: last number printed)");
+    timeoutSpin = spin(5, 3600, 120, 5, " s");
+    form->addRow("Command:", commandEdit);
+    form->addRow("Throughput:", patternEdit);
+    form->addRow("Timeout:", timeoutSpin);
+
+    auto *coreRow = new QHBoxLayout();
+    coreCheck = new QCheckBox("Tune");
+    coreCheck->setChecked(true);
+    coreMaxSpin = spin(0, qMax(0, coreMax), qMax(0, coreMax), 15, " MHz max");
+    coreStepSpin = spin(5, 200, 15, 5, " MHz step");
+    coreRow->addWidget(coreCheck);
+    coreRow->addWidget(coreMaxSpin);
+    coreRow->addWidget(coreStepSpin);
+    form->addRow("Core:", coreRow);
+
+    auto *memoryRow = new QHBoxLayout();
+    memoryCheck = new QCheckBox("Tune");
+    memoryCheck->setChecked(true);
+    memoryMaxSpin = spin(0, qMax(0, memoryMax), qMax(0, memoryMax), 100, " max");
+    memoryStepSpin = spin(20, 1000, 100, 20, " step");
+    memoryRow->addWidget(memoryCheck);
+    memoryRow->addWidget(memoryMaxSpin);
+    memoryRow->addWidget(memoryStepSpin);
+    form->addRow("Memory:", memoryRow);
+    layout->addLayout(form);
+
+    table = new QTableWidget(0, 4);
+    table->setHorizontalHeaderLabels(QStringList() << "Core" << "Memory" << "Result" << "Throughput");
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->verticalHeader()->setVisible(false);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    layout->addWidget(table, 1);
+
+    resultLabel = new QLabel();
+    resultLabel->setWordWrap(true);
+    resultLabel->setStyleSheet("font-size: 13px; font-weight: bold;");
+    if (QFile::exists(logPath))
+        resultLabel->setText("An earlier run was logged; starting with the same command resumes it.");
+    layout->addWidget(resultLabel);
+
+    auto *buttons = new QHBoxLayout();
+    startBtn = new QPushButton("Start");
+    forgetBtn = new QPushButton("Forget Log");
+    forgetBtn->setEnabled(QFile::exists(logPath));
+    useBtn = new QPushButton("Use Result");
+    useBtn->setEnabled(false);
+    auto *closeBtn = new QPushButton("Close");
+    buttons->addWidget(startBtn);
+    buttons->addWidget(forgetBtn);
+    buttons->addStretch();
+    buttons->addWidget(useBtn);
+    buttons->addWidget(closeBtn);
+    layout->addLayout(buttons);
+
+    connect(startBtn, &QPushButton::clicked, this, &OffsetTunerDialog::start);
+    connect(closeBtn, &QPushButton::clicked, this, &OffsetTunerDialog::reject);
+    connect(forgetBtn, &QPushButton::clicked, [this]() {
+        QFile::remove(logPath);
+        forgetBtn->setEnabled(false);
+        resultLabel->clear();
+    });
+    connect(useBtn, &QPushButton::clicked, [this]() {
+        TunerResult result = watcher.result();
+        if (this->onUse)
+            this->onUse(result.coreOffset, result.memoryOffset);
+        accept();
+    });
+    connect(&watcher, &QFutureWatcherBase::finished, this, &OffsetTunerDialog::finished);
+}
+
+OffsetTunerDialog::~OffsetTunerDialog() {
+    cancel = true;
+    watcher.waitForFinished();
+}
+
+void OffsetTunerDialog::reject() {
+    // A probe can't be interrupted safely; close once the current one is done
+    if (watcher.isRunning()) {
+        cancel = true;
+        closeWhenDone = true;
+        resultLabel->setText("Stopping after the current probe...");
+        return;
+    }
+    QDialog::reject();
+}
+
+void OffsetTunerDialog::start() {
+    if (watcher.isRunning()) {
+        cancel = true;
+        startBtn->setEnabled(false);
+        resultLabel->setText("Stopping after the current probe...");
+        return;
+    }
+
+    TunerOptions options;
+    options.gpu = gpu;
+    QString command = commandEdit->text().trimmed();
+    QString pattern = patternEdit->text().trimmed();
+    int timeoutMs = timeoutSpin->value() * 1000;
+    if (command.isEmpty() && !simulator) {
+        resultLabel->setText("Enter a validation command; only the mock backend can simulate one");
+        return;
+    }
+    options.tuneCore = coreCheck->isChecked();
+    options.coreMax = coreMaxSpin->value();
+    options.coreStep = coreStepSpin->value();
+    options.tuneMemory = memoryCheck->isChecked();
+    options.memoryMax = memoryMaxSpin->value();
+    options.memoryStep = memoryStepSpin->value();
+    options.logPath = logPath;
+
+    table->setRowCount(0);
+    useBtn->setEnabled(false);
+    forgetBtn->setEnabled(false);
+    startBtn->setText("Stop");
+    resultLabel->setText("Tuning...");
+    cancel = false;
+
+    GpuBackend *b = backend;
+    MockBackend *mock = simulator;
+    std::atomic<bool> *stop = &cancel;
+    watcher.setFuture(QtConcurrent::run([this, b, mock, command, pattern, timeoutMs, options, stop]() {
+        QScopedPointer<Workload> workload(Workload::create(command, pattern, timeoutMs, mock, options.gpu, 1000));
+        OffsetTuner tuner(b, workload.data(), options);
+        return tuner.run([this](const TunerProbe &probe) {
+            QMetaObject::invokeMethod(this, [this, probe]() { addProbe(probe); }, Qt::QueuedConnection);
+        }, *stop);
+    }));
+}
+
+void OffsetTunerDialog::addProbe(const TunerProbe &probe) {
+    int row = table->rowCount();
+    table->insertRow(row);
+    table->setItem(row, 0, new QTableWidgetItem(QString("%1").arg(probe.coreOffset)));
+    table->setItem(row, 1, new QTableWidgetItem(QString("%1").arg(probe.memoryOffset)));
+    QString status = probe.passed ? QString("Pass") : "Fail: " + probe.detail;
+    if (probe.fromLog)
+        status += " (logged)";
+    auto *result = new QTableWidgetItem(status);
+    result->setForeground(probe.passed ? QColor("#4CAF50") : QColor("#e74c3c"));
+    result->setToolTip(probe.detail);
+    table->setItem(row, 2, result);
+    table->setItem(row, 3, new QTableWidgetItem(probe.throughput >= 0 ? QString::number(probe.throughput, 'f', 1)
+                                                                       : QString("-")));
+    table->scrollToBottom();
+}
+
+void OffsetTunerDialog::finished() {
+    startBtn->setText("Start");
+    startBtn->setEnabled(true);
+    forgetBtn->setEnabled(QFile::exists(logPath));
+    if (closeWhenDone) {
+        QDialog::reject();
+        return;
+    }
+
+    TunerResult result = watcher.result();
+    if (!result.error.isEmpty()) {
+        resultLabel->setText(result.error);
+        return;
+    }
+    QString text = QString("Best stable: core +%1 MHz, memory +%2").arg(result.coreOffset).arg(result.memoryOffset);
+    if (result.throughput >= 0)
+        text += QString("  (%1)").arg(result.throughput, 0, 'f', 1);
+    if (cancel)
+        text += "  - stopped early; start again to resume";
+    resultLabel->setText(text);
+    useBtn->setEnabled(true);
+}
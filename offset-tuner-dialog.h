@@ -0,0 +1,59 @@
+#pragma once
+
+#include "offset-tuner.h"
+
+#include <QDialog>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <functional>
+
+class MockBackend;
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QSpinBox;
+class QTableWidget;
+
+// Runs an OffsetTuner for one GPU on a worker thread, listing each probe as
+// it finishes. onUse receives the winning core and memory offsets.
+// simulator, when set, runs a simulated workload if no command is given.
+class OffsetTunerDialog : public QDialog {
+public:
+    OffsetTunerDialog(GpuBackend *backend, MockBackend *simulator, int gpu, const QString &pciBusId, int coreMax, int memoryMax,
+                      const std::function<void(int, int)> &onUse, QWidget *parent = nullptr);
+    ~OffsetTunerDialog() override;
+
+protected:
+    void reject() override;
+
+private:
+    void start();
+    void addProbe(const TunerProbe &probe);
+    void finished();
+
+    GpuBackend *backend;
+    MockBackend *simulator;
+    int gpu;
+    QString logPath;
+    std::function<void(int, int)> onUse;
+    std::atomic<bool> cancel{false};
+    bool closeWhenDone = false;
+    QFutureWatcher<TunerResult> watcher;
+
+    QLineEdit *commandEdit;
+    QLineEdit *patternEdit;
+    QSpinBox *timeoutSpin;
+    QCheckBox *coreCheck;
+    QSpinBox *coreMaxSpin;
+    QSpinBox *coreStepSpin;
+    QCheckBox *memoryCheck;
+    QSpinBox *memoryMaxSpin;
+    QSpinBox *memoryStepSpin;
+    QTableWidget *table;
+    QLabel *resultLabel;
+    QPushButton *startBtn;
+    QPushButton *useBtn;
+    QPushButton *forgetBtn;
+};
@@ -0,0 +1,221 @@
+#include "offset-tuner.h"
+#include "tracer.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTextStream>
+#include <QThread>
+
+#include <unistd.h>
+
+OffsetTuner::OffsetTuner(GpuBackend *backend, Workload *workload, const TunerOptions &options)
+    : backend(backend), workload(workload), options(options) {
+    this->options.coreStep = qMax(1, options.coreStep);
+    this->options.memoryStep = qMax(1, options.memoryStep);
+}
+
+QString OffsetTuner::logPath(const QString &pciBusId) {
+    QString key = pciBusId;
+    key.replace(QRegularExpression("[^A-Za-z0-9._-]"), "_");
+    return QDir::homePath() + "/.cache/gpu-control/tuner-" + key + ".log";
+}
+
+TunerResult OffsetTuner::run(const std::function<void(const TunerProbe &)> &progress,
+                             const std::atomic<bool> &cancel) {
+    // Put back whatever was live, also after a failure or cancel; an
+    // offset that cannot be read goes back to stock
+    int originalCore = 0;
+    int originalMemory = 0;
+    if (!backend->coreOffset(options.gpu, &originalCore))
+        originalCore = 0;
+    if (!backend->memoryOffset(options.gpu, &originalMemory))
+        originalMemory = 0;
+
+    TunerResult result = tune(progress, cancel);
+    apply(originalCore, originalMemory);
+    return result;
+}
+
+TunerResult OffsetTuner::tune(const std::function<void(const TunerProbe &)> &progress,
+                              const std::atomic<bool> &cancel) {
+    TunerResult result;
+    loadLog();
+
+    // Stock offsets have to pass or nothing else means anything
+    TunerProbe stock = probe(0, 0);
+    result.probes.append(stock);
+    if (progress)
+        progress(stock);
+    if (!stock.passed) {
+        result.error = "Validation fails at stock offsets: " + stock.detail;
+        return result;
+    }
+    result.throughput = stock.throughput;
+
+    if (options.tuneCore && !cancel)
+        result.coreOffset = search(true, 0, options.coreMax, options.coreStep, &result, progress, cancel);
+    if (options.tuneMemory && !cancel)
+        result.memoryOffset = search(false, result.coreOffset, options.memoryMax, options.memoryStep,
+                                     &result, progress, cancel);
+
+    for (const TunerProbe &p : result.probes) {
+        if (p.coreOffset == result.coreOffset && p.memoryOffset == result.memoryOffset)
+            result.throughput = p.throughput;
+    }
+    return result;
+}
+
+int OffsetTuner::search(bool core, int fixedOther, int max, int step, TunerResult *result,
+                        const std::function<void(const TunerProbe &)> &progress,
+                        const std::atomic<bool> &cancel) {
+    // Largest passing index in [0, max / step]; index 0 is stock and passed
+    int lo = 0;
+    int hi = qMax(0, max / step);
+    QVector<TunerProbe> axis;
+    axis.append(known.value(core ? Key(0, fixedOther) : Key(fixedOther, 0)));
+
+    while (lo < hi && !cancel) {
+        int mid = (lo + hi + 1) / 2;
+        TunerProbe p = core ? probe(mid * step, fixedOther) : probe(fixedOther, mid * step);
+        result->probes.append(p);
+        axis.append(p);
+        if (progress)
+            progress(p);
+        if (p.passed)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    // Fastest passing probe when throughput is known, otherwise the highest
+    int best = 0;
+    double bestThroughput = -1;
+    for (const TunerProbe &p : axis) {
+        if (!p.passed)
+            continue;
+        int offset = core ? p.coreOffset : p.memoryOffset;
+        if (p.throughput > bestThroughput || (p.throughput == bestThroughput && offset > best)) {
+            best = offset;
+            bestThroughput = p.throughput;
+        }
+    }
+    return best;
+}
+
+bool OffsetTuner::apply(int core, int memory) {
+    GpuSettings settings;
+    settings.coreOffset = core;
+    settings.memoryOffset = memory;
+    return backend->apply(options.gpu, settings, ApplyCoreOffset | ApplyMemoryOffset).ok();
+}
+
+TunerProbe OffsetTuner::probe(int core, int memory) {
+    auto it = known.constFind(Key(core, memory));
+    if (it != known.constEnd()) {
+        TunerProbe p = *it;
+        p.fromLog = true;
+        if (p.passed) {
+            goodCore = core;
+            goodMemory = memory;
+        }
+        return p;
+    }
+
+    TraceSpan span("tuner probe", "tuner", QString("gpu %1 core %2 memory %3").arg(options.gpu).arg(core).arg(memory));
+    appendLog(QString("try %1 %2").arg(core).arg(memory));
+
+    TunerProbe p;
+    p.coreOffset = core;
+    p.memoryOffset = memory;
+    GpuSettings settings;
+    settings.coreOffset = core;
+    settings.memoryOffset = memory;
+    ApplyResult applied = backend->apply(options.gpu, settings, ApplyCoreOffset | ApplyMemoryOffset);
+    if (!applied.ok()) {
+        p.detail = applied.errors.join("; ");
+    } else {
+        QThread::msleep(options.settleMs);
+        WorkloadRun run = workload->run(100, std::function<void()>());
+        p.passed = run.ok;
+        p.throughput = run.throughput;
+        p.detail = run.error;
+    }
+
+    appendLog(QString("result %1 %2 %3 %4 %5").arg(core).arg(memory).arg(p.passed ? 1 : 0)
+              .arg(p.throughput).arg(p.detail.simplified()));
+    known.insert(Key(core, memory), p);
+    span.setExitCode(p.passed ? 0 : 1);
+
+    if (p.passed) {
+        goodCore = core;
+        goodMemory = memory;
+    } else {
+        // Back to the last offsets that worked before anything else runs
+        apply(goodCore, goodMemory);
+    }
+    return p;
+}
+
+void OffsetTuner::loadLog() {
+    if (options.logPath.isEmpty())
+        return;
+
+    QString header = "command " + workload->description();
+    QFile file(options.logPath);
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream in(&file);
+        // A log for a different command says nothing about this one
+        if (in.readLine() != header) {
+            file.close();
+            file.remove();
+        } else {
+            QSet<Key> started;
+            while (!in.atEnd()) {
+                QStringList parts = in.readLine().split(' ');
+                if (parts.size() < 3)
+                    continue;
+                Key key(parts[1].toInt(), parts[2].toInt());
+                if (parts[0] == "try") {
+                    started.insert(key);
+                } else if (parts[0] == "result" && parts.size() >= 5) {
+                    started.remove(key);
+                    TunerProbe p;
+                    p.coreOffset = key.first;
+                    p.memoryOffset = key.second;
+                    p.passed = parts[3] == "1";
+                    p.throughput = parts[4].toDouble();
+                    p.detail = parts.mid(5).join(' ');
+                    known.insert(key, p);
+                }
+            }
+            // Started and never finished: the machine went down with it
+            for (const Key &key : started) {
+                TunerProbe p;
+                p.coreOffset = key.first;
+                p.memoryOffset = key.second;
+                p.detail = "Interrupted; assumed unstable";
+                known.insert(key, p);
+                appendLog(QString("result %1 %2 0 -1 %3").arg(key.first).arg(key.second).arg(p.detail));
+            }
+            return;
+        }
+    }
+
+    QDir().mkpath(QFileInfo(options.logPath).absolutePath());
+    appendLog(header);
+}
+
+void OffsetTuner::appendLog(const QString &line) {
+    if (options.logPath.isEmpty())
+        return;
+    QFile file(options.logPath);
+    if (!file.open(QIODevice::Append | QIODevice::Text))
+        return;
+    // Flushed per line so a hang mid-probe still leaves the "try" behind
+    file.write((line + "\n").toUtf8());
+    file.flush();
+    fsync(file.handle());
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "gpu-backend.h"
+#include "workload.h"
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+
+struct TunerOptions {
+    int gpu = 0;
+    int settleMs = 1000;
+    bool tuneCore = true;
+    bool tuneMemory = true;
+    int coreMax = 1000;
+    int coreStep = 15;
+    int memoryMax = 6000;
+    int memoryStep = 100;
+    QString logPath;            // Empty: no persistence
+};
+
+struct TunerProbe {
+    int coreOffset = 0;
+    int memoryOffset = 0;
+    bool passed = false;
+    double throughput = -1;     // -1 when the command printed none
+    QString detail;             // Why it failed
+    bool fromLog = false;       // Replayed from an earlier run
+};
+
+struct TunerResult {
+    int coreOffset = 0;
+    int memoryOffset = 0;
+    double throughput = -1;
+    QString error;              // Set when the search could not start
+    QVector<TunerProbe> probes;
+};
+
+// Binary-searches the highest stable core offset, then the highest stable
+// memory offset with that core offset, upwards from stock. Each probe
+// applies both offsets through the backend's apply() and runs the workload
+// once; a failure or timeout immediately re-applies the last passing
+// offsets. Among passing probes the fastest one wins when the workload
+// reports throughput, otherwise the highest. When run() returns, the GPU is
+// back at the offsets it had before; applying the result is up to the caller.
+//
+// Every probe is appended to a log before and after it runs. A rerun with
+// the same workload replays logged results instead of repeating them, and a
+// probe that was started but never finished (the machine hung) counts as a
+// failure.
+class OffsetTuner {
+public:
+    OffsetTuner(GpuBackend *backend, Workload *workload, const TunerOptions &options);
+
+    TunerResult run(const std::function<void(const TunerProbe &)> &progress,
+                    const std::atomic<bool> &cancel);
+
+    // Per-board log location under ~/.cache/gpu-control
+    static QString logPath(const QString &pciBusId);
+
+private:
+    typedef QPair<int, int> Key;    // core, memory
+
+    TunerResult tune(const std::function<void(const TunerProbe &)> &progress, const std::atomic<bool> &cancel);
+    TunerProbe probe(int core, int memory);
+    int search(bool core, int fixedOther, int max, int step, TunerResult *result,
+               const std::function<void(const TunerProbe &)> &progress, const std::atomic<bool> &cancel);
+    bool apply(int core, int memory);
+    void loadLog();
+    void appendLog(const QString &line);
+
+    GpuBackend *backend;
+    Workload *workload;
+    TunerOptions options;
+    QHash<Key, TunerProbe> known;
+    int goodCore = 0;
+    int goodMemory = 0;
+};
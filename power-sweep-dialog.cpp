@@ -0,0 +1,241 @@
+#include "power-sweep-dialog.h"
+
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPainter>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTableWidget>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+
+SweepChart::SweepChart(QWidget *parent) : QWidget(parent) {
+    setMinimumHeight(160);
+}
+
+void SweepChart::setPoints(const QVector<SweepPoint> &points, int knee) {
+    this->points = points;
+    this->knee = knee;
+    update();
+}
+
+void SweepChart::paintEvent(QPaintEvent *) {
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.fillRect(rect(), QColor("#1e1e1e"));
+
+    QVector<const SweepPoint *> valid;
+    double maxEfficiency = 0;
+    int minPower = 0, maxPower = 0;
+    for (const SweepPoint &point : points) {
+        if (!point.ok())
+            continue;
+        if (valid.isEmpty() || point.powerLimit < minPower)
+            minPower = point.powerLimit;
+        if (valid.isEmpty() || point.powerLimit > maxPower)
+            maxPower = point.powerLimit;
+        maxEfficiency = qMax(maxEfficiency, point.perfPerWatt());
+        valid.append(&point);
+    }
+    if (valid.size() < 2 || maxEfficiency <= 0 || maxPower == minPower)
+        return;
+
+    QRectF area = QRectF(rect()).adjusted(40, 10, -10, -24);
+    auto map = [&](const SweepPoint &point) {
+        double x = area.left() + area.width() * (point.powerLimit - minPower) / double(maxPower - minPower);
+        double y = area.bottom() - area.height() * point.perfPerWatt() / maxEfficiency;
+        return QPointF(x, y);
+    };
+
+    painter.setPen(QColor("#666"));
+    painter.drawLine(area.bottomLeft(), area.bottomRight());
+    painter.drawText(QRectF(area.left(), area.bottom() + 4, 80, 16), Qt::AlignLeft, QString("%1 W").arg(minPower));
+    painter.drawText(QRectF(area.right() - 80, area.bottom() + 4, 80, 16), Qt::AlignRight, QString("%1 W").arg(maxPower));
+    painter.drawText(QRectF(0, area.top(), 36, 16), Qt::AlignRight, "perf/W");
+
+    QPolygonF line;
+    for (const SweepPoint *point : valid)
+        line << map(*point);
+    painter.setPen(QPen(QColor("#76b900"), 2));
+    painter.drawPolyline(line);
+
+    if (knee >= 0 && knee < points.size() && points[knee].ok()) {
+        QPointF at = map(points[knee]);
+        painter.setPen(QPen(QColor("#e67e22"), 1, Qt::DashLine));
+        painter.drawLine(QPointF(at.x(), area.top()), QPointF(at.x(), area.bottom()));
+        painter.setBrush(QColor("#e67e22"));
+        painter.drawEllipse(at, 4, 4);
+        painter.drawText(QPointF(at.x() + 6, area.top() + 12), QString("%1 W").arg(points[knee].powerLimit));
+    }
+}
+
+PowerSweepDialog::PowerSweepDialog(GpuBackend *backend, MockBackend *simulator, int gpu, int minPower,
+                                   int maxPower, const std::function<void(int)> &onSave, QWidget *parent)
+    : QDialog(parent), backend(backend), simulator(simulator), gpu(gpu), onSave(onSave) {
+    setWindowTitle(QString("Power Sweep - GPU %1").arg(gpu));
+    resize(560, 640);
+
+    auto *layout = new QVBoxLayout(this);
+    auto *form = new QFormLayout();
+    commandEdit = new QLineEdit();
+    commandEdit->setPlaceholderText("Benchmark command (empty: simulated workload, mock backend only)");
+    patternEdit = new QLineEdit();
+    patternEdit->setPlaceholderText("Throughput regex with one group (default: last number printed)");
+    minSpin = new QSpinBox();
+    minSpin->setRange(minPower, maxPower);
+    minSpin->setValue(minPower);
+    minSpin->setSuffix(" W");
+    maxSpin = new QSpinBox();
+    maxSpin->setRange(minPower, maxPower);
+    maxSpin->setValue(maxPower);
+    maxSpin->setSuffix(" W");
+    stepSpin = new QSpinBox();
+    stepSpin->setRange(5, 200);
+    stepSpin->setValue(25);
+    stepSpin->setSuffix(" W");
+    settleSpin = new QSpinBox();
+    settleSpin->setRange(0, 60000);
+    settleSpin->setSingleStep(500);
+    settleSpin->setValue(2000);
+    settleSpin->setSuffix(" ms");
+    form->addRow("Command:", commandEdit);
+    form->addRow("Throughput:", patternEdit);
+    form->addRow("From:", minSpin);
+    form->addRow("To:", maxSpin);
+    form->addRow("Step:", stepSpin);
+    form->addRow("Settle:", settleSpin);
+    layout->addLayout(form);
+
+    chart = new SweepChart();
+    layout->addWidget(chart);
+
+    table = new QTableWidget(0, 4);
+    table->setHorizontalHeaderLabels(QStringList() << "Limit" << "Throughput" << "Mean draw" << "perf/W");
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->verticalHeader()->setVisible(false);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    layout->addWidget(table, 1);
+
+    resultLabel = new QLabel();
+    resultLabel->setStyleSheet("font-size: 13px; font-weight: bold;");
+    layout->addWidget(resultLabel);
+
+    auto *buttons = new QHBoxLayout();
+    startBtn = new QPushButton("Start");
+    saveBtn = new QPushButton("Save Knee as Preset");
+    saveBtn->setEnabled(false);
+    auto *closeBtn = new QPushButton("Close");
+    buttons->addWidget(startBtn);
+    buttons->addStretch();
+    buttons->addWidget(saveBtn);
+    buttons->addWidget(closeBtn);
+    layout->addLayout(buttons);
+
+    connect(startBtn, &QPushButton::clicked, this, &PowerSweepDialog::start);
+    connect(closeBtn, &QPushButton::clicked, this, &PowerSweepDialog::reject);
+    connect(saveBtn, &QPushButton::clicked, [this]() {
+        int knee = PowerSweep::kneeIndex(points);
+        if (knee < 0)
+            return;
+        if (this->onSave)
+            this->onSave(points[knee].powerLimit);
+        resultLabel->setText(QString("Saved %1 W as the Efficient preset").arg(points[knee].powerLimit));
+    });
+    connect(&watcher, &QFutureWatcherBase::finished, this, &PowerSweepDialog::finished);
+}
+
+PowerSweepDialog::~PowerSweepDialog() {
+    cancel = true;
+    watcher.waitForFinished();
+}
+
+void PowerSweepDialog::reject() {
+    // A step can't be interrupted; close once the current one is done
+    if (watcher.isRunning()) {
+        cancel = true;
+        closeWhenDone = true;
+        resultLabel->setText("Stopping after the current step...");
+        return;
+    }
+    QDialog::reject();
+}
+
+void PowerSweepDialog::start() {
+    if (watcher.isRunning()) {
+        cancel = true;
+        startBtn->setEnabled(false);
+        resultLabel->setText("Stopping after the current step...");
+        return;
+    }
+
+    SweepOptions options;
+    options.gpu = gpu;
+    options.minPower = minSpin->value();
+    options.maxPower = maxSpin->value();
+    options.step = stepSpin->value();
+    options.settleMs = settleSpin->value();
+    QString command = commandEdit->text().trimmed();
+    QString pattern = patternEdit->text().trimmed();
+    if (command.isEmpty() && !simulator) {
+        resultLabel->setText("Enter a benchmark command; only the mock backend can simulate one");
+        return;
+    }
+
+    points.clear();
+    table->setRowCount(0);
+    chart->setPoints(points, -1);
+    saveBtn->setEnabled(false);
+    startBtn->setText("Stop");
+    resultLabel->setText("Sweeping...");
+    cancel = false;
+
+    GpuBackend *b = backend;
+    MockBackend *mock = simulator;
+    std::atomic<bool> *stop = &cancel;
+    watcher.setFuture(QtConcurrent::run([this, b, mock, command, pattern, options, stop]() {
+        QScopedPointer<Workload> workload(Workload::create(command, pattern, 600000, mock, options.gpu, 3000));
+        PowerSweep sweep(b, workload.data(), options);
+        return sweep.run([this](const SweepPoint &point) {
+            QMetaObject::invokeMethod(this, [this, point]() { addPoint(point); }, Qt::QueuedConnection);
+        }, *stop);
+    }));
+}
+
+void PowerSweepDialog::addPoint(const SweepPoint &point) {
+    points.append(point);
+    int row = table->rowCount();
+    table->insertRow(row);
+    table->setItem(row, 0, new QTableWidgetItem(QString("%1 W").arg(point.powerLimit)));
+    if (point.ok()) {
+        table->setItem(row, 1, new QTableWidgetItem(QString::number(point.throughput, 'f', 1)));
+        table->setItem(row, 2, new QTableWidgetItem(QString("%1 W").arg(point.meanPowerDraw, 0, 'f', 1)));
+        table->setItem(row, 3, new QTableWidgetItem(QString::number(point.perfPerWatt(), 'f', 3)));
+    } else {
+        auto *error = new QTableWidgetItem(point.error);
+        table->setItem(row, 1, error);
+        table->setSpan(row, 1, 1, 3);
+    }
+    chart->setPoints(points, PowerSweep::kneeIndex(points));
+}
+
+void PowerSweepDialog::finished() {
+    startBtn->setText("Start");
+    startBtn->setEnabled(true);
+    if (closeWhenDone) {
+        QDialog::reject();
+        return;
+    }
+
+    int knee = PowerSweep::kneeIndex(points);
+    if (knee < 0) {
+        resultLabel->setText("No step produced a measurement");
+        return;
+    }
+    const SweepPoint &best = points[knee];
+    resultLabel->setText(QString("Knee: %1 W  (%2 perf/W, %3 W mean draw)")
+        .arg(best.powerLimit).arg(best.perfPerWatt(), 0, 'f', 3).arg(best.meanPowerDraw, 0, 'f', 1));
+    saveBtn->setEnabled(true);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "power-sweep.h"
+
+#include <QDialog>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <functional>
+
+class MockBackend;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QSpinBox;
+class QTableWidget;
+
+// perf/W against power limit, knee marked
+class SweepChart : public QWidget {
+public:
+    explicit SweepChart(QWidget *parent = nullptr);
+
+    void setPoints(const QVector<SweepPoint> &points, int knee);
+
+    QSize sizeHint() const override { return QSize(480, 200); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QVector<SweepPoint> points;
+    int knee = -1;
+};
+
+// Runs a PowerSweep for one GPU on a worker thread and shows the curve as it
+// fills in. onSave receives the knee's power limit. simulator, when set,
+// runs a simulated workload if no benchmark command is given.
+class PowerSweepDialog : public QDialog {
+public:
+    PowerSweepDialog(GpuBackend *backend, MockBackend *simulator, int gpu, int minPower, int maxPower,
+                     const std::function<void(int)> &onSave, QWidget *parent = nullptr);
+    ~PowerSweepDialog() override;
+
+protected:
+    void reject() override;
+
+private:
+    void start();
+    void addPoint(const SweepPoint &point);
+    void finished();
+
+    GpuBackend *backend;
+    MockBackend *simulator;
+    int gpu;
+    std::function<void(int)> onSave;
+    std::atomic<bool> cancel{false};
+    bool closeWhenDone = false;
+    QFutureWatcher<QVector<SweepPoint>> watcher;
+    QVector<SweepPoint> points;
+
+    QLineEdit *commandEdit;
+    QLineEdit *patternEdit;
+    QSpinBox *minSpin;
+    QSpinBox *maxSpin;
+    QSpinBox *stepSpin;
+    QSpinBox *settleSpin;
+    QTableWidget *table;
+    SweepChart *chart;
+    QLabel *resultLabel;
+    QPushButton *startBtn;
+    QPushButton *saveBtn;
+};
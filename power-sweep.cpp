@@ -0,0 +1,111 @@
+#include "power-sweep.h"
+#include "telemetry.h"
+#include "tracer.h"
+
+#include <QThread>
+
+namespace {
+
+const int SAMPLE_MS = 100;
+
+// Running mean of one GPU's power draw, fed from a sampler's ring
+struct PowerMeter {
+    int gpu;
+    double sum = 0;
+    int count = 0;
+
+    void drain(TelemetrySampler *sampler) {
+        TelemetrySample sample;
+        while (sampler->samples().pop(&sample)) {
+            if (sample.gpu == gpu && sample.powerDraw > 0) {
+                sum += sample.powerDraw;
+                ++count;
+            }
+        }
+    }
+
+    double mean() const { return count ? sum / count : -1; }
+};
+
+}
+
+PowerSweep::PowerSweep(GpuBackend *backend, Workload *workload, const SweepOptions &options)
+    : backend(backend), workload(workload), options(options) {
+    this->options.step = qMax(1, options.step);
+}
+
+QVector<SweepPoint> PowerSweep::run(const std::function<void(const SweepPoint &)> &progress,
+                                    const std::atomic<bool> &cancel) {
+    QVector<SweepPoint> points;
+    int original = backend->powerLimit(options.gpu);
+
+    QVector<int> limits;
+    for (int limit = options.minPower; limit < options.maxPower; limit += options.step)
+        limits.append(limit);
+    // The last step is maxPower even when the range isn't a multiple of step
+    if (options.maxPower >= options.minPower)
+        limits.append(options.maxPower);
+
+    // One sampler, on the swept GPU only, for every step
+    TelemetrySampler sampler(backend, options.gpu + 1, SAMPLE_MS);
+    sampler.setGpu(options.gpu);
+    sampler.start();
+    for (int i = 0; i < limits.size() && !cancel; ++i) {
+        SweepPoint point = measure(limits[i], &sampler);
+        points.append(point);
+        if (progress)
+            progress(point);
+    }
+    sampler.stop();
+
+    if (original > 0) {
+        GpuSettings restore;
+        restore.powerLimit = original;
+        backend->apply(options.gpu, restore, ApplyPowerLimit);
+    }
+    return points;
+}
+
+SweepPoint PowerSweep::measure(int powerLimit, TelemetrySampler *sampler) {
+    TraceSpan span("sweep step", "sweep", QString("gpu %1 %2 W").arg(options.gpu).arg(powerLimit));
+    SweepPoint point;
+    point.powerLimit = powerLimit;
+
+    GpuSettings settings;
+    settings.powerLimit = powerLimit;
+    ApplyResult result = backend->apply(options.gpu, settings, ApplyPowerLimit);
+    if (!result.ok()) {
+        point.error = result.errors.join("; ");
+        span.setExitCode(1);
+        return point;
+    }
+    QThread::msleep(options.settleMs);
+
+    // What was drawn while settling doesn't count
+    PowerMeter settling{options.gpu};
+    settling.drain(sampler);
+    PowerMeter meter{options.gpu};
+
+    WorkloadRun run = workload->run(SAMPLE_MS, [&]() { meter.drain(sampler); });
+    point.throughput = run.throughput;
+    if (!run.ok)
+        point.error = run.error;
+    else if (run.throughput < 0)
+        point.error = "No throughput in benchmark output";
+
+    meter.drain(sampler);
+    point.meanPowerDraw = meter.mean();
+    if (run.ok && point.meanPowerDraw <= 0)
+        point.error = "No power readings during the run";
+    span.setExitCode(point.ok() ? 0 : 1);
+    return point;
+}
+
+int PowerSweep::kneeIndex(const QVector<SweepPoint> &points) {
+    int best = -1;
+    for (int i = 0; i < points.size(); ++i) {
+        if (points[i].ok() && (best < 0 || points[i].perfPerWatt() > points[best].perfPerWatt()))
+            best = i;
+    }
+    return best;
+}
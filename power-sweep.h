@@ -0,0 +1,53 @@
+#pragma once
+
+#include "gpu-backend.h"
+#include "workload.h"
+
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+
+class TelemetrySampler;
+
+struct SweepOptions {
+    int gpu = 0;
+    int minPower = 0;
+    int maxPower = 0;
+    int step = 25;
+    int settleMs = 2000;        // After setting a limit, before measuring
+};
+
+struct SweepPoint {
+    int powerLimit = 0;
+    double throughput = -1;
+    double meanPowerDraw = -1;
+    QString error;              // Empty when the step succeeded
+
+    bool ok() const { return error.isEmpty() && throughput >= 0 && meanPowerDraw > 0; }
+    double perfPerWatt() const { return ok() ? throughput / meanPowerDraw : 0; }
+};
+
+// Steps one GPU's power limit across [minPower, maxPower], runs the workload
+// at each step and records throughput against mean board power. Blocking;
+// run it on a worker thread. The original limit is restored afterwards.
+class PowerSweep {
+public:
+    PowerSweep(GpuBackend *backend, Workload *workload, const SweepOptions &options);
+
+    // progress sees each finished step. Setting cancel stops after the
+    // current step.
+    QVector<SweepPoint> run(const std::function<void(const SweepPoint &)> &progress,
+                            const std::atomic<bool> &cancel);
+
+    // Step with the highest throughput per watt, or -1 when none succeeded
+    static int kneeIndex(const QVector<SweepPoint> &points);
+
+private:
+    SweepPoint measure(int powerLimit, TelemetrySampler *sampler);
+
+    GpuBackend *backend;
+    Workload *workload;
+    SweepOptions options;
+};
@@ -0,0 +1,220 @@
+#include "remote-control.h"
+
+#include "agent-client.h"
+#include "agent-protocol.h"
+#include "config.h"
+#include "telemetry.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QSet>
+#include <QTextStream>
+
+#include <cstring>
+
+namespace {
+
+QStringList readHosts(const QString &value, QString *error) {
+    QStringList hosts;
+    if (value.startsWith('@')) {
+        QFile file(value.mid(1));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            *error = file.errorString();
+            return hosts;
+        }
+        while (!file.atEnd()) {
+            QString line = QString::fromUtf8(file.readLine()).section('#', 0, 0).trimmed();
+            if (!line.isEmpty())
+                hosts << line;
+        }
+    } else {
+        for (const QString &host : value.split(',', Qt::SkipEmptyParts))
+            hosts << host.trimmed();
+    }
+    hosts.removeDuplicates();
+    if (hosts.isEmpty())
+        *error = "No hosts given";
+    return hosts;
+}
+
+QString signedMhz(const QJsonObject &entry, const char *key) {
+    if (!entry.contains(key))
+        return "n/a";
+    int mhz = entry[key].toInt();
+    return (mhz > 0 ? "+" : "") + QString::number(mhz);
+}
+
+QString describeSnapshot(const QJsonObject &entry) {
+    return QString("GPU %1  %2  %3 W  mem %4  core %5  %6/%7 MHz")
+        .arg(entry["gpu"].toInt()).arg(entry["pci"].toString()).arg(entry["power"].toInt())
+        .arg(signedMhz(entry, "memory"), signedMhz(entry, "core"))
+        .arg(entry["graphics_clock"].toInt()).arg(entry["memory_clock"].toInt());
+}
+
+QString describeSample(const TelemetrySample &sample) {
+    QString text = QString("GPU %1  %2 W  %3 MHz  %4 °C  %5 %")
+        .arg(sample.gpu).arg(double(sample.powerDraw), 0, 'f', 1).arg(sample.graphicsClock)
+        .arg(sample.temperature).arg(sample.gpuUtilization);
+    if (sample.throttleReasons)
+        text += "  " + throttleReasonText(sample.throttleReasons);
+    return text;
+}
+
+QString describeFailures(const QJsonObject &response) {
+    QStringList lines;
+    for (const QJsonValue &value : response["results"].toArray()) {
+        QJsonObject entry = value.toObject();
+        for (const QJsonValue &error : entry["errors"].toArray())
+            lines << QString("GPU %1: %2").arg(entry["gpu"].toInt()).arg(error.toString());
+    }
+    return lines.isEmpty() ? response["error"].toString() : lines.join("; ");
+}
+
+}
+
+namespace RemoteControl {
+
+bool requested(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--remote") == 0 || strncmp(argv[i], "--remote=", 9) == 0)
+            return true;
+    }
+    return false;
+}
+
+int run(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("gpu-control");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Query or apply GPU settings on hosts running gpu-control --agent");
+    parser.addHelpOption();
+    QCommandLineOption remoteOption("remote",
+        "Comma-separated agent addresses (host[:port], unix:/path), or @<file> with one per line.", "hosts");
+    QCommandLineOption profileOption("profile", "Apply each host's own profile <name>.", "name");
+    QCommandLineOption configOption("config", "Apply the settings in local <file> to every host.", "file");
+    QCommandLineOption queryOption("query", "Print every host's current settings and clocks.");
+    QCommandLineOption streamOption("stream", "Print telemetry from every host until interrupted.");
+    QCommandLineOption timeoutOption("timeout", "Give up on a host after <seconds>.", "seconds", "30");
+    parser.addOption(remoteOption);
+    parser.addOption(profileOption);
+    parser.addOption(configOption);
+    parser.addOption(queryOption);
+    parser.addOption(streamOption);
+    parser.addOption(timeoutOption);
+    parser.process(app);
+
+    QString error;
+    QStringList hosts = readHosts(parser.value(remoteOption), &error);
+    if (hosts.isEmpty()) {
+        qWarning("%s", qPrintable(error));
+        return 1;
+    }
+
+    QJsonObject message;
+    if (parser.isSet(queryOption)) {
+        message["op"] = "snapshot";
+    } else if (parser.isSet(streamOption)) {
+        message["op"] = "stream";
+    } else if (parser.isSet(configOption)) {
+        QString file = parser.value(configOption);
+        GpuConfig config = GpuConfig::load(file);
+        if (!QFile::exists(file) || config.gpus.isEmpty()) {
+            qWarning("No GPU settings in %s", qPrintable(file));
+            return 1;
+        }
+        QJsonArray gpus;
+        for (auto it = config.gpus.constBegin(); it != config.gpus.constEnd(); ++it)
+            gpus.append(AgentProtocol::settingsObject(it.key(), *it));
+        message["op"] = "apply";
+        message["gpus"] = gpus;
+    } else if (parser.isSet(profileOption)) {
+        message["op"] = "apply";
+        message["profile"] = parser.value(profileOption);
+    } else {
+        qWarning("Nothing to do: give --profile, --config, --query or --stream");
+        return 1;
+    }
+    bool query = parser.isSet(queryOption);
+    bool streaming = parser.isSet(streamOption);
+
+    int width = 0;
+    for (const QString &host : hosts)
+        width = qMax(width, host.size());
+    QTextStream out(stdout);
+    auto print = [&out, width](const QString &host, const QString &text) {
+        out << host.leftJustified(width) << "  " << text << '\n';
+        out.flush();
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    int timeoutMs = qMax(1, parser.value(timeoutOption).toInt()) * 1000;
+    int remaining = hosts.size();
+    int succeeded = 0;
+    QHash<QString, QString> helloErrors;
+    QSet<QString> done;
+    auto finished = [&](const QString &host) {
+        if (done.contains(host))
+            return;
+        done.insert(host);
+        if (--remaining == 0)
+            app.quit();
+    };
+
+    // hello and the request go out back to back; the agent answers hello
+    // first, so a wrong token shows up as the reason the request failed
+    for (const QString &host : hosts) {
+        auto *client = new AgentClient(host, timeoutMs, &app);
+        QJsonObject hello;
+        hello["op"] = "hello";
+        hello["token"] = QString::fromUtf8(AgentProtocol::token());
+        client->request(hello, [&helloErrors, host](const QJsonObject &response) {
+            if (!response["ok"].toBool())
+                helloErrors.insert(host, response["error"].toString());
+        });
+
+        client->request(message, [&, host](const QJsonObject &response) {
+            bool ok = response["ok"].toBool();
+            QString reason = helloErrors.value(host, describeFailures(response));
+            if (!ok) {
+                print(host, "FAILED  " + reason);
+                finished(host);
+                return;
+            }
+            ++succeeded;
+            if (streaming)
+                return;
+            if (query) {
+                for (const QJsonValue &value : response["gpus"].toArray())
+                    print(host, describeSnapshot(value.toObject()));
+            } else {
+                print(host, QString("ok  %1 GPUs  (%2 ms)").arg(response["results"].toArray().size())
+                                .arg(timer.elapsed()));
+            }
+            finished(host);
+        });
+
+        if (streaming) {
+            client->setStreamHandler([&print, host](int, const QJsonObject &sample) {
+                print(host, describeSample(AgentProtocol::readSample(sample)));
+            });
+            client->setClosedHandler([&, host](const QString &reason) {
+                if (!done.contains(host))
+                    print(host, "closed  " + reason);
+                finished(host);
+            });
+        }
+        client->open();
+    }
+
+    app.exec();
+    if (!streaming)
+        qInfo("%d of %d hosts succeeded in %lld ms", succeeded, hosts.size(), timer.elapsed());
+    return succeeded == hosts.size() ? 0 : 1;
+}
+
+}
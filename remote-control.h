@@ -0,0 +1,17 @@
+#pragma once
+
+// `gpu-control --remote HOSTS [--profile NAME | --config FILE | --query |
+// --stream]`: drives `gpu-control --agent` on many hosts at once. HOSTS is a
+// comma-separated list of host[:port] or unix:/path addresses, or @FILE with
+// one per line. Every host gets its own connection and requests, so results
+// print as each host answers and a slow or dead host only costs its own
+// timeout.
+namespace RemoteControl {
+
+// True when the command line asks for a remote run
+bool requested(int argc, char *argv[]);
+
+// Runs it against every host and returns the process exit code
+int run(int argc, char *argv[]);
+
+}
@@ -0,0 +1,186 @@
+#include "replay-dialog.h"
+
+#include <QComboBox>
+#include <QDateTime>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QSlider>
+#include <QVBoxLayout>
+
+#include <algorithm>
+
+namespace {
+
+struct Series {
+    const char *name;
+    QColor color;
+    std::function<double(const TelemetrySample &)> value;
+};
+
+const QVector<Series> &series() {
+    static const QVector<Series> all = {
+        {"W", QColor("#76b900"), [](const TelemetrySample &s) { return double(s.powerDraw); }},
+        {"MHz", QColor("#3498db"), [](const TelemetrySample &s) { return double(s.graphicsClock); }},
+        {"°C", QColor("#e67e22"), [](const TelemetrySample &s) { return double(s.temperature); }},
+    };
+    return all;
+}
+
+QString timeText(qint64 ms) {
+    return QDateTime::fromMSecsSinceEpoch(ms).toString("yyyy-MM-dd HH:mm:ss");
+}
+
+}
+
+ReplayChart::ReplayChart(QWidget *parent) : QWidget(parent) {
+    setMinimumHeight(200);
+    setMouseTracking(true);
+}
+
+void ReplayChart::setSamples(const QVector<TelemetrySample> &samples, qint64 fromMs, qint64 toMs) {
+    this->samples = samples;
+    this->fromMs = fromMs;
+    this->toMs = qMax(fromMs + 1, toMs);
+    update();
+}
+
+QRectF ReplayChart::plotArea() const {
+    return QRectF(rect()).adjusted(10, 10, -10, -24);
+}
+
+void ReplayChart::paintEvent(QPaintEvent *) {
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.fillRect(rect(), QColor("#1e1e1e"));
+
+    QRectF area = plotArea();
+    painter.setPen(QColor("#666"));
+    painter.drawLine(area.bottomLeft(), area.bottomRight());
+    painter.drawText(QRectF(area.left(), area.bottom() + 4, 200, 16), Qt::AlignLeft, timeText(fromMs));
+    painter.drawText(QRectF(area.right() - 200, area.bottom() + 4, 200, 16), Qt::AlignRight, timeText(toMs));
+    if (samples.size() < 2)
+        return;
+
+    int row = 0;
+    for (const Series &line : series()) {
+        double lo = 0, hi = 0;
+        bool any = false;
+        for (const TelemetrySample &sample : samples) {
+            double v = line.value(sample);
+            if (v < 0)
+                continue;
+            lo = any ? qMin(lo, v) : v;
+            hi = any ? qMax(hi, v) : v;
+            any = true;
+        }
+        if (!any)
+            continue;
+        if (hi - lo < 1)
+            hi = lo + 1;
+
+        QPolygonF points;
+        for (const TelemetrySample &sample : samples) {
+            double v = line.value(sample);
+            if (v < 0)
+                continue;
+            double x = area.left() + area.width() * (sample.timestampMs - fromMs) / double(toMs - fromMs);
+            points << QPointF(x, area.bottom() - area.height() * (v - lo) / (hi - lo));
+        }
+        painter.setPen(QPen(line.color, 1.5));
+        painter.drawPolyline(points);
+        painter.drawText(QPointF(area.left() + 4, area.top() + 12 + 14 * row++),
+                         QString("%1-%2 %3").arg(lo, 0, 'f', 0).arg(hi, 0, 'f', 0).arg(line.name));
+    }
+}
+
+void ReplayChart::mouseMoveEvent(QMouseEvent *event) {
+    if (!onHover || samples.isEmpty())
+        return;
+    QRectF area = plotArea();
+    qint64 at = fromMs + qint64((event->pos().x() - area.left()) / area.width() * (toMs - fromMs));
+    auto it = std::lower_bound(samples.constBegin(), samples.constEnd(), at,
+                               [](const TelemetrySample &s, qint64 ms) { return s.timestampMs < ms; });
+    if (it == samples.constEnd())
+        --it;
+    else if (it != samples.constBegin() && at - (it - 1)->timestampMs < it->timestampMs - at)
+        --it;
+    onHover(&*it);
+}
+
+void ReplayChart::leaveEvent(QEvent *) {
+    if (onHover)
+        onHover(nullptr);
+}
+
+ReplayDialog::ReplayDialog(QWidget *parent) : QDialog(parent) {
+    setWindowTitle("Telemetry History");
+    resize(720, 420);
+
+    auto *layout = new QVBoxLayout(this);
+    auto *controls = new QHBoxLayout();
+    gpuCombo = new QComboBox();
+    for (int gpu : archive.gpus())
+        gpuCombo->addItem(QString("GPU %1").arg(gpu), gpu);
+    windowCombo = new QComboBox();
+    windowCombo->addItem("10 minutes", 10 * 60);
+    windowCombo->addItem("1 hour", 60 * 60);
+    windowCombo->addItem("6 hours", 6 * 60 * 60);
+    windowCombo->addItem("1 day", 24 * 60 * 60);
+    windowCombo->addItem("1 week", 7 * 24 * 60 * 60);
+    windowCombo->setCurrentIndex(1);
+    controls->addWidget(gpuCombo);
+    controls->addWidget(windowCombo);
+    controls->addStretch();
+    layout->addLayout(controls);
+
+    chart = new ReplayChart();
+    chart->setHoverHandler([this](const TelemetrySample *sample) { showSample(sample); });
+    layout->addWidget(chart, 1);
+
+    // Position is the end of the window, in seconds into the recording
+    scrubber = new QSlider(Qt::Horizontal);
+    scrubber->setRange(0, int(qMax<qint64>(0, (archive.lastMs() - archive.firstMs()) / 1000)));
+    scrubber->setValue(scrubber->maximum());
+    layout->addWidget(scrubber);
+
+    rangeLabel = new QLabel();
+    rangeLabel->setStyleSheet("color: #aaa;");
+    sampleLabel = new QLabel();
+    layout->addWidget(rangeLabel);
+    layout->addWidget(sampleLabel);
+
+    if (archive.isEmpty()) {
+        rangeLabel->setText("Nothing recorded yet");
+        scrubber->setEnabled(false);
+        return;
+    }
+
+    connect(gpuCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ReplayDialog::reload);
+    connect(windowCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ReplayDialog::reload);
+    connect(scrubber, &QSlider::valueChanged, this, &ReplayDialog::reload);
+    reload();
+}
+
+void ReplayDialog::reload() {
+    qint64 toMs = archive.firstMs() + qint64(scrubber->value()) * 1000;
+    qint64 fromMs = toMs - qint64(windowCombo->currentData().toInt()) * 1000;
+    // About one point per pixel column is all the chart can show
+    QVector<TelemetrySample> samples = archive.read(gpuCombo->currentData().toInt(), fromMs, toMs,
+                                                    qMax(200, chart->width()));
+    chart->setSamples(samples, fromMs, toMs);
+    rangeLabel->setText(QString("%1 to %2, %3 samples shown")
+                        .arg(timeText(fromMs)).arg(timeText(toMs)).arg(samples.size()));
+}
+
+void ReplayDialog::showSample(const TelemetrySample *sample) {
+    if (!sample) {
+        sampleLabel->clear();
+        return;
+    }
+    sampleLabel->setText(QString("%1  |  %2 W  |  core %3 MHz  |  mem %4 MHz  |  %5 °C  |  load %6 %  |  throttle 0x%7")
+                         .arg(timeText(sample->timestampMs)).arg(sample->powerDraw, 0, 'f', 1)
+                         .arg(sample->graphicsClock).arg(sample->memoryClock).arg(sample->temperature)
+                         .arg(sample->gpuUtilization).arg(sample->throttleReasons, 0, 16));
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "telemetry-recorder.h"
+
+#include <QDialog>
+
+#include <functional>
+
+class QComboBox;
+class QLabel;
+class QSlider;
+
+// Power, core clock and temperature over a time window, each scaled to its
+// own range. Hovering reports the sample under the cursor.
+class ReplayChart : public QWidget {
+public:
+    explicit ReplayChart(QWidget *parent = nullptr);
+
+    void setSamples(const QVector<TelemetrySample> &samples, qint64 fromMs, qint64 toMs);
+    void setHoverHandler(const std::function<void(const TelemetrySample *)> &handler) { onHover = handler; }
+
+    QSize sizeHint() const override { return QSize(640, 260); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void leaveEvent(QEvent *event) override;
+
+private:
+    QRectF plotArea() const;
+
+    QVector<TelemetrySample> samples;
+    qint64 fromMs = 0;
+    qint64 toMs = 1;
+    std::function<void(const TelemetrySample *)> onHover;
+};
+
+// Scrubs through the recorded history. Only the window on screen is ever
+// decoded, and long windows are thinned at the chunk level, so hours or
+// days of recordings never have to fit in memory.
+class ReplayDialog : public QDialog {
+public:
+    explicit ReplayDialog(QWidget *parent = nullptr);
+
+private:
+    void reload();
+    void showSample(const TelemetrySample *sample);
+
+    TelemetryArchive archive;
+    QComboBox *gpuCombo;
+    QComboBox *windowCombo;
+    QSlider *scrubber;
+    ReplayChart *chart;
+    QLabel *rangeLabel;
+    QLabel *sampleLabel;
+};
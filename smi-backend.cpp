@@ -0,0 +1,398 @@
+#include "smi-backend.h"
+#include "tracer.h"
+
+#include <QProcess>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+const char *MEM_OFFSET_ATTR = "GPUMemoryTransferRateOffsetAllPerformanceLevels";
+const char *CORE_OFFSET_ATTR = "GPUGraphicsClockOffsetAllPerformanceLevels";
+
+// nvidia-smi prints "[N/A]" or "350.00"; both end up as whole watts/MHz or -1
+int toInt(const QString &field) {
+    bool ok = false;
+    int val = field.trimmed().split('.').first().toInt(&ok);
+    return ok ? val : -1;
+}
+
+// nvidia-smi's exit code when the board does not support an operation
+const int SMI_NOT_SUPPORTED = 3;
+
+QStringList supportedClocksArguments(int gpu) {
+    return QStringList() << "-i" << QString::number(gpu)
+        << "--query-supported-clocks=memory,graphics" << "--format=csv,noheader,nounits";
+}
+
+// One "memory, graphics" line per valid pair; each memory clock repeats for
+// every graphics clock it allows
+bool parseSupportedClocks(const QByteArray &output, QVector<int> *memory, QVector<int> *graphics) {
+    QVector<int> mem, gfx;
+    for (const QString &line : QString(output).split('\n', Qt::SkipEmptyParts)) {
+        QStringList parts = line.split(',');
+        if (parts.size() != 2)
+            continue;
+        int m = toInt(parts[0]);
+        int g = toInt(parts[1]);
+        if (m > 0 && !mem.contains(m))
+            mem.append(m);
+        if (g > 0 && !gfx.contains(g))
+            gfx.append(g);
+    }
+    if (mem.isEmpty() || gfx.isEmpty())
+        return false;
+    std::sort(mem.begin(), mem.end(), std::greater<int>());
+    std::sort(gfx.begin(), gfx.end(), std::greater<int>());
+    *memory = mem;
+    *graphics = gfx;
+    return true;
+}
+
+// -lgc/-lmc min,max to lock; -rgc/-rmc to reset
+QStringList lockArguments(int gpu, const char *lockFlag, const char *resetFlag, int min, int max) {
+    QStringList args;
+    args << "nvidia-smi" << "-i" << QString::number(gpu);
+    if (min == 0 && max == 0)
+        args << resetFlag;
+    else
+        args << lockFlag << QString("%1,%2").arg(min).arg(max);
+    return args;
+}
+
+// Resetting a lock the board never supported leaves it as asked
+bool lockFinished(QProcess *proc, bool reset, QString *error) {
+    proc->waitForFinished(5000);
+    if (proc->exitStatus() == QProcess::NormalExit
+        && (proc->exitCode() == 0 || (reset && proc->exitCode() == SMI_NOT_SUPPORTED)))
+        return true;
+    if (error)
+        *error = QString(proc->readAllStandardError() + proc->readAllStandardOutput()).trimmed();
+    return false;
+}
+
+}
+
+int SmiBackend::deviceCount() {
+    TracedProcess proc;
+    proc.start("nvidia-smi", QStringList() << "-L");
+    proc.waitForFinished(5000);
+    if (proc.exitCode() != 0)
+        return 0;
+    QString output = proc.readAllStandardOutput().trimmed();
+    return output.isEmpty() ? 0 : output.split('\n').size();
+}
+
+QString SmiBackend::querySmi(int gpu, const QString &field, bool units) {
+    TracedProcess proc;
+    proc.start("nvidia-smi", QStringList()
+        << "-i" << QString::number(gpu)
+        << "--query-gpu=" + field
+        << (units ? "--format=csv,noheader" : "--format=csv,noheader,nounits"));
+    proc.waitForFinished(5000);
+    return proc.readAllStandardOutput().trimmed();
+}
+
+int SmiBackend::querySmiInt(int gpu, const QString &field) {
+    return toInt(querySmi(gpu, field));
+}
+
+QString SmiBackend::pciBusId(int gpu) {
+    return querySmi(gpu, "pci.bus_id");
+}
+
+QString SmiBackend::driverVersion() {
+    return querySmi(0, "driver_version");
+}
+
+QString SmiBackend::gpuName(int gpu) {
+    return querySmi(gpu, "name", true);
+}
+
+int SmiBackend::minPowerLimit(int gpu) {
+    return querySmiInt(gpu, "power.min_limit");
+}
+
+int SmiBackend::maxPowerLimit(int gpu) {
+    return querySmiInt(gpu, "power.max_limit");
+}
+
+int SmiBackend::defaultPowerLimit(int gpu) {
+    return querySmiInt(gpu, "power.default_limit");
+}
+
+int SmiBackend::powerLimit(int gpu) {
+    return querySmiInt(gpu, "power.limit");
+}
+
+int SmiBackend::memoryClock(int gpu) {
+    return querySmiInt(gpu, "clocks.current.memory");
+}
+
+int SmiBackend::graphicsClock(int gpu) {
+    return querySmiInt(gpu, "clocks.current.graphics");
+}
+
+bool SmiBackend::querySettings(int gpu, const QString &attribute, int *value) {
+    TracedProcess proc;
+    proc.start("nvidia-settings", QStringList() << "-t" << "-q"
+        << QString("[gpu:%1]/%2").arg(gpu).arg(attribute));
+    proc.waitForFinished(3000);
+    if (proc.exitCode() != 0)
+        return false;
+    bool ok = false;
+    int val = QString(proc.readAllStandardOutput()).trimmed().toInt(&ok);
+    if (ok)
+        *value = val;
+    return ok;
+}
+
+bool SmiBackend::memoryOffset(int gpu, int *mhz) {
+    return querySettings(gpu, MEM_OFFSET_ATTR, mhz);
+}
+
+bool SmiBackend::coreOffset(int gpu, int *mhz) {
+    return querySettings(gpu, CORE_OFFSET_ATTR, mhz);
+}
+
+// Parses the "valid values ... are in the range A - B" lines of a verbose
+// nvidia-settings query, one call for all requested attributes.
+QHash<QString, QPair<int, int>> SmiBackend::queryRanges(int gpu, const QStringList &attributes) {
+    QStringList args;
+    for (const QString &attribute : attributes)
+        args << "-q" << QString("[gpu:%1]/%2").arg(gpu).arg(attribute);
+
+    TracedProcess proc;
+    proc.start("nvidia-settings", args);
+    proc.waitForFinished(3000);
+
+    QHash<QString, QPair<int, int>> ranges;
+    static const QRegularExpression re("valid values for '(\\w+)' are in the range (-?\\d+) - (-?\\d+)");
+    auto it = re.globalMatch(proc.readAllStandardOutput());
+    while (it.hasNext()) {
+        auto match = it.next();
+        ranges.insert(match.captured(1), qMakePair(match.captured(2).toInt(), match.captured(3).toInt()));
+    }
+    return ranges;
+}
+
+bool SmiBackend::memoryOffsetRange(int gpu, int *min, int *max) {
+    auto ranges = queryRanges(gpu, QStringList() << MEM_OFFSET_ATTR);
+    if (!ranges.contains(MEM_OFFSET_ATTR))
+        return false;
+    *min = ranges[MEM_OFFSET_ATTR].first;
+    *max = ranges[MEM_OFFSET_ATTR].second;
+    return true;
+}
+
+bool SmiBackend::coreOffsetRange(int gpu, int *min, int *max) {
+    auto ranges = queryRanges(gpu, QStringList() << CORE_OFFSET_ATTR);
+    if (!ranges.contains(CORE_OFFSET_ATTR))
+        return false;
+    *min = ranges[CORE_OFFSET_ATTR].first;
+    *max = ranges[CORE_OFFSET_ATTR].second;
+    return true;
+}
+
+bool SmiBackend::supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) {
+    TracedProcess proc;
+    proc.start("nvidia-smi", supportedClocksArguments(gpu));
+    proc.waitForFinished(5000);
+    return proc.exitCode() == 0 && parseSupportedClocks(proc.readAllStandardOutput(), memory, graphics);
+}
+
+GpuSnapshot SmiBackend::snapshot(int gpu) {
+    // One nvidia-smi call for the driver-side values and one nvidia-settings
+    // call for both offsets, running side by side.
+    TracedProcess smi;
+    smi.start("nvidia-smi", QStringList()
+        << "-i" << QString::number(gpu)
+        << "--query-gpu=pci.bus_id,driver_version,power.limit,clocks.current.memory,clocks.current.graphics"
+        << "--format=csv,noheader,nounits");
+    TracedProcess settings;
+    settings.start("nvidia-settings", QStringList() << "-t"
+        << "-q" << QString("[gpu:%1]/%2").arg(gpu).arg(MEM_OFFSET_ATTR)
+        << "-q" << QString("[gpu:%1]/%2").arg(gpu).arg(CORE_OFFSET_ATTR));
+    smi.waitForFinished(5000);
+    settings.waitForFinished(3000);
+
+    GpuSnapshot snap;
+    QStringList parts = QString(smi.readAllStandardOutput()).trimmed().split(',');
+    if (parts.size() == 5) {
+        snap.pciBusId = parts[0].trimmed();
+        snap.driverVersion = parts[1].trimmed();
+        snap.powerLimit = toInt(parts[2]);
+        snap.memoryClock = toInt(parts[3]);
+        snap.graphicsClock = toInt(parts[4]);
+    }
+
+    if (settings.exitCode() == 0) {
+        QStringList lines = QString(settings.readAllStandardOutput()).trimmed().split('\n');
+        if (lines.size() == 2) {
+            snap.memoryOffset = lines[0].trimmed().toInt(&snap.memOffsetOk);
+            snap.coreOffset = lines[1].trimmed().toInt(&snap.coreOffsetOk);
+        }
+    }
+    return snap;
+}
+
+GpuStaticInfo SmiBackend::staticInfo(int gpu) {
+    TracedProcess smi;
+    smi.start("nvidia-smi", QStringList()
+        << "-i" << QString::number(gpu)
+        << "--query-gpu=name,power.min_limit,power.max_limit,power.default_limit"
+        << "--format=csv,noheader,nounits");
+    TracedProcess clocks;
+    clocks.start("nvidia-smi", supportedClocksArguments(gpu));
+    smi.waitForFinished(5000);
+
+    GpuStaticInfo info;
+    // Parse from the right so a comma in the board name can't shift fields
+    QStringList parts = QString(smi.readAllStandardOutput()).trimmed().split(',');
+    if (parts.size() >= 4) {
+        info.defaultPowerLimit = toInt(parts.takeLast());
+        info.maxPowerLimit = toInt(parts.takeLast());
+        info.minPowerLimit = toInt(parts.takeLast());
+        info.name = parts.join(',').trimmed();
+    }
+
+    auto ranges = queryRanges(gpu, QStringList() << MEM_OFFSET_ATTR << CORE_OFFSET_ATTR);
+    if (ranges.contains(MEM_OFFSET_ATTR)) {
+        info.memOffsetMin = ranges[MEM_OFFSET_ATTR].first;
+        info.memOffsetMax = ranges[MEM_OFFSET_ATTR].second;
+    }
+    if (ranges.contains(CORE_OFFSET_ATTR)) {
+        info.coreOffsetMin = ranges[CORE_OFFSET_ATTR].first;
+        info.coreOffsetMax = ranges[CORE_OFFSET_ATTR].second;
+    }
+
+    clocks.waitForFinished(5000);
+    if (clocks.exitCode() == 0)
+        parseSupportedClocks(clocks.readAllStandardOutput(), &info.memoryClocks, &info.graphicsClocks);
+    return info;
+}
+
+bool SmiBackend::setPowerLimit(int gpu, int watts, QString *error) {
+    TracedProcess proc;
+    proc.start("sudo", QStringList() << "nvidia-smi" << "-i" << QString::number(gpu)
+        << "-pl" << QString::number(watts));
+    proc.waitForFinished(5000);
+    if (proc.exitCode() != 0) {
+        if (error)
+            *error = proc.readAllStandardError().trimmed();
+        return false;
+    }
+    return true;
+}
+
+bool SmiBackend::assignSettings(int gpu, const QString &attribute, int value, QString *error) {
+    TracedProcess proc;
+    proc.start("sudo", QStringList() << "nvidia-settings" << "-a"
+        << QString("[gpu:%1]/%2=%3").arg(gpu).arg(attribute).arg(value));
+    proc.waitForFinished(5000);
+    if (proc.exitCode() != 0) {
+        if (error)
+            *error = proc.readAllStandardError().trimmed();
+        return false;
+    }
+    return true;
+}
+
+bool SmiBackend::setMemoryOffset(int gpu, int mhz, QString *error) {
+    return assignSettings(gpu, MEM_OFFSET_ATTR, mhz, error);
+}
+
+bool SmiBackend::setCoreOffset(int gpu, int mhz, QString *error) {
+    return assignSettings(gpu, CORE_OFFSET_ATTR, mhz, error);
+}
+
+bool SmiBackend::setGraphicsClockLock(int gpu, int min, int max, QString *error) {
+    TracedProcess proc;
+    proc.start("sudo", lockArguments(gpu, "-lgc", "-rgc", min, max));
+    return lockFinished(&proc, min == 0 && max == 0, error);
+}
+
+bool SmiBackend::setMemoryClockLock(int gpu, int min, int max, QString *error) {
+    TracedProcess proc;
+    proc.start("sudo", lockArguments(gpu, "-lmc", "-rmc", min, max));
+    return lockFinished(&proc, min == 0 && max == 0, error);
+}
+
+ApplyResult SmiBackend::apply(int gpu, const GpuSettings &settings, int fields) {
+    // The power limit and each clock lock go through their own nvidia-smi
+    // while both offsets share one nvidia-settings call; all the privileged
+    // processes run side by side.
+    TracedProcess pl;
+    if (fields & ApplyPowerLimit) {
+        pl.start("sudo", QStringList() << "nvidia-smi" << "-i" << QString::number(gpu)
+            << "-pl" << QString::number(settings.powerLimit));
+    }
+    TracedProcess graphicsLock;
+    if (fields & ApplyGraphicsLock)
+        graphicsLock.start("sudo", lockArguments(gpu, "-lgc", "-rgc", settings.graphicsLockMin, settings.graphicsLockMax));
+    TracedProcess memoryLock;
+    if (fields & ApplyMemoryLock)
+        memoryLock.start("sudo", lockArguments(gpu, "-lmc", "-rmc", settings.memoryLockMin, settings.memoryLockMax));
+
+    QStringList assignments;
+    if (fields & ApplyMemoryOffset) {
+        assignments << "-a" << QString("[gpu:%1]/%2=%3").arg(gpu).arg(MEM_OFFSET_ATTR)
+            .arg(settings.memoryOffset);
+    }
+    if (fields & ApplyCoreOffset) {
+        assignments << "-a" << QString("[gpu:%1]/%2=%3").arg(gpu).arg(CORE_OFFSET_ATTR)
+            .arg(settings.coreOffset);
+    }
+    TracedProcess offsets;
+    if (!assignments.isEmpty())
+        offsets.start("sudo", QStringList() << "nvidia-settings" << assignments);
+
+    ApplyResult result;
+    if (fields & ApplyPowerLimit) {
+        pl.waitForFinished(5000);
+        if (pl.exitStatus() != QProcess::NormalExit || pl.exitCode() != 0) {
+            result.failedFields |= ApplyPowerLimit;
+            result.errors << "Power limit: " + pl.readAllStandardError().trimmed();
+        }
+    }
+    QString error;
+    if ((fields & ApplyGraphicsLock)
+        && !lockFinished(&graphicsLock, settings.graphicsLockMin == 0 && settings.graphicsLockMax == 0, &error)) {
+        result.failedFields |= ApplyGraphicsLock;
+        result.errors << "Graphics clock lock: " + error;
+    }
+    if ((fields & ApplyMemoryLock)
+        && !lockFinished(&memoryLock, settings.memoryLockMin == 0 && settings.memoryLockMax == 0, &error)) {
+        result.failedFields |= ApplyMemoryLock;
+        result.errors << "Memory clock lock: " + error;
+    }
+
+    if (!assignments.isEmpty()) {
+        offsets.waitForFinished(5000);
+        QString output = offsets.readAllStandardError() + offsets.readAllStandardOutput();
+
+        // nvidia-settings names the attribute in each failed assignment
+        for (const QString &line : output.split('\n')) {
+            if (!line.contains("ERROR"))
+                continue;
+            if (line.contains(MEM_OFFSET_ATTR) && (fields & ApplyMemoryOffset)) {
+                result.failedFields |= ApplyMemoryOffset;
+                result.errors << "Memory offset: " + line.trimmed();
+            } else if (line.contains(CORE_OFFSET_ATTR) && (fields & ApplyCoreOffset)) {
+                result.failedFields |= ApplyCoreOffset;
+                result.errors << "Core offset: " + line.trimmed();
+            }
+        }
+
+        // Failed without saying which assignment: blame all of them
+        bool failed = offsets.exitStatus() != QProcess::NormalExit || offsets.exitCode() != 0;
+        int offsetFields = fields & (ApplyMemoryOffset | ApplyCoreOffset);
+        if (failed && !(result.failedFields & offsetFields)) {
+            result.failedFields |= offsetFields;
+            result.errors << "Clock offsets: " + output.trimmed();
+        }
+    }
+    return result;
+}
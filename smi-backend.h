@@ -0,0 +1,48 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QHash>
+#include <QPair>
+#include <QStringList>
+
+// Subprocess backend: queries through nvidia-smi/nvidia-settings, writes
+// through sudo. Always available, but every call forks.
+class SmiBackend : public GpuBackend {
+public:
+    QString name() const override { return "smi"; }
+    int deviceCount() override;
+
+    QString pciBusId(int gpu) override;
+    QString driverVersion() override;
+    QString gpuName(int gpu) override;
+    int minPowerLimit(int gpu) override;
+    int maxPowerLimit(int gpu) override;
+    int defaultPowerLimit(int gpu) override;
+    int powerLimit(int gpu) override;
+    int memoryClock(int gpu) override;
+    int graphicsClock(int gpu) override;
+    bool memoryOffset(int gpu, int *mhz) override;
+    bool coreOffset(int gpu, int *mhz) override;
+    bool memoryOffsetRange(int gpu, int *min, int *max) override;
+    bool coreOffsetRange(int gpu, int *min, int *max) override;
+    bool supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) override;
+
+    GpuSnapshot snapshot(int gpu) override;
+    GpuStaticInfo staticInfo(int gpu) override;
+
+    bool setPowerLimit(int gpu, int watts, QString *error) override;
+    bool setMemoryOffset(int gpu, int mhz, QString *error) override;
+    bool setCoreOffset(int gpu, int mhz, QString *error) override;
+    bool setGraphicsClockLock(int gpu, int min, int max, QString *error) override;
+    bool setMemoryClockLock(int gpu, int min, int max, QString *error) override;
+
+    ApplyResult apply(int gpu, const GpuSettings &settings, int fields) override;
+
+private:
+    QString querySmi(int gpu, const QString &field, bool units = false);
+    int querySmiInt(int gpu, const QString &field);
+    bool querySettings(int gpu, const QString &attribute, int *value);
+    QHash<QString, QPair<int, int>> queryRanges(int gpu, const QStringList &attributes);
+    bool assignSettings(int gpu, const QString &attribute, int value, QString *error);
+};
@@ -0,0 +1,65 @@
+#include "sparkline.h"
+
+#include <QPainter>
+
+Sparkline::Sparkline(const QColor &color, int capacity, QWidget *parent)
+    : QWidget(parent), color(color), history(qMax(2, capacity)), points(qMax(2, capacity)) {
+    setMinimumHeight(36);
+}
+
+void Sparkline::addValue(float value) {
+    if (value < 0)
+        return;
+    history[next] = value;
+    next = (next + 1) % history.size();
+    count = qMin(count + 1, history.size());
+    update();
+}
+
+void Sparkline::clear() {
+    next = 0;
+    count = 0;
+    update();
+}
+
+void Sparkline::setRange(float min, float max) {
+    fixedRange = true;
+    rangeMin = min;
+    rangeMax = max;
+    update();
+}
+
+void Sparkline::paintEvent(QPaintEvent *) {
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(0x2b, 0x2b, 0x2b));
+    if (count < 2)
+        return;
+
+    int capacity = history.size();
+    int first = (next - count + capacity) % capacity;
+
+    float lo = rangeMin, hi = rangeMax;
+    if (!fixedRange) {
+        lo = hi = history[first];
+        for (int i = 1; i < count; ++i) {
+            float v = history[(first + i) % capacity];
+            lo = qMin(lo, v);
+            hi = qMax(hi, v);
+        }
+    }
+    if (hi - lo < 1e-3f)
+        hi = lo + 1;
+
+    // Newest sample on the right edge, one pixel column per slot
+    qreal dx = qreal(width() - 1) / (capacity - 1);
+    qreal x0 = width() - 1 - dx * (count - 1);
+    qreal h = height() - 3;
+    for (int i = 0; i < count; ++i) {
+        float v = history[(first + i) % capacity];
+        points[i] = QPointF(x0 + dx * i, 1 + h - (v - lo) / (hi - lo) * h);
+    }
+
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(color, 1.5));
+    painter.drawPolyline(points.constData(), count);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QColor>
+#include <QPointF>
+#include <QVector>
+#include <QWidget>
+
+// Small line graph of the most recent values. History is a fixed-size
+// circular buffer, so adding a point never allocates.
+class Sparkline : public QWidget {
+public:
+    explicit Sparkline(const QColor &color, int capacity = 300, QWidget *parent = nullptr);
+
+    void addValue(float value);
+    void clear();
+
+    // Pin the vertical range; by default it follows the data
+    void setRange(float min, float max);
+
+    QSize sizeHint() const override { return QSize(200, 36); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QColor color;
+    QVector<float> history;
+    QVector<QPointF> points;
+    int next = 0;
+    int count = 0;
+    bool fixedRange = false;
+    float rangeMin = 0;
+    float rangeMax = 1;
+};
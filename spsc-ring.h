@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Fixed-capacity single-producer/single-consumer ring buffer. push() and
+// pop() never allocate or block; when full, push() drops the new element
+// rather than overwrite one the consumer may be reading.
+template <typename T, std::size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+public:
+    // Producer side
+    bool push(const T &value) {
+        std::size_t head = writePos.load(std::memory_order_relaxed);
+        if (head - readPos.load(std::memory_order_acquire) == Capacity)
+            return false;
+        slots[head & (Capacity - 1)] = value;
+        writePos.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T *value) {
+        std::size_t tail = readPos.load(std::memory_order_relaxed);
+        if (tail == writePos.load(std::memory_order_acquire))
+            return false;
+        *value = slots[tail & (Capacity - 1)];
+        readPos.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t size() const {
+        return writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> slots{};
+    // Separate cache lines so producer and consumer don't false-share
+    alignas(64) std::atomic<std::size_t> writePos{0};
+    alignas(64) std::atomic<std::size_t> readPos{0};
+};
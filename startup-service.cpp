@@ -0,0 +1,94 @@
+#include "startup-service.h"
+
+#include "config.h"
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QProcess>
+#include <QTextStream>
+
+namespace {
+
+const char *CONFIG_PATH = "/etc/gpu-control/gpu-control.conf";
+const char *LEGACY_SCRIPT_PATH = "/etc/gpu-control/startup.sh";
+const char *UNIT_PATH = "/etc/systemd/system/gpu-control.service";
+
+bool systemctl(const QStringList &args, QString *error) {
+    TracedProcess proc;
+    proc.start("systemctl", args);
+    proc.waitForFinished(15000);
+    if (proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0) {
+        if (error)
+            *error = "systemctl " + args.join(' ') + ": " + proc.readAllStandardError().trimmed();
+        return false;
+    }
+    return true;
+}
+
+bool writeFile(const QString &path, const QString &contents, QFile::Permissions perms, QString *error) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (error)
+            *error = path + ": " + file.errorString();
+        return false;
+    }
+    QTextStream(&file) << contents;
+    file.setPermissions(perms);
+    return true;
+}
+
+}
+
+namespace StartupService {
+
+QString configPath() {
+    return CONFIG_PATH;
+}
+
+QString execStart() {
+    return QCoreApplication::applicationDirPath() + "/gpu-control --apply --config " + CONFIG_PATH;
+}
+
+QString unit(const QString &execStart) {
+    QString text;
+    QTextStream out(&text);
+    out << "[Unit]\n";
+    out << "Description=GPU Control - Power and Clock Offsets\n";
+    out << "After=nvidia-persistenced.service systemd-modules-load.service\n\n";
+    out << "[Service]\n";
+    out << "Type=oneshot\n";
+    out << "RemainAfterExit=yes\n";
+    out << "ExecStart=" << execStart << "\n\n";
+    out << "[Install]\n";
+    out << "WantedBy=multi-user.target\n";
+    return text;
+}
+
+bool install(const QMap<int, GpuSettings> &gpus, QString *error) {
+    GpuConfig config;
+    config.gpus = gpus;
+    config.startup = true;
+
+    QDir().mkpath("/etc/gpu-control");
+    if (!writeFile(CONFIG_PATH, config.toText(),
+                   QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther, error))
+        return false;
+    QFile::remove(LEGACY_SCRIPT_PATH);
+    if (!writeFile(UNIT_PATH, unit(execStart()),
+                   QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther, error))
+        return false;
+    return systemctl(QStringList() << "daemon-reload", error)
+        && systemctl(QStringList() << "enable" << "gpu-control.service", error);
+}
+
+bool remove(QString *error) {
+    systemctl(QStringList() << "disable" << "gpu-control.service", nullptr);
+    QFile::remove(UNIT_PATH);
+    QFile::remove(CONFIG_PATH);
+    QFile::remove(LEGACY_SCRIPT_PATH);
+    return systemctl(QStringList() << "daemon-reload", error);
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QMap>
+#include <QString>
+
+// Generation and installation of the boot-time gpu-control.service unit.
+namespace StartupService {
+
+// System-wide copy of the settings the unit applies on boot
+QString configPath();
+
+// `gpu-control --apply` on configPath(), using the gpu-control binary that
+// sits next to the running executable
+QString execStart();
+
+// Unit file whose ExecStart is execStart
+QString unit(const QString &execStart);
+
+// Write config and unit under /etc and enable the service. Needs root; the
+// privileged helper calls these on behalf of the GUI.
+bool install(const QMap<int, GpuSettings> &gpus, QString *error);
+bool remove(QString *error);
+
+}
@@ -0,0 +1,97 @@
+#include "static-cache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+#include <QTextStream>
+
+namespace {
+
+QString cachePath(const QString &pciBusId, const QString &driverVersion) {
+    QString key = QString("%1-%2").arg(pciBusId, driverVersion);
+    key.replace(QRegularExpression("[^A-Za-z0-9._-]"), "_");
+    return QDir::homePath() + "/.cache/gpu-control/static-" + key + ".conf";
+}
+
+QVector<int> toClocks(const QString &value) {
+    QVector<int> clocks;
+    for (const QString &clock : value.split(',', Qt::SkipEmptyParts))
+        clocks.append(clock.toInt());
+    return clocks;
+}
+
+QString fromClocks(const QVector<int> &clocks) {
+    QStringList values;
+    for (int clock : clocks)
+        values << QString::number(clock);
+    return values.join(',');
+}
+
+}
+
+namespace StaticCache {
+
+bool load(const QString &pciBusId, const QString &driverVersion, GpuStaticInfo *info) {
+    if (pciBusId.isEmpty() || driverVersion.isEmpty())
+        return false;
+
+    QFile file(cachePath(pciBusId, driverVersion));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    GpuStaticInfo cached;
+    bool haveClocks = false;
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        int eq = line.indexOf('=');
+        if (eq < 0)
+            continue;
+        QString key = line.left(eq);
+        QString value = line.mid(eq + 1);
+        if (key == "name") cached.name = value;
+        if (key == "power.min_limit") cached.minPowerLimit = value.toInt();
+        if (key == "power.max_limit") cached.maxPowerLimit = value.toInt();
+        if (key == "power.default_limit") cached.defaultPowerLimit = value.toInt();
+        if (key == "memory.offset_min") cached.memOffsetMin = value.toInt();
+        if (key == "memory.offset_max") cached.memOffsetMax = value.toInt();
+        if (key == "core.offset_min") cached.coreOffsetMin = value.toInt();
+        if (key == "core.offset_max") cached.coreOffsetMax = value.toInt();
+        if (key == "clocks.memory") cached.memoryClocks = toClocks(value);
+        if (key == "clocks.graphics") cached.graphicsClocks = toClocks(value);
+        haveClocks |= key == "clocks.graphics";
+    }
+
+    // A partial entry is worse than none; make the caller query again.
+    // Entries written before clock tables were cached lack them entirely.
+    if (cached.name.isEmpty() || cached.maxPowerLimit <= 0 || cached.defaultPowerLimit <= 0 || !haveClocks)
+        return false;
+    *info = cached;
+    return true;
+}
+
+void store(const QString &pciBusId, const QString &driverVersion, const GpuStaticInfo &info) {
+    if (pciBusId.isEmpty() || driverVersion.isEmpty())
+        return;
+    if (info.name.isEmpty() || info.maxPowerLimit <= 0 || info.defaultPowerLimit <= 0)
+        return;
+
+    QDir().mkpath(QDir::homePath() + "/.cache/gpu-control");
+    QFile file(cachePath(pciBusId, driverVersion));
+    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QTextStream out(&file);
+        out << "name=" << info.name << "\n";
+        out << "power.min_limit=" << info.minPowerLimit << "\n";
+        out << "power.max_limit=" << info.maxPowerLimit << "\n";
+        out << "power.default_limit=" << info.defaultPowerLimit << "\n";
+        out << "memory.offset_min=" << info.memOffsetMin << "\n";
+        out << "memory.offset_max=" << info.memOffsetMax << "\n";
+        out << "core.offset_min=" << info.coreOffsetMin << "\n";
+        out << "core.offset_max=" << info.coreOffsetMax << "\n";
+        // Empty when the board cannot lock clocks
+        out << "clocks.memory=" << fromClocks(info.memoryClocks) << "\n";
+        out << "clocks.graphics=" << fromClocks(info.graphicsClocks) << "\n";
+    }
+}
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+// On-disk cache of GpuStaticInfo under ~/.cache/gpu-control, keyed by PCI bus
+// ID and driver version so a board swap or driver upgrade invalidates it.
+namespace StaticCache {
+
+bool load(const QString &pciBusId, const QString &driverVersion, GpuStaticInfo *info);
+void store(const QString &pciBusId, const QString &driverVersion, const GpuStaticInfo &info);
+
+}
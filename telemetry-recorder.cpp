@@ -0,0 +1,376 @@
+#include "telemetry-recorder.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <sys/file.h>
+
+namespace {
+
+const char FileMagic[] = "GPUTEL1\n";
+const int FileMagicSize = 8;
+const quint32 ChunkMagic = 0x4b4e4843;     // "CHNK"
+const int ChunkHeaderSize = 32;
+const int FieldCount = 7;
+// Per-GPU writer state after the fields: last timestamp and last interval
+const int LastMs = FieldCount;
+const int LastInterval = FieldCount + 1;
+const int GpuFlag = 0x80;
+const qint64 ChunkSpanMs = 10000;
+const int ChunkBytes = 32 << 10;
+
+// Integer form of the recorded fields; power is kept in tenths of a watt
+void fields(const TelemetrySample &sample, qint64 *values) {
+    values[0] = sample.powerDraw < 0 ? -1 : qRound(sample.powerDraw * 10);
+    values[1] = sample.graphicsClock;
+    values[2] = sample.memoryClock;
+    values[3] = sample.temperature;
+    values[4] = sample.gpuUtilization;
+    values[5] = sample.memUtilization;
+    values[6] = qint64(sample.throttleReasons);
+}
+
+void putVarint(QByteArray *out, quint64 value) {
+    while (value >= 0x80) {
+        out->append(char(value | 0x80));
+        value >>= 7;
+    }
+    out->append(char(value));
+}
+
+bool getVarint(const uchar **p, const uchar *end, quint64 *value) {
+    *value = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uchar byte = *(*p)++;
+        *value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+quint64 zigzag(qint64 value) {
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+qint64 unzigzag(quint64 value) {
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+QStringList recordings(const QDir &dir) {
+    return dir.entryList(QStringList() << "*.gtr", QDir::Files, QDir::Name);
+}
+
+// Length of the intact prefix of a recording; a crash can leave a torn chunk
+qint64 intactLength(const uchar *data, qint64 size) {
+    if (size < FileMagicSize || memcmp(data, FileMagic, FileMagicSize) != 0)
+        return 0;
+    qint64 pos = FileMagicSize;
+    while (pos + ChunkHeaderSize <= size) {
+        if (qFromLittleEndian<quint32>(data + pos) != ChunkMagic)
+            break;
+        qint64 next = pos + ChunkHeaderSize + qFromLittleEndian<quint32>(data + pos + 4);
+        if (next > size)
+            break;
+        pos = next;
+    }
+    return pos;
+}
+
+// A recorder holds an exclusive flock on the file it writes for as long as
+// it has it open, so the GUI and `--record` never share one
+bool lock(QFile *file) {
+    return flock(file->handle(), LOCK_EX | LOCK_NB) == 0;
+}
+
+bool inUse(const QString &path) {
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) && flock(file.handle(), LOCK_SH | LOCK_NB) != 0;
+}
+
+}
+
+TelemetryRecorder::TelemetryRecorder(const QString &directory, qint64 maxFileBytes, qint64 maxTotalBytes)
+    : directory(directory), maxFileBytes(maxFileBytes), maxTotalBytes(maxTotalBytes) {
+}
+
+TelemetryRecorder::~TelemetryRecorder() {
+    flush();
+}
+
+QString TelemetryRecorder::defaultDirectory() {
+    return QDir::homePath() + "/.local/share/gpu-control/telemetry";
+}
+
+void TelemetryRecorder::append(const TelemetrySample &sample) {
+    if (sample.gpu < 0 || sample.gpu >= 32)
+        return;
+
+    // A clock step backwards starts a new chunk so chunks stay in order
+    if (records > 0 && (payload.size() >= ChunkBytes || sample.timestampMs - firstMs >= ChunkSpanMs
+                        || sample.timestampMs < lastMs))
+        flush();
+    if (records == 0) {
+        firstMs = lastMs = sample.timestampMs;
+        lastGpu = -1;
+        previous.clear();
+    }
+    if (previous.size() <= sample.gpu)
+        previous.resize(sample.gpu + 1);
+    QVector<qint64> &last = previous[sample.gpu];
+    if (last.isEmpty()) {
+        last.fill(0, FieldCount + 2);
+        last[LastMs] = firstMs;
+    }
+
+    qint64 values[FieldCount];
+    fields(sample, values);
+    int flags = sample.gpu != lastGpu ? GpuFlag : 0;
+    for (int i = 0; i < FieldCount; ++i) {
+        if (values[i] != last[i])
+            flags |= 1 << i;
+    }
+
+    // A steady sampler repeats the same interval, so store the change in it
+    qint64 interval = sample.timestampMs - last[LastMs];
+    payload.append(char(flags));
+    putVarint(&payload, zigzag(interval - last[LastInterval]));
+    if (flags & GpuFlag)
+        putVarint(&payload, quint64(sample.gpu));
+    for (int i = 0; i < FieldCount; ++i) {
+        if (flags & (1 << i))
+            putVarint(&payload, zigzag(values[i] - last[i]));
+        last[i] = values[i];
+    }
+
+    last[LastMs] = sample.timestampMs;
+    last[LastInterval] = interval;
+    lastMs = sample.timestampMs;
+    lastGpu = sample.gpu;
+    gpuMask |= 1u << sample.gpu;
+    ++records;
+}
+
+void TelemetryRecorder::flush() {
+    if (records == 0)
+        return;
+
+    if (file.isOpen() || openFile()) {
+        uchar header[ChunkHeaderSize];
+        qToLittleEndian<quint32>(ChunkMagic, header);
+        qToLittleEndian<quint32>(quint32(payload.size()), header + 4);
+        qToLittleEndian<quint32>(records, header + 8);
+        qToLittleEndian<quint32>(gpuMask, header + 12);
+        qToLittleEndian<qint64>(firstMs, header + 16);
+        qToLittleEndian<qint64>(lastMs, header + 24);
+        // One write per chunk, so a reader never sees a header without
+        // most of its payload
+        file.write(QByteArray(reinterpret_cast<const char *>(header), ChunkHeaderSize) + payload);
+        file.flush();
+        if (file.size() >= maxFileBytes) {
+            file.close();
+            prune();
+        }
+    }
+
+    payload.clear();
+    records = 0;
+    gpuMask = 0;
+}
+
+bool TelemetryRecorder::openFile() {
+    QDir dir(directory);
+    if (!dir.mkpath("."))
+        return false;
+
+    // Carry on with the newest recording unless it is full or another
+    // process is writing it; only then is cutting off a torn chunk safe
+    QStringList existing = recordings(dir);
+    if (!existing.isEmpty()) {
+        file.setFileName(dir.filePath(existing.last()));
+        if (file.size() < maxFileBytes && file.open(QIODevice::ReadWrite)) {
+            qint64 intact = 0;
+            if (lock(&file)) {
+                if (uchar *data = file.map(0, file.size())) {
+                    intact = intactLength(data, file.size());
+                    file.unmap(data);
+                }
+            }
+            if (intact > 0 && file.resize(intact) && file.seek(intact))
+                return true;
+            file.close();
+        }
+    }
+
+    // The pid keeps two writers starting in the same millisecond apart
+    QString name = QString("telemetry-%1-%2.gtr")
+                       .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss-zzz"))
+                       .arg(QCoreApplication::applicationPid());
+    file.setFileName(dir.filePath(name));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        return false;
+    lock(&file);
+    file.write(FileMagic, FileMagicSize);
+    return true;
+}
+
+void TelemetryRecorder::prune() {
+    QDir dir(directory);
+    QStringList existing = recordings(dir);
+    qint64 total = 0;
+    for (const QString &name : existing)
+        total += QFileInfo(dir.filePath(name)).size();
+    // Oldest first; the newest, and any another recorder has open, are
+    // kept whatever their size
+    for (int i = 0; i < existing.size() - 1 && total > maxTotalBytes; ++i) {
+        if (inUse(dir.filePath(existing[i])))
+            continue;
+        total -= QFileInfo(dir.filePath(existing[i])).size();
+        dir.remove(existing[i]);
+    }
+}
+
+TelemetryArchive::TelemetryArchive(const QString &directory) {
+    QDir dir(directory);
+    for (const QString &name : recordings(dir)) {
+        auto *file = new QFile(dir.filePath(name));
+        uchar *data = file->open(QIODevice::ReadOnly) ? file->map(0, file->size()) : nullptr;
+        if (!data) {
+            delete file;
+            continue;
+        }
+        files.append(file);
+
+        qint64 end = intactLength(data, file->size());
+        for (qint64 pos = FileMagicSize; pos < end;) {
+            Chunk chunk;
+            chunk.bytes = qFromLittleEndian<quint32>(data + pos + 4);
+            chunk.records = qFromLittleEndian<quint32>(data + pos + 8);
+            chunk.gpuMask = qFromLittleEndian<quint32>(data + pos + 12);
+            chunk.firstMs = qFromLittleEndian<qint64>(data + pos + 16);
+            chunk.lastMs = qFromLittleEndian<qint64>(data + pos + 24);
+            chunk.payload = data + pos + ChunkHeaderSize;
+            chunks.append(chunk);
+            pos += ChunkHeaderSize + chunk.bytes;
+        }
+    }
+    std::stable_sort(chunks.begin(), chunks.end(),
+                     [](const Chunk &a, const Chunk &b) { return a.firstMs < b.firstMs; });
+}
+
+TelemetryArchive::~TelemetryArchive() {
+    // Closing a QFile unmaps it
+    qDeleteAll(files);
+}
+
+qint64 TelemetryArchive::firstMs() const {
+    return chunks.isEmpty() ? 0 : chunks.first().firstMs;
+}
+
+qint64 TelemetryArchive::lastMs() const {
+    qint64 last = 0;
+    for (int i = qMax(0, chunks.size() - 8); i < chunks.size(); ++i)
+        last = qMax(last, chunks[i].lastMs);
+    return last;
+}
+
+QVector<int> TelemetryArchive::gpus() const {
+    quint32 mask = 0;
+    for (const Chunk &chunk : chunks)
+        mask |= chunk.gpuMask;
+    QVector<int> result;
+    for (int gpu = 0; gpu < 32; ++gpu) {
+        if (mask & (1u << gpu))
+            result.append(gpu);
+    }
+    return result;
+}
+
+QVector<TelemetrySample> TelemetryArchive::read(int gpu, qint64 fromMs, qint64 toMs, int maxPoints) const {
+    // A chunk spans at most ChunkSpanMs plus one sample interval
+    auto begin = std::lower_bound(chunks.constBegin(), chunks.constEnd(), fromMs - 2 * ChunkSpanMs,
+                                  [](const Chunk &chunk, qint64 ms) { return chunk.firstMs < ms; });
+    QVector<const Chunk *> overlapping;
+    for (auto it = begin; it != chunks.constEnd() && it->firstMs <= toMs; ++it) {
+        if (it->lastMs >= fromMs && (it->gpuMask & (1u << gpu)))
+            overlapping.append(&*it);
+    }
+
+    maxPoints = qMax(1, maxPoints);
+    QVector<TelemetrySample> samples;
+    if (overlapping.size() > maxPoints) {
+        int stride = (overlapping.size() + maxPoints - 1) / maxPoints;
+        for (int i = 0; i < overlapping.size(); i += stride)
+            decode(*overlapping[i], gpu, fromMs, toMs, true, &samples);
+        return samples;
+    }
+
+    for (const Chunk *chunk : overlapping)
+        decode(*chunk, gpu, fromMs, toMs, false, &samples);
+    if (samples.size() > maxPoints) {
+        int stride = (samples.size() + maxPoints - 1) / maxPoints;
+        int kept = 0;
+        for (int i = 0; i < samples.size(); i += stride)
+            samples[kept++] = samples[i];
+        samples.resize(kept);
+    }
+    return samples;
+}
+
+void TelemetryArchive::decode(const Chunk &chunk, int gpu, qint64 fromMs, qint64 toMs, bool firstOnly,
+                              QVector<TelemetrySample> *out) {
+    const uchar *p = chunk.payload;
+    const uchar *end = p + chunk.bytes;
+    qint64 values[FieldCount] = {};
+    qint64 timestamp = chunk.firstMs;
+    qint64 interval = 0;
+    int current = -1;
+    quint64 raw;
+
+    for (quint32 record = 0; record < chunk.records && p < end; ++record) {
+        int flags = *p++;
+        quint64 intervalChange;
+        if (!getVarint(&p, end, &intervalChange))
+            return;
+        if (flags & GpuFlag) {
+            if (!getVarint(&p, end, &raw))
+                return;
+            current = int(raw);
+        }
+        // Only the wanted GPU's clock is followed; the others are skipped
+        if (current == gpu) {
+            interval += unzigzag(intervalChange);
+            timestamp += interval;
+        }
+        // Other GPUs' deltas still have to be read past
+        for (int i = 0; i < FieldCount; ++i) {
+            if (!(flags & (1 << i)))
+                continue;
+            if (!getVarint(&p, end, &raw))
+                return;
+            if (current == gpu)
+                values[i] += unzigzag(raw);
+        }
+        if (current != gpu || timestamp < fromMs || timestamp > toMs)
+            continue;
+
+        TelemetrySample sample;
+        sample.timestampMs = timestamp;
+        sample.gpu = gpu;
+        sample.powerDraw = values[0] < 0 ? -1 : values[0] / 10.0f;
+        sample.graphicsClock = int(values[1]);
+        sample.memoryClock = int(values[2]);
+        sample.temperature = int(values[3]);
+        sample.gpuUtilization = int(values[4]);
+        sample.memUtilization = int(values[5]);
+        sample.throttleReasons = quint64(values[6]);
+        out->append(sample);
+        if (firstOnly)
+            return;
+    }
+}
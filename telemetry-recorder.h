@@ -0,0 +1,87 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// Telemetry history under ~/.local/share/gpu-control/telemetry, one file per
+// rotation and writer. Little-endian throughout:
+//
+//   file    = "GPUTEL1\n" chunk*
+//   chunk   = header (32 bytes: magic, payload bytes, records, GPU bit mask,
+//             first and last timestamp in ms) payload
+//   record  = flags byte, zigzag varint change in the GPU's sample
+//             interval, varint GPU when flag 0x80 is set, then one zigzag
+//             varint delta per field whose bit (0x01..0x40) is set
+//
+// Deltas are against the previous record of the same GPU in the same chunk,
+// so every chunk decodes on its own and a reader can jump straight to the
+// chunk covering a given time. Unchanged fields cost nothing, so a record
+// is 4 to 8 bytes; a week of one GPU at 10 Hz stays around 40 MB.
+class TelemetryRecorder {
+public:
+    explicit TelemetryRecorder(const QString &directory = defaultDirectory(),
+                               qint64 maxFileBytes = 16 << 20, qint64 maxTotalBytes = 64 << 20);
+    ~TelemetryRecorder();
+
+    // Buffers the sample; a chunk is written every 10 s or 32 KB
+    void append(const TelemetrySample &sample);
+    // Writes the open chunk now so a reader sees everything up to here
+    void flush();
+
+    static QString defaultDirectory();
+
+private:
+    bool openFile();
+    void prune();
+
+    QString directory;
+    qint64 maxFileBytes;
+    qint64 maxTotalBytes;
+    QFile file;
+    QByteArray payload;
+    quint32 records = 0;
+    quint32 gpuMask = 0;
+    qint64 firstMs = 0;
+    qint64 lastMs = 0;
+    int lastGpu = -1;
+    QVector<QVector<qint64>> previous;  // Per GPU, the last values written in this chunk
+};
+
+// Read side: memory-maps every file and indexes chunk headers only, so
+// opening a week of history costs a walk over its headers and reading a
+// window decodes just the chunks that overlap it.
+class TelemetryArchive {
+public:
+    explicit TelemetryArchive(const QString &directory = TelemetryRecorder::defaultDirectory());
+    ~TelemetryArchive();
+
+    bool isEmpty() const { return chunks.isEmpty(); }
+    qint64 firstMs() const;
+    qint64 lastMs() const;
+    QVector<int> gpus() const;
+
+    // Samples of gpu between fromMs and toMs. Beyond maxPoints chunks only
+    // the first sample of every nth chunk is decoded, which keeps a read
+    // over days as cheap as one over minutes.
+    QVector<TelemetrySample> read(int gpu, qint64 fromMs, qint64 toMs, int maxPoints) const;
+
+private:
+    struct Chunk {
+        const uchar *payload;
+        quint32 bytes;
+        quint32 records;
+        quint32 gpuMask;
+        qint64 firstMs;
+        qint64 lastMs;
+    };
+
+    static void decode(const Chunk &chunk, int gpu, qint64 fromMs, qint64 toMs, bool firstOnly,
+                       QVector<TelemetrySample> *out);
+
+    QVector<QFile *> files;
+    QVector<Chunk> chunks;  // In time order
+};
@@ -0,0 +1,164 @@
+#include "telemetry.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QProcess>
+
+#include <cstdlib>
+
+QString throttleReasonText(quint64 reasons) {
+    static const struct { quint64 bit; const char *name; } names[] = {
+        { 0x1, "Idle" },
+        { 0x2, "App clocks" },
+        { 0x4, "SW power cap" },
+        { 0x8, "HW slowdown" },
+        { 0x10, "Sync boost" },
+        { 0x20, "SW thermal" },
+        { 0x40, "HW thermal" },
+        { 0x80, "Power brake" },
+        { 0x100, "Display clock" },
+    };
+    QStringList active;
+    for (const auto &name : names) {
+        if (reasons & name.bit)
+            active << name.name;
+    }
+    return active.isEmpty() ? QString("None") : active.join(", ");
+}
+
+TelemetrySampler::TelemetrySampler(GpuBackend *backend, int gpuCount, int intervalMs, QObject *parent)
+    : QThread(parent), backend(backend), gpuCount(qMax(1, gpuCount)), intervalMs(qMax(10, intervalMs)) {
+}
+
+TelemetrySampler::~TelemetrySampler() {
+    stop();
+}
+
+void TelemetrySampler::stop() {
+    requestInterruption();
+    quit();
+    wait();
+}
+
+void TelemetrySampler::publish(TelemetrySample &sample) {
+    sample.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    if (!ring.push(sample))
+        dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TelemetrySampler::run() {
+    TelemetrySample probe;
+    if (backend->sample(qMax(0, onlyGpu), &probe))
+        pollBackend();
+    else
+        streamSmi();
+}
+
+void TelemetrySampler::pollBackend() {
+    QElapsedTimer timer;
+    timer.start();
+    qint64 next = 0;
+    int first = onlyGpu >= 0 ? onlyGpu : 0;
+    int end = onlyGpu >= 0 ? onlyGpu + 1 : gpuCount;
+    while (!isInterruptionRequested()) {
+        for (int gpu = first; gpu < end; ++gpu) {
+            TelemetrySample sample;
+            if (backend->sample(gpu, &sample))
+                publish(sample);
+        }
+
+        // Sleep to the next tick rather than a fixed interval so a slow
+        // read doesn't make the sampling rate drift
+        next += intervalMs;
+        qint64 wait = next - timer.elapsed();
+        if (wait > 0)
+            msleep(wait);
+        else
+            next = timer.elapsed();
+    }
+}
+
+QStringList TelemetrySampler::smiArguments(int intervalMs, int gpu) {
+    QStringList arguments;
+    arguments << "--query-gpu=index,power.draw,clocks.gr,clocks.mem,temperature.gpu,"
+                 "utilization.gpu,utilization.memory,clocks_throttle_reasons.active"
+              << "--format=csv,noheader,nounits"
+              << QString("--loop-ms=%1").arg(intervalMs);
+    if (gpu >= 0)
+        arguments << QString("--id=%1").arg(gpu);
+    return arguments;
+}
+
+void TelemetrySampler::streamSmi() {
+    QProcess smi;
+    connect(&smi, &QProcess::readyReadStandardOutput, [this, &smi]() {
+        char line[512];
+        while (smi.canReadLine()) {
+            if (smi.readLine(line, sizeof(line)) <= 0)
+                break;
+            TelemetrySample sample;
+            if (parseSmiLine(line, &sample))
+                publish(sample);
+        }
+    });
+    connect(&smi, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &QThread::quit);
+    smi.start("nvidia-smi", smiArguments(intervalMs, onlyGpu));
+
+    if (smi.waitForStarted(5000))
+        exec();
+
+    smi.kill();
+    smi.waitForFinished(1000);
+}
+
+namespace {
+
+// Skips past the comma ending the field that starts at p
+const char *skipField(const char *p) {
+    while (*p && *p != ',')
+        ++p;
+    return *p ? p + 1 : p;
+}
+
+// Reads one CSV field starting at *p and advances past its comma. Fields
+// nvidia-smi can't provide ("[N/A]", "[Not Supported]") yield -1.
+double nextField(const char **p) {
+    while (**p == ' ')
+        ++*p;
+    char *end = nullptr;
+    double value = std::strtod(*p, &end);
+    if (end == *p)
+        value = -1;
+    *p = skipField(*p);
+    return value;
+}
+
+// Throttle reasons come as a hex bitmask, e.g. 0x0000000000000004
+quint64 nextHexField(const char **p) {
+    while (**p == ' ')
+        ++*p;
+    char *end = nullptr;
+    quint64 value = std::strtoull(*p, &end, 16);
+    if (end == *p)
+        value = 0;
+    *p = skipField(*p);
+    return value;
+}
+
+}
+
+bool TelemetrySampler::parseSmiLine(const char *line, TelemetrySample *out) {
+    const char *p = line;
+    double index = nextField(&p);
+    if (index < 0)
+        return false;
+    out->gpu = int(index);
+    out->powerDraw = float(nextField(&p));
+    out->graphicsClock = int(nextField(&p));
+    out->memoryClock = int(nextField(&p));
+    out->temperature = int(nextField(&p));
+    out->gpuUtilization = int(nextField(&p));
+    out->memUtilization = int(nextField(&p));
+    out->throttleReasons = nextHexField(&p);
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "gpu-backend.h"
+#include "spsc-ring.h"
+
+#include <QThread>
+
+#include <atomic>
+
+typedef SpscRing<TelemetrySample, 1024> TelemetryRing;
+
+// Short names for the set NVML clocks throttle reason bits, e.g. "SW power cap"
+QString throttleReasonText(quint64 reasons);
+
+// Long-lived telemetry producer running on its own thread. Backends that can
+// sample in-process (NVML, mock) are polled directly; otherwise a single
+// nvidia-smi --loop-ms process is kept running and its output parsed line by
+// line. Either way, samples land in a lock-free ring drained by one consumer
+// and the per-sample path does not allocate.
+class TelemetrySampler : public QThread {
+public:
+    TelemetrySampler(GpuBackend *backend, int gpuCount, int intervalMs, QObject *parent = nullptr);
+    ~TelemetrySampler() override;
+
+    void stop();
+
+    // Samples only this GPU rather than 0..gpuCount-1; call before start()
+    void setGpu(int gpu) { onlyGpu = gpu; }
+
+    // Consumer side; only one thread may pop
+    TelemetryRing &samples() { return ring; }
+    quint64 droppedSamples() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Parses one line of the nvidia-smi stream in place. Exposed for reuse by
+    // anything else that reads the same --query-gpu field list.
+    static bool parseSmiLine(const char *line, TelemetrySample *out);
+    static QStringList smiArguments(int intervalMs, int gpu = -1);
+
+protected:
+    void run() override;
+
+private:
+    void pollBackend();
+    void streamSmi();
+    void publish(TelemetrySample &sample);
+
+    GpuBackend *backend;
+    int gpuCount;
+    int intervalMs;
+    int onlyGpu = -1;
+    TelemetryRing ring;
+    std::atomic<quint64> dropped{0};
+};
@@ -0,0 +1,201 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QThread>
+
+#include <algorithm>
+#include <unistd.h>
+
+namespace {
+
+const int MAX_STDERR = 512;
+
+QString tracePath;
+
+void exportTrace() {
+    if (Tracer::instance().writeChromeTrace(tracePath))
+        qInfo("Trace written to %s", qPrintable(tracePath));
+    else
+        qWarning("Cannot write trace to %s", qPrintable(tracePath));
+}
+
+double percentile(const QVector<qint64> &sorted, double p) {
+    if (sorted.isEmpty())
+        return 0;
+    int index = qBound(0, int(p * (sorted.size() - 1) + 0.5), sorted.size() - 1);
+    return sorted[index] / 1000.0;
+}
+
+}
+
+Tracer &Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer() {
+    clock.start();
+    ring.reserve(Capacity);
+}
+
+void Tracer::record(TraceEvent event) {
+    quintptr thread = quintptr(QThread::currentThreadId());
+    QMutexLocker lock(&mutex);
+    auto id = threadIds.constFind(thread);
+    event.thread = id != threadIds.constEnd() ? *id : threadIds.insert(thread, threadIds.size() + 1).value();
+    if (ring.size() < Capacity) {
+        ring.append(event);
+    } else {
+        ring[next] = event;
+        next = (next + 1) % Capacity;
+    }
+}
+
+QVector<TraceEvent> Tracer::events() const {
+    QMutexLocker lock(&mutex);
+    // Oldest first
+    QVector<TraceEvent> ordered = ring.mid(next);
+    ordered += ring.mid(0, next);
+    return ordered;
+}
+
+QVector<TraceStats> Tracer::stats() const {
+    QMap<QString, QVector<qint64>> durations;
+    QMap<QString, int> failures;
+    for (const TraceEvent &event : events()) {
+        durations[event.name].append(event.durationUs);
+        if (event.exitCode != 0)
+            ++failures[event.name];
+    }
+
+    QVector<TraceStats> result;
+    for (auto it = durations.begin(); it != durations.end(); ++it) {
+        std::sort(it->begin(), it->end());
+        TraceStats stats;
+        stats.name = it.key();
+        stats.count = it->size();
+        stats.failures = failures.value(it.key());
+        stats.p50Ms = percentile(*it, 0.50);
+        stats.p95Ms = percentile(*it, 0.95);
+        stats.maxMs = it->last() / 1000.0;
+        result.append(stats);
+    }
+    return result;
+}
+
+bool Tracer::writeChromeTrace(const QString &path) const {
+    QJsonArray traceEvents;
+    qint64 pid = getpid();
+    for (const TraceEvent &event : events()) {
+        QJsonObject args;
+        if (!event.args.isEmpty())
+            args["args"] = event.args;
+        args["exit_code"] = event.exitCode;
+        args["output_bytes"] = event.outputBytes;
+        if (!event.stderrText.isEmpty())
+            args["stderr"] = event.stderrText;
+
+        QJsonObject object;
+        object["name"] = event.name;
+        object["cat"] = event.category;
+        object["ph"] = "X";
+        object["ts"] = event.startUs;
+        object["dur"] = event.durationUs;
+        object["pid"] = pid;
+        object["tid"] = event.thread;
+        object["args"] = args;
+        traceEvents.append(object);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return true;
+}
+
+TraceSpan::TraceSpan(const QString &name, const QString &category, const QString &args) {
+    event.name = name;
+    event.category = category;
+    event.args = args;
+    event.startUs = Tracer::instance().nowUs();
+}
+
+TraceSpan::~TraceSpan() {
+    event.durationUs = Tracer::instance().nowUs() - event.startUs;
+    Tracer::instance().record(event);
+}
+
+TracedProcess::TracedProcess(QObject *parent) : QProcess(parent) {
+    // stateChanged(Starting) is emitted synchronously from start()
+    recording << connect(this, &QProcess::stateChanged, [this](QProcess::ProcessState state) {
+        if (state == QProcess::Starting)
+            startUs = Tracer::instance().nowUs();
+    });
+    recording << connect(this, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                         [this](int exitCode, QProcess::ExitStatus status) {
+        finish(status == QProcess::NormalExit ? exitCode : -1);
+    });
+    recording << connect(this, &QProcess::errorOccurred, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart)
+            finish(-1);
+    });
+}
+
+TracedProcess::~TracedProcess() {
+    // ~QProcess would kill a child that is still running and emit finished()
+    // into finish() after this part of the object is gone; end it while the
+    // event can still be recorded, then stop listening
+    if (state() != QProcess::NotRunning) {
+        kill();
+        waitForFinished(1000);
+    }
+    for (const QMetaObject::Connection &connection : recording)
+        disconnect(connection);
+}
+
+void TracedProcess::finish(int exitCode) {
+    TraceEvent event;
+    QStringList args = arguments();
+    // "sudo nvidia-smi" and "nvidia-smi" are different operations to tune
+    event.name = QFileInfo(program()).fileName();
+    if (event.name == "sudo" && !args.isEmpty())
+        event.name += " " + args.first();
+    event.category = "process";
+    event.args = args.join(' ');
+    event.startUs = startUs;
+    event.durationUs = Tracer::instance().nowUs() - startUs;
+    event.exitCode = exitCode;
+
+    // Peek so callers still get to read everything
+    ProcessChannel channel = readChannel();
+    setReadChannel(StandardOutput);
+    event.outputBytes = bytesAvailable();
+    setReadChannel(StandardError);
+    event.outputBytes += bytesAvailable();
+    event.stderrText = QString::fromLocal8Bit(peek(MAX_STDERR)).trimmed();
+    setReadChannel(channel);
+
+    Tracer::instance().record(event);
+}
+
+void installTraceExport(const QStringList &arguments) {
+    for (int i = 0; i < arguments.size(); ++i) {
+        if (arguments[i].startsWith("--trace="))
+            tracePath = arguments[i].mid(8);
+        else if (arguments[i] == "--trace" && i + 1 < arguments.size())
+            tracePath = arguments[i + 1];
+    }
+    if (!tracePath.isEmpty())
+        qAddPostRoutine(exportTrace);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QProcess>
+#include <QString>
+#include <QVector>
+
+// One finished operation: a backend call, a helper round trip or a child
+// process. Times are microseconds on the tracer's monotonic clock.
+struct TraceEvent {
+    QString name;           // Operation type, e.g. "sudo nvidia-settings"
+    QString category;
+    QString args;
+    qint64 startUs = 0;
+    qint64 durationUs = 0;
+    int exitCode = 0;       // -1 when a process failed to start or crashed
+    qint64 outputBytes = 0;
+    QString stderrText;     // Kept even on success, truncated
+    int thread = 0;
+};
+
+// Latency summary for one operation type
+struct TraceStats {
+    QString name;
+    int count = 0;
+    int failures = 0;
+    double p50Ms = 0;
+    double p95Ms = 0;
+    double maxMs = 0;
+};
+
+// Process-wide record of recent operations. Recording is a mutex and a copy
+// into a fixed-size ring, cheap next to the subprocesses being measured.
+class Tracer {
+public:
+    static Tracer &instance();
+
+    qint64 nowUs() const { return clock.nsecsElapsed() / 1000; }
+    void record(TraceEvent event);
+
+    QVector<TraceEvent> events() const;
+    QVector<TraceStats> stats() const;
+
+    // Chrome trace_event JSON, loadable in chrome://tracing or Perfetto
+    bool writeChromeTrace(const QString &path) const;
+
+private:
+    Tracer();
+
+    static const int Capacity = 16384;
+
+    QElapsedTimer clock;
+    mutable QMutex mutex;
+    QVector<TraceEvent> ring;
+    int next = 0;
+    QHash<quintptr, int> threadIds;
+};
+
+// Records the enclosing scope as one event when it ends
+class TraceSpan {
+public:
+    TraceSpan(const QString &name, const QString &category = "backend", const QString &args = QString());
+    ~TraceSpan();
+
+    void setExitCode(int code) { event.exitCode = code; }
+    void setOutputBytes(qint64 bytes) { event.outputBytes = bytes; }
+
+private:
+    TraceEvent event;
+};
+
+// QProcess that records one event per run: program and arguments, wall
+// time from start() to exit, exit code, output size and stderr.
+class TracedProcess : public QProcess {
+public:
+    explicit TracedProcess(QObject *parent = nullptr);
+    ~TracedProcess() override;
+
+private:
+    void finish(int exitCode);
+
+    qint64 startUs = 0;
+    QVector<QMetaObject::Connection> recording;
+};
+
+// Writes the trace to the file given as --trace=<file> (or --trace <file>)
+// when the application exits
+void installTraceExport(const QStringList &arguments);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "gpu-backend.h"
+#include "tracer.h"
+
+#include <QScopedPointer>
+
+// Records every call into the wrapped backend as a TraceSpan. Failed calls
+// (false, -1 or failed apply fields) are recorded with exit code 1.
+class TracingBackend : public GpuBackend {
+public:
+    explicit TracingBackend(GpuBackend *inner) : inner(inner) {}
+
+    QString name() const override { return inner->name(); }
+    int deviceCount() override { return traceInt("deviceCount", -1, [&]() { return inner->deviceCount(); }); }
+
+    QString pciBusId(int gpu) override { return trace("pciBusId", gpu, [&]() { return inner->pciBusId(gpu); }); }
+    QString driverVersion() override { return trace("driverVersion", -1, [&]() { return inner->driverVersion(); }); }
+    QString gpuName(int gpu) override { return trace("gpuName", gpu, [&]() { return inner->gpuName(gpu); }); }
+    int minPowerLimit(int gpu) override { return traceInt("minPowerLimit", gpu, [&]() { return inner->minPowerLimit(gpu); }); }
+    int maxPowerLimit(int gpu) override { return traceInt("maxPowerLimit", gpu, [&]() { return inner->maxPowerLimit(gpu); }); }
+    int defaultPowerLimit(int gpu) override { return traceInt("defaultPowerLimit", gpu, [&]() { return inner->defaultPowerLimit(gpu); }); }
+    int powerLimit(int gpu) override { return traceInt("powerLimit", gpu, [&]() { return inner->powerLimit(gpu); }); }
+    int memoryClock(int gpu) override { return traceInt("memoryClock", gpu, [&]() { return inner->memoryClock(gpu); }); }
+    int graphicsClock(int gpu) override { return traceInt("graphicsClock", gpu, [&]() { return inner->graphicsClock(gpu); }); }
+    bool memoryOffset(int gpu, int *mhz) override { return traceBool("memoryOffset", gpu, [&]() { return inner->memoryOffset(gpu, mhz); }); }
+    bool coreOffset(int gpu, int *mhz) override { return traceBool("coreOffset", gpu, [&]() { return inner->coreOffset(gpu, mhz); }); }
+    bool memoryOffsetRange(int gpu, int *min, int *max) override { return traceBool("memoryOffsetRange", gpu, [&]() { return inner->memoryOffsetRange(gpu, min, max); }); }
+    bool coreOffsetRange(int gpu, int *min, int *max) override { return traceBool("coreOffsetRange", gpu, [&]() { return inner->coreOffsetRange(gpu, min, max); }); }
+    bool supportedClocks(int gpu, QVector<int> *memory, QVector<int> *graphics) override { return traceBool("supportedClocks", gpu, [&]() { return inner->supportedClocks(gpu, memory, graphics); }); }
+    GpuSnapshot snapshot(int gpu) override { return trace("snapshot", gpu, [&]() { return inner->snapshot(gpu); }); }
+    GpuStaticInfo staticInfo(int gpu) override { return trace("staticInfo", gpu, [&]() { return inner->staticInfo(gpu); }); }
+    // Telemetry polls at 10 Hz per GPU; a span each would bury the calls
+    // worth tracing, so it passes through untraced
+    bool sample(int gpu, TelemetrySample *out) override { return inner->sample(gpu, out); }
+
+    bool setPowerLimit(int gpu, int watts, QString *error) override { return traceBool("setPowerLimit", gpu, [&]() { return inner->setPowerLimit(gpu, watts, error); }); }
+    bool setMemoryOffset(int gpu, int mhz, QString *error) override { return traceBool("setMemoryOffset", gpu, [&]() { return inner->setMemoryOffset(gpu, mhz, error); }); }
+    bool setCoreOffset(int gpu, int mhz, QString *error) override { return traceBool("setCoreOffset", gpu, [&]() { return inner->setCoreOffset(gpu, mhz, error); }); }
+    bool setGraphicsClockLock(int gpu, int min, int max, QString *error) override { return traceBool("setGraphicsClockLock", gpu, [&]() { return inner->setGraphicsClockLock(gpu, min, max, error); }); }
+    bool setMemoryClockLock(int gpu, int min, int max, QString *error) override { return traceBool("setMemoryClockLock", gpu, [&]() { return inner->setMemoryClockLock(gpu, min, max, error); }); }
+
+    ApplyResult apply(int gpu, const GpuSettings &settings, int fields) override {
+        TraceSpan span("apply", "backend", QString("gpu %1 fields %2").arg(gpu).arg(fields));
+        ApplyResult result = inner->apply(gpu, settings, fields);
+        span.setExitCode(result.failedFields);
+        return result;
+    }
+
+private:
+    template <typename Call>
+    static auto trace(const char *op, int gpu, Call call) -> decltype(call()) {
+        TraceSpan span(op, "backend", gpu >= 0 ? QString("gpu %1").arg(gpu) : QString());
+        return call();
+    }
+
+    template <typename Call>
+    static int traceInt(const char *op, int gpu, Call call) {
+        TraceSpan span(op, "backend", gpu >= 0 ? QString("gpu %1").arg(gpu) : QString());
+        int value = call();
+        span.setExitCode(value < 0 ? 1 : 0);
+        return value;
+    }
+
+    template <typename Call>
+    static bool traceBool(const char *op, int gpu, Call call) {
+        TraceSpan span(op, "backend", gpu >= 0 ? QString("gpu %1").arg(gpu) : QString());
+        bool ok = call();
+        span.setExitCode(ok ? 0 : 1);
+        return ok;
+    }
+
+    QScopedPointer<GpuBackend> inner;
+};
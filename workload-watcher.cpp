@@ -0,0 +1,115 @@
+#include "workload-watcher.h"
+
+#include <QSet>
+
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Small /proc files in one read, without QFile's buffering
+QByteArray readProcFile(const char *path) {
+    char buffer[512];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return QByteArray();
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    close(fd);
+    return n > 0 ? QByteArray(buffer, int(n)).trimmed() : QByteArray();
+}
+
+}
+
+WorkloadWatcher::WorkloadWatcher(const QVector<ProfileRule> &rules, const QString &idleProfile, int settleMs)
+    : idleProfile(idleProfile), settleMs(settleMs) {
+    for (const ProfileRule &rule : rules) {
+        Matcher matcher;
+        matcher.profile = rule.profile;
+        if (rule.pattern.startsWith("cgroup:")) {
+            matcher.cgroup = rule.pattern.mid(7);
+            wantsCgroups = true;
+        } else {
+            matcher.name = QRegExp(rule.pattern, Qt::CaseSensitive, QRegExp::Wildcard);
+        }
+        matchers.append(matcher);
+    }
+}
+
+QString WorkloadWatcher::cgroupOf(int pid) {
+    auto it = cgroups.constFind(pid);
+    if (it != cgroups.constEnd())
+        return *it;
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+    QString cgroup = QString::fromUtf8(readProcFile(path));
+    cgroups.insert(pid, cgroup);
+    return cgroup;
+}
+
+QString WorkloadWatcher::desired(QString *reason) {
+    // Best (earliest) rule any running process matches
+    int best = matchers.size();
+    QSet<int> alive;
+    DIR *proc = opendir("/proc");
+    if (!proc)
+        return idleProfile;
+    while (dirent *entry = readdir(proc)) {
+        int pid = atoi(entry->d_name);
+        if (pid <= 0)
+            continue;
+        alive.insert(pid);
+
+        // comm rather than cmdline: one short read, and it follows exec
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+        QString name = QString::fromUtf8(readProcFile(path));
+        if (name.isEmpty())
+            continue;
+        for (int i = 0; i < best; ++i) {
+            const Matcher &matcher = matchers[i];
+            bool hit = matcher.cgroup.isEmpty()
+                ? matcher.name.exactMatch(name)
+                : cgroupOf(pid).contains(matcher.cgroup);
+            if (hit) {
+                best = i;
+                *reason = QString("%1 (pid %2)").arg(name).arg(pid);
+                break;
+            }
+        }
+    }
+    closedir(proc);
+
+    if (wantsCgroups) {
+        for (auto it = cgroups.begin(); it != cgroups.end();) {
+            if (alive.contains(it.key()))
+                ++it;
+            else
+                it = cgroups.erase(it);
+        }
+    }
+    return best < matchers.size() ? matchers[best].profile : idleProfile;
+}
+
+bool WorkloadWatcher::poll(qint64 nowMs) {
+    QString reason;
+    QString wanted = desired(&reason);
+    if (wanted == active) {
+        pendingSinceMs = -1;
+        return false;
+    }
+    if (pendingSinceMs < 0 || wanted != pending) {
+        pending = wanted;
+        pendingReason = reason;
+        pendingSinceMs = nowMs;
+    }
+    if (nowMs - pendingSinceMs < settleMs)
+        return false;
+
+    active = pending;
+    activeReason = pendingReason.isEmpty() ? QString("no matching workload") : pendingReason;
+    pendingSinceMs = -1;
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "config.h"
+
+#include <QHash>
+#include <QRegExp>
+#include <QString>
+#include <QVector>
+
+// Decides which profile the running workload wants by scanning /proc for
+// processes that match a rule. A change only takes effect once it has held
+// for settleMs, so a short-lived process (or a job restarting) does not
+// flip the GPUs back and forth. Worst-case switch latency is one poll
+// interval plus settleMs.
+class WorkloadWatcher {
+public:
+    WorkloadWatcher(const QVector<ProfileRule> &rules, const QString &idleProfile, int settleMs);
+
+    // Scans once. Returns true when the debounced profile has changed.
+    bool poll(qint64 nowMs);
+
+    // Profile to apply, empty for the main settings. Starts empty, as the
+    // caller has just applied those; an idle profile takes over once it
+    // has held for settleMs like any other switch.
+    QString activeProfile() const { return active; }
+    // Process that selected the active profile, for logging
+    QString reason() const { return activeReason; }
+
+private:
+    struct Matcher {
+        QString profile;
+        QRegExp name;           // Empty for cgroup rules
+        QString cgroup;
+    };
+
+    QString desired(QString *reason);
+    QString cgroupOf(int pid);
+
+    QVector<Matcher> matchers;
+    QString idleProfile;
+    int settleMs;
+    bool wantsCgroups = false;
+    QHash<int, QString> cgroups;    // By pid; a process rarely changes cgroup
+
+    QString active;
+    QString activeReason;
+    QString pending;
+    QString pendingReason;
+    qint64 pendingSinceMs = -1;
+};
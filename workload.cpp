@@ -0,0 +1,81 @@
+#include "workload.h"
+#include "mock-backend.h"
+#include "tracer.h"
+
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QThread>
+
+Workload *Workload::create(const QString &command, const QString &throughputPattern, int timeoutMs,
+                           MockBackend *simulator, int gpu, int simulatedMs) {
+    if (!command.isEmpty())
+        return new CommandWorkload(command, throughputPattern, timeoutMs);
+    if (simulator)
+        return new SimulatedWorkload(simulator, gpu, simulatedMs);
+    return nullptr;
+}
+
+bool Workload::parseThroughput(const QString &output, const QString &pattern, double *value) {
+    QRegularExpression re(pattern.isEmpty() ? QString("(-?\\d+(?:\\.\\d+)?)") : pattern,
+                          QRegularExpression::MultilineOption);
+    if (!re.isValid() || re.captureCount() < 1)
+        return false;
+
+    // The last match wins, so progress lines before the summary don't count
+    QString last;
+    auto it = re.globalMatch(output);
+    while (it.hasNext())
+        last = it.next().captured(1);
+
+    bool ok = false;
+    double parsed = last.toDouble(&ok);
+    if (ok)
+        *value = parsed;
+    return ok;
+}
+
+WorkloadRun CommandWorkload::run(int pollMs, const std::function<void()> &poll) {
+    WorkloadRun result;
+    TracedProcess process;
+    process.start("sh", QStringList() << "-c" << command);
+    QElapsedTimer timer;
+    timer.start();
+    while (!process.waitForFinished(pollMs)) {
+        if (poll)
+            poll();
+        if (process.state() == QProcess::NotRunning || timer.elapsed() > timeoutMs)
+            break;
+    }
+    if (process.state() != QProcess::NotRunning) {
+        process.kill();
+        process.waitForFinished(1000);
+        result.error = QString("Timed out after %1 s").arg(timeoutMs / 1000);
+    } else if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        result.error = QString("Exited with %1: %2").arg(process.exitCode())
+            .arg(QString(process.readAllStandardError()).trimmed());
+    } else {
+        result.ok = true;
+        parseThroughput(process.readAllStandardOutput(), throughputPattern, &result.throughput);
+    }
+    return result;
+}
+
+WorkloadRun SimulatedWorkload::run(int pollMs, const std::function<void()> &poll) {
+    WorkloadRun result;
+    if (!mock->simulateWorkload(gpu, true, nullptr)) {
+        result.error = QString("No simulated GPU %1").arg(gpu);
+        return result;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < durationMs) {
+        QThread::msleep(qMin<qint64>(pollMs, qMax<qint64>(1, durationMs - timer.elapsed())));
+        if (poll)
+            poll();
+    }
+    mock->simulateWorkload(gpu, false, &result.throughput);
+    result.ok = result.throughput >= 0;
+    if (!result.ok)
+        result.error = "Simulated workload crashed";
+    return result;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QString>
+
+#include <functional>
+
+class MockBackend;
+
+struct WorkloadRun {
+    bool ok = false;            // Ran to the end and exited 0
+    double throughput = -1;     // -1 when it reported none
+    QString error;              // Why it did not finish
+};
+
+// What loads the GPU while the power sweep or offset tuner measures it.
+// Kept apart from GpuBackend, which only reads and writes the hardware.
+// Blocking; run it on a worker thread.
+class Workload {
+public:
+    virtual ~Workload() {}
+
+    // Runs once, calling poll every pollMs until it finishes
+    virtual WorkloadRun run(int pollMs, const std::function<void()> &poll) = 0;
+    // Names the workload in logs; results of different workloads don't mix
+    virtual QString description() const = 0;
+
+    // A CommandWorkload for a non-empty command, otherwise a
+    // SimulatedWorkload on simulator; nullptr when there is neither
+    static Workload *create(const QString &command, const QString &throughputPattern, int timeoutMs,
+                            MockBackend *simulator, int gpu, int simulatedMs);
+
+    // First capture group of pattern's last match, by default the last
+    // number printed
+    static bool parseThroughput(const QString &output, const QString &pattern, double *value);
+};
+
+// A benchmark or validation command run through `sh -c`; exit code 0 means
+// it passed, and the throughput is read from its stdout
+class CommandWorkload : public Workload {
+public:
+    CommandWorkload(const QString &command, const QString &throughputPattern, int timeoutMs)
+        : command(command), throughputPattern(throughputPattern), timeoutMs(timeoutMs) {}
+
+    WorkloadRun run(int pollMs, const std::function<void()> &poll) override;
+    QString description() const override { return command.simplified(); }
+
+private:
+    QString command;
+    QString throughputPattern;
+    int timeoutMs;
+};
+
+// Holds a mock GPU at full load for a fixed time and reports the throughput
+// its performance model gives, so the tools can run without a real GPU
+class SimulatedWorkload : public Workload {
+public:
+    SimulatedWorkload(MockBackend *mock, int gpu, int durationMs) : mock(mock), gpu(gpu), durationMs(durationMs) {}
+
+    WorkloadRun run(int pollMs, const std::function<void()> &poll) override;
+    QString description() const override { return "simulated"; }
+
+private:
+    MockBackend *mock;
+    int gpu;
+    int durationMs;
+};